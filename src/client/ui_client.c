@@ -1,25 +1,30 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <signal.h>
 #include "common.h" 
 #include "util.h" // Necesario para normalizar
+#include "protocol.h" // Tramas del protocolo
 
 #define SERVER_IP "127.0.0.1" 
 #define SERVER_PORT 8080
 #define MAX_QUERY_LEN 1024
+#define BATCH_WINDOW 64 // Busquedas enviadas sin esperar respuesta en modo --batch
+#define MULTI_CHUNK 4096 // Titulos por peticion OP_MULTI_LOOKUP en modo --multi
+
+// Conexion persistente con el servidor (-1 si no hay conexion abierta)
+static int server_fd = -1;
 
 /**
- * @brief Se conecta al servidor, envía una consulta de BÚSQUEDA y muestra los resultados.
- * (Esta es la función 'run_query' de la Fase 2, renombrada)
+ * @brief Retorna la conexion con el servidor, abriendola si hace falta.
+ * La misma conexion se reutiliza para todas las operaciones.
  */
-static int perform_search(const char *query) {
-    if (query == NULL || query[0] == '\0') {
-        printf("Error: No hay título para buscar. Use la opción 1 primero.\n");
-        return -1;
-    }
+static int get_connection(void) {
+    if (server_fd >= 0) return server_fd;
 
     // --- Conectar al Servidor ---
     int sock_fd;
@@ -45,87 +50,300 @@ static int perform_search(const char *query) {
         close(sock_fd);
         return -1;
     }
+    server_fd = sock_fd;
+    return server_fd;
+}
 
-    const char *op_code = "OP_LOOKUP";
-    uint32_t op_len = (uint32_t)strlen(op_code);
-    write(sock_fd, &op_len, sizeof(op_len));
-    write(sock_fd, op_code, op_len);
-
-
-    printf("Conectado. Buscando: '%s'\n", query);
+/**
+ * @brief Cierra la conexion persistente (p. ej. despues de un error de lectura/escritura).
+ */
+static void drop_connection(void) {
+    if (server_fd >= 0) close(server_fd);
+    server_fd = -1;
+}
 
-    // --- Enviar Petición de Búsqueda ---
-    
-    uint32_t query_len = (uint32_t)strlen(query);
-    if (write(sock_fd, &query_len, sizeof(query_len)) != sizeof(query_len)) {
-        perror("write (longitud)");
-        close(sock_fd);
-        return -1;
-    }
-    if (write(sock_fd, query, query_len) != (ssize_t)query_len) {
-        perror("write (consulta)");
-        close(sock_fd);
-        return -1;
+/**
+ * @brief Envia una trama por la conexion persistente.
+ * Si el servidor habia cerrado la conexion, reconecta y reintenta una vez
+ * (el servidor no recibio la trama, asi que reintentar es seguro).
+ */
+static int send_request(const char *op, const void *body, uint32_t body_len) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        int fd = get_connection();
+        if (fd < 0) return -1;
+        if (proto_send_frame(fd, op, body, body_len) == 0) return fd;
+        drop_connection();
     }
+    perror("write (petición)");
+    return -1;
+}
 
-    // --- 3. Recibir Respuesta ---
+/**
+ * @brief Lee la respuesta de un OP_LOOKUP. Si print es distinto de 0 muestra las lineas.
+ * Retorna el numero de resultados (>= 0), o -1 si hubo error (la conexion se cierra).
+ */
+static int32_t read_lookup_response(int sock_fd, int print) {
     int32_t result_count;
-    if (read(sock_fd, &result_count, sizeof(result_count)) != sizeof(result_count)) {
+    if (safe_read_full(sock_fd, &result_count, sizeof(result_count)) != sizeof(result_count)) {
         perror("read (conteo)");
-        close(sock_fd);
+        drop_connection();
         return -1;
     }
 
     if (result_count < 0) {
         fprintf(stderr, "Error en el servidor al procesar la consulta.\n");
-        close(sock_fd);
         return -1;
     }
-    
-    if (result_count == 0) {
-        printf("==> No se encontraron resultados para '%s'.\n", query);
-        close(sock_fd);
-        return 0;
-    }
 
-    printf("==> Recibidos %d resultados:\n", result_count);
+    if (print && result_count > 0) printf("==> Recibidos %d resultados:\n", result_count);
     
-    // Bucle para leer cada línea de resultado
+    // Bucle para leer cada línea de resultado (siempre se consumen, para no desincronizar la conexion)
     for (int i = 0; i < result_count; i++) {
         uint32_t line_len;
-        if (read(sock_fd, &line_len, sizeof(line_len)) != sizeof(line_len)) {
+        if (safe_read_full(sock_fd, &line_len, sizeof(line_len)) != sizeof(line_len)) {
             perror("read (line_len)");
-            close(sock_fd);
+            drop_connection();
             return -1;
         }
 
         char *line_buf = malloc(line_len + 1);
         if (!line_buf) {
             perror("malloc (line_buf)");
-            close(sock_fd);
+            drop_connection();
             return -1;
         }
 
-        if (read(sock_fd, line_buf, line_len) != (ssize_t)line_len) {
+        if (safe_read_full(sock_fd, line_buf, line_len) != (ssize_t)line_len) {
             perror("read (line_data)");
             free(line_buf);
-            close(sock_fd);
+            drop_connection();
             return -1;
         }
         line_buf[line_len] = '\0'; 
 
-        printf("  [%d] %s", i + 1, line_buf);
-        if (line_buf[line_len - 1] != '\n') {
-            printf("\n");
+        if (print) {
+            printf("  [%d] %s", i + 1, line_buf);
+            if (line_len == 0 || line_buf[line_len - 1] != '\n') {
+                printf("\n");
+            }
         }
         
         free(line_buf);
     }
+    return result_count;
+}
+
+/**
+ * @brief Envía una consulta de BÚSQUEDA por la conexion persistente y muestra los resultados.
+ */
+static int perform_search(const char *query) {
+    if (query == NULL || query[0] == '\0') {
+        printf("Error: No hay título para buscar. Use la opción 1 primero.\n");
+        return -1;
+    }
+
+    // --- Enviar Petición de Búsqueda ---
+    int sock_fd = send_request(PROTO_OP_LOOKUP, query, (uint32_t)strlen(query));
+    if (sock_fd < 0) return -1;
+
+    printf("Conectado. Buscando: '%s'\n", query);
+
+    // --- Recibir Respuesta ---
+    int32_t result_count = read_lookup_response(sock_fd, 1);
+    if (result_count < 0) return -1;
+    
+    if (result_count == 0) {
+        printf("==> No se encontraron resultados para '%s'.\n", query);
+    }
+    return 0;
+}
+
+/**
+ * @brief Modo no interactivo: lee un título por línea de 'path' ("-" = stdin) y los busca
+ * todos por la misma conexion, enviando hasta BATCH_WINDOW peticiones antes de esperar
+ * respuestas. Imprime "<resultados>\t<título>" por cada título, en el mismo orden.
+ */
+static int perform_batch(const char *path) {
+    FILE *in = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (in == NULL) {
+        perror("fopen (batch)");
+        return -1;
+    }
+    int sock_fd = get_connection();
+    if (sock_fd < 0) {
+        if (in != stdin) fclose(in);
+        return -1;
+    }
+
+    char *titles[BATCH_WINDOW] = {0}; // Titulos enviados que aun no tienen respuesta (cola circular)
+    size_t head = 0, in_flight = 0;
+    char *line = NULL;
+    size_t line_size = 0;
+    int status = 0;
+    int eof = 0;
+
+    while (!eof || in_flight > 0) {
+        // Llenar la ventana de peticiones sin esperar respuestas
+        while (!eof && in_flight < BATCH_WINDOW) {
+            ssize_t n = getline(&line, &line_size, in);
+            if (n < 0) {
+                eof = 1;
+                break;
+            }
+            line[strcspn(line, "\r\n")] = '\0';
+            if (line[0] == '\0') continue;
+            if (proto_send_frame(sock_fd, PROTO_OP_LOOKUP, line, (uint32_t)strlen(line)) != 0) {
+                perror("write (batch)");
+                status = -1;
+                eof = 1;
+                break;
+            }
+            titles[(head + in_flight) % BATCH_WINDOW] = strdup(line);
+            in_flight++;
+        }
+        if (in_flight == 0) break;
+
+        // Las respuestas llegan en el mismo orden que las peticiones
+        int32_t count = read_lookup_response(sock_fd, 0);
+        char *title = titles[head];
+        if (count < 0) {
+            status = -1;
+            break;
+        }
+        printf("%d\t%s\n", count, title ? title : "");
+        free(title);
+        titles[head] = NULL;
+        head = (head + 1) % BATCH_WINDOW;
+        in_flight--;
+    }
+
+    for (size_t i = 0; i < BATCH_WINDOW; i++) free(titles[i]);
+    free(line);
+    if (in != stdin) fclose(in);
+    return status;
+}
+
+/**
+ * @brief Envia un OP_MULTI_LOOKUP con n titulos e imprime "<resultados>\t<título>" por cada uno.
+ */
+static int send_multi_chunk(char **titles, uint32_t n) {
+    // Cuerpo: [uint32_t n] seguido de n x [uint32_t len][char* title]
+    size_t body_len = sizeof(uint32_t);
+    for (uint32_t i = 0; i < n; i++) body_len += sizeof(uint32_t) + strlen(titles[i]);
+    if (body_len > PROTO_MAX_BODY_LEN) {
+        fprintf(stderr, "Error: lote de titulos demasiado grande\n");
+        return -1;
+    }
+    char *body = malloc(body_len);
+    if (body == NULL) {
+        perror("malloc (multi)");
+        return -1;
+    }
+    size_t pos = 0;
+    memcpy(body + pos, &n, sizeof(n));
+    pos += sizeof(n);
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t len = (uint32_t)strlen(titles[i]);
+        memcpy(body + pos, &len, sizeof(len));
+        pos += sizeof(len);
+        memcpy(body + pos, titles[i], len);
+        pos += len;
+    }
 
-    close(sock_fd);
+    int sock_fd = send_request(PROTO_OP_MULTI_LOOKUP, body, (uint32_t)body_len);
+    free(body);
+    if (sock_fd < 0) return -1;
+
+    int32_t groups;
+    if (safe_read_full(sock_fd, &groups, sizeof(groups)) != sizeof(groups)) {
+        perror("read (grupos)");
+        drop_connection();
+        return -1;
+    }
+    if (groups != (int32_t)n) {
+        fprintf(stderr, "Error en el servidor al procesar la consulta multiple.\n");
+        return -1;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        int32_t count = read_lookup_response(sock_fd, 0);
+        if (count < 0) return -1;
+        printf("%d\t%s\n", count, titles[i]);
+    }
     return 0;
 }
 
+/**
+ * @brief Pide OP_STATS e imprime el texto con los contadores del servidor.
+ */
+static int perform_stats(void) {
+    int sock_fd = send_request(PROTO_OP_STATS, NULL, 0);
+    if (sock_fd < 0) return -1;
+    uint32_t len;
+    if (safe_read_full(sock_fd, &len, sizeof(len)) != sizeof(len) || len > PROTO_MAX_BODY_LEN) {
+        perror("read (stats)");
+        drop_connection();
+        return -1;
+    }
+    char *text = malloc(len ? len : 1);
+    if (text == NULL) {
+        perror("malloc (stats)");
+        drop_connection();
+        return -1;
+    }
+    if (safe_read_full(sock_fd, text, len) != (ssize_t)len) {
+        perror("read (stats)");
+        free(text);
+        drop_connection();
+        return -1;
+    }
+    fwrite(text, 1, len, stdout);
+    free(text);
+    return 0;
+}
+
+/**
+ * @brief Modo no interactivo: igual que --batch, pero agrupa hasta MULTI_CHUNK titulos
+ * en cada peticion OP_MULTI_LOOKUP (un solo viaje de ida y vuelta por grupo).
+ */
+static int perform_multi(const char *path) {
+    FILE *in = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (in == NULL) {
+        perror("fopen (multi)");
+        return -1;
+    }
+    char **titles = malloc(sizeof(char *) * MULTI_CHUNK);
+    if (titles == NULL) {
+        perror("malloc (multi)");
+        if (in != stdin) fclose(in);
+        return -1;
+    }
+
+    char *line = NULL;
+    size_t line_size = 0;
+    uint32_t n = 0;
+    int status = 0;
+    while (status == 0) {
+        ssize_t r = getline(&line, &line_size, in);
+        if (r >= 0) {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (line[0] == '\0') continue;
+            titles[n++] = strdup(line);
+        }
+        if (n == MULTI_CHUNK || (r < 0 && n > 0)) {
+            status = send_multi_chunk(titles, n);
+            for (uint32_t i = 0; i < n; i++) free(titles[i]);
+            n = 0;
+        }
+        if (r < 0) break;
+    }
+
+    for (uint32_t i = 0; i < n; i++) free(titles[i]);
+    free(titles);
+    free(line);
+    if (in != stdin) fclose(in);
+    return status;
+}
+
 void trim_newline(char *str) {
     str[strcspn(str, "\n")] = 0;
 }
@@ -203,49 +421,6 @@ int perform_add_book(void) {
     fgets(total_rating, sizeof(total_rating), stdin);
     trim_newline(total_rating);
 
-    //Conectar al socket del servidor
-    int sock_fd;
-    struct sockaddr_in server_addr;
-
-    sock_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock_fd < 0) {
-        perror("socket");
-        return -1;
-    }
-
-    memset(&server_addr, 0, sizeof(server_addr));
-
-    //Configuracion del servidor
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(SERVER_PORT);
-    if (inet_pton(AF_INET, SERVER_IP, &server_addr.sin_addr) <= 0) {
-        perror("inet_pton (IP inválida)");
-        close(sock_fd);
-        return -1;
-    }
-
-    // Conectar al servidor
-    if (connect(sock_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
-        perror("connect (¿Está el servidor corriendo?)");
-        close(sock_fd);
-        return -1;
-    }
-    
-    //Enviar comando OP_ADD_BOOK
-    const char *op_code = "OP_ADD_BOOK";
-    uint32_t op_code_len = (uint32_t)strlen(op_code);
-    
-    if(write(sock_fd, &op_code_len, sizeof(op_code_len)) != sizeof(op_code_len)) {
-        perror("write (op_code length)");
-        close(sock_fd);
-        return -1;
-    }
-    if(write(sock_fd, op_code, op_code_len) != (ssize_t)op_code_len) {
-        perror("write (op_code)");
-        close(sock_fd);
-        return -1;
-    }
-
     //Construir mensaje CSV
     char buffer[MAX_QUERY_LEN * 2];
     snprintf(buffer, sizeof(buffer), "%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s",
@@ -254,22 +429,14 @@ int perform_add_book(void) {
              star_3_count, star_2_count, star_1_count, total_rating);
 
 
-    //Enviar la línea CSV al servidor
+    //Enviar OP_ADD_BOOK con la línea CSV al servidor (por la conexion persistente)
     uint32_t data_len = (uint32_t)strlen(buffer);
-    if (write(sock_fd, &data_len, sizeof(data_len)) != sizeof(data_len)) { //Envia tamano del mensaje
-        perror("write (data_len)");
-        close(sock_fd);
-        return -1;
-    }
-    if (write(sock_fd, buffer, data_len) != (ssize_t)data_len) { //Envia el mensaje
-        perror("write (data)");
-        close(sock_fd);
-        return -1;
-    }
+    int sock_fd = send_request(PROTO_OP_ADD_BOOK, buffer, data_len);
+    if (sock_fd < 0) return -1;
 
     //Recibir confirmación del servidor
     uint32_t server_response;
-    ssize_t resp_len = read(sock_fd, &server_response, sizeof(server_response));
+    ssize_t resp_len = safe_read_full(sock_fd, &server_response, sizeof(server_response));
 
     if (resp_len == sizeof(server_response)) {
         // (Opcional, pero bueno para endianness: server_response = ntohl(server_response);)
@@ -278,13 +445,13 @@ int perform_add_book(void) {
         } else {
             printf("Respuesta del servidor: Error al agregar el libro.\n");
         }
-    } else if (resp_len == 0) {
+    } else if (resp_len >= 0) {
         printf("Respuesta del servidor: El servidor cerró la conexión.\n");
+        drop_connection();
     } else {
         perror("read (response)");
+        drop_connection();
     }
-
-    close(sock_fd);
     return 0;
 }
 
@@ -315,7 +482,26 @@ static void print_menu(const char *current_title) {
     printf("Seleccione una opción: ");
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+    signal(SIGPIPE, SIG_IGN); // Si el servidor cerro la conexion, write falla con EPIPE y se reconecta
+
+    if (argc == 3 && strcmp(argv[1], "--batch") == 0) { // Busquedas en lote sin menu
+        int status = perform_batch(argv[2]);
+        drop_connection();
+        return status == 0 ? 0 : 1;
+    }
+    if (argc == 3 && strcmp(argv[1], "--multi") == 0) { // Busquedas en lote con OP_MULTI_LOOKUP
+        int status = perform_multi(argv[2]);
+        drop_connection();
+        return status == 0 ? 0 : 1;
+    }
+
+    if (argc == 2 && strcmp(argv[1], "--stats") == 0) { // Contadores del servidor (OP_STATS)
+        int status = perform_stats();
+        drop_connection();
+        return status == 0 ? 0 : 1;
+    }
+
     char current_title[MAX_QUERY_LEN] = {0};  
     char input_buffer[MAX_QUERY_LEN] = {0}; // Buffer temporal para usar con fgets
     int choice = 0; // Opcion del menu
@@ -363,5 +549,6 @@ int main() {
         }
     }
 
+    drop_connection();
     return 0;
 }
\ No newline at end of file
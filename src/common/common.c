@@ -42,3 +42,39 @@ ssize_t safe_pwrite(int fd, const void *buf, size_t count, off_t offset) {
     return total;
 }
 
+ssize_t safe_read_full(int fd, void *buf, size_t count) {
+    size_t total = 0;
+    char *p = (char*)buf;
+    while (total < count) {
+        ssize_t r = read(fd, p + total, count - total);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (r == 0) break;
+        total += (size_t)r;
+    }
+    return (ssize_t)total;
+}
+
+ssize_t safe_write_full(int fd, const void *buf, size_t count) {
+    size_t total = 0;
+    const char *p = (const char*)buf;
+    while (total < count) {
+        ssize_t w = write(fd, p + total, count - total);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        total += (size_t)w;
+    }
+    return (ssize_t)total;
+}
+
+int index_dir_create(void) {
+    if (mkdir(INDEX_DIR, 0755) < 0 && errno != EEXIST) { // Si ya existe se ignora el error
+        fprintf(stderr, "mkdir %s fallo: %s\n", INDEX_DIR, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
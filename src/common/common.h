@@ -6,14 +6,13 @@
 #include <unistd.h>
 #include <sys/types.h>
 
-#define BUCKET_ENTRY_SIZE 8
+#define BUCKET_ENTRY_SIZE 24 // head (8) + extent_off (8) + extent_len (4) + extent_count (4)
 
 #define CSV_PATH "data/dataset/books_data.csv"
 #define INDEX_DIR "data/index"
 #define NUM_DATASET_FIELDS 13
-#define NUM_BUCKETS 1048576 // Debe ser potencia de dos
 #define TITLE_FIELD 0
-#define DEFAULT_HASH_SEED 0x12345678abcdefULL
+#define DEFAULT_HASH_SEED 0x12345678abcdefULL // Semilla de los indices nuevos (cada indice guarda la suya)
 
 #define KEY_PREFIX_LEN 20 // lenght for a matching search 
 
@@ -21,4 +20,13 @@
 ssize_t safe_pread(int fd, void *buf, size_t count, off_t offset);
 ssize_t safe_pwrite(int fd, const void *buf, size_t count, off_t offset);
 
+/* Lee/escribe exactamente count bytes (reintenta lecturas/escrituras parciales y EINTR).
+ * safe_read_full retorna menos de count solo si se llega a EOF */
+ssize_t safe_read_full(int fd, void *buf, size_t count);
+ssize_t safe_write_full(int fd, const void *buf, size_t count);
+
+/* Crea INDEX_DIR si no existe. Toda construccion la llama antes de escribir el primer archivo
+ * del indice. Retorna 0, o -1 si falla */
+int index_dir_create(void);
+
 #endif // COMMON_H
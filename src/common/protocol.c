@@ -0,0 +1,33 @@
+#include "protocol.h"
+#include "common.h"
+#include <stdlib.h>
+#include <string.h>
+
+proto_op_t proto_op_from_name(const char *name, size_t len) {
+    if (name == NULL) return OP_UNKNOWN;
+    if (len == strlen(PROTO_OP_LOOKUP) && memcmp(name, PROTO_OP_LOOKUP, len) == 0) return OP_LOOKUP;
+    if (len == strlen(PROTO_OP_ADD_BOOK) && memcmp(name, PROTO_OP_ADD_BOOK, len) == 0) return OP_ADD_BOOK;
+    if (len == strlen(PROTO_OP_MULTI_LOOKUP) && memcmp(name, PROTO_OP_MULTI_LOOKUP, len) == 0) return OP_MULTI_LOOKUP;
+    if (len == strlen(PROTO_OP_STATS) && memcmp(name, PROTO_OP_STATS, len) == 0) return OP_STATS;
+    return OP_UNKNOWN;
+}
+
+int proto_send_frame(int fd, const char *op, const void *body, uint32_t body_len) {
+    uint32_t op_len = (uint32_t)strlen(op);
+    size_t frame_len = sizeof(uint32_t) + op_len + sizeof(uint32_t) + body_len;
+    char *frame = malloc(frame_len); // Una sola escritura evita paquetes pequeños en la red
+    if (frame == NULL) return -1;
+
+    size_t pos = 0;
+    memcpy(frame + pos, &op_len, sizeof(op_len));
+    pos += sizeof(op_len);
+    memcpy(frame + pos, op, op_len);
+    pos += op_len;
+    memcpy(frame + pos, &body_len, sizeof(body_len));
+    pos += sizeof(body_len);
+    if (body_len > 0) memcpy(frame + pos, body, body_len);
+
+    ssize_t w = safe_write_full(fd, frame, frame_len);
+    free(frame);
+    return w == (ssize_t)frame_len ? 0 : -1;
+}
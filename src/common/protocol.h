@@ -0,0 +1,45 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Protocolo cliente-servidor. Cada peticion es una trama:
+ *   [uint32_t op_len][char op[op_len]][uint32_t body_len][char body[body_len]]
+ * La conexion es persistente: el cliente puede enviar muchas tramas seguidas sin esperar
+ * respuesta (pipelining) y el servidor responde en el mismo orden en que las recibio.
+ * La conexion se cierra cuando el cliente la cierra (o ante una trama invalida).
+ * Respuestas:
+ *   OP_LOOKUP:   [int32_t count] seguido de count x [uint32_t line_len][char line[line_len]]
+ *   OP_ADD_BOOK: [uint32_t ok] (1 = exito, 0 = error)
+ *   OP_MULTI_LOOKUP: el cuerpo es [uint32_t n] seguido de n x [uint32_t len][char title[len]];
+ *                la respuesta es [int32_t n] (-1 = error) seguido de n grupos, cada uno con el
+ *                mismo formato que la respuesta de OP_LOOKUP, en el orden de los titulos.
+ *   OP_STATS:    cuerpo vacio; la respuesta es [uint32_t len][char text[len]], una linea
+ *                "nombre valor" por contador (aciertos y fallos del cache, etc.).
+ */
+
+#define PROTO_OP_LOOKUP   "OP_LOOKUP"
+#define PROTO_OP_ADD_BOOK "OP_ADD_BOOK"
+#define PROTO_OP_MULTI_LOOKUP "OP_MULTI_LOOKUP"
+#define PROTO_OP_STATS    "OP_STATS"
+
+#define PROTO_MAX_OP_LEN   63          // Longitud maxima del nombre de la operacion
+#define PROTO_MAX_BODY_LEN (16u << 20) // Longitud maxima del cuerpo de una peticion
+#define PROTO_MAX_MULTI_KEYS 65536     // Titulos maximos en un OP_MULTI_LOOKUP
+
+typedef enum {
+    OP_UNKNOWN = 0,
+    OP_LOOKUP,
+    OP_ADD_BOOK,
+    OP_MULTI_LOOKUP,
+    OP_STATS
+} proto_op_t;
+
+/* Envia una trama completa con una sola escritura. Retorna 0 o -1 */
+int proto_send_frame(int fd, const char *op, const void *body, uint32_t body_len);
+
+/* Traduce el nombre de una operacion (no necesariamente terminado en '\0') */
+proto_op_t proto_op_from_name(const char *name, size_t len);
+
+#endif // PROTOCOL_H
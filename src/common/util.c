@@ -2,91 +2,176 @@
 #include "common.h"
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
-/* normalized_strcmp: compares normalized versions of a and b.
- * returns same semantics as strcmp.
- * handles NULL pointers (treat as empty).
- */
-int normalized_strcmp(const char *a, const char *b) {
-    char *na = normalize_string(a ? a : "");
-    char *nb = normalize_string(b ? b : "");
-    if (!na || !nb) {
-        if (na) free(na);
-        if (nb) free(nb);
-        return strcmp(a ? a : "", b ? b : "");
-    }
-    int r = strcmp(na, nb);
-    free(na);
-    free(nb);
-    return r;
-}
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UTIL_X86 1
+#endif
 
-char *normalize_string(const char *s) {
-    if (s == NULL) {
-        char *empty = malloc(1);
-        if (empty) empty[0] = '\0';
-        return empty;
-    }
+#define NORM_LEAD 1          // En norm_class: primer byte de una letra latina de 2 bytes (U+00C0-U+017F)
+#define LATIN_FOLD_FIRST 0xC0
+#define LATIN_FOLD_LAST 0x17F
 
-    size_t in_len = strlen(s);
-    char *out = malloc(in_len + 1); // worst-case buffer: same length + 1
-    if (!out) return NULL;
+/* Clase de cada byte: 0 se descarta, NORM_LEAD empieza una secuencia que se busca en latin_fold, y
+ * cualquier otro valor es el byte de salida (ASCII alfanumerico en minuscula). Los demas bytes de
+ * UTF-8 (otros prefijos y continuaciones) se descartan de a uno */
+static const unsigned char norm_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 0, 0, 0, 0, 0, 0,
+    0, 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
+    'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z', 0, 0, 0, 0, 0,
+    0, 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
+    'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z', 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, NORM_LEAD, NORM_LEAD, NORM_LEAD, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
 
-    size_t i = 0;
-    size_t out_idx = 0;
-    
-    while (s[i] != '\0' ) {
-        unsigned char c1 = s[i];
+/* Letra base de cada codigo U+00C0-U+017F (Latin-1 y Latin Extended-A): se quitan los diacriticos,
+ * las ligaduras se separan y los simbolos (× ÷) se descartan */
+static const char latin_fold[LATIN_FOLD_LAST - LATIN_FOLD_FIRST + 1][3] = {
+    "a", "a", "a", "a", "a", "a", "ae", "c", // À Á Â Ã Ä Å Æ Ç
+    "e", "e", "e", "e", "i", "i", "i", "i", // È É Ê Ë Ì Í Î Ï
+    "d", "n", "o", "o", "o", "o", "o", "", // Ð Ñ Ò Ó Ô Õ Ö ×
+    "o", "u", "u", "u", "u", "y", "th", "ss", // Ø Ù Ú Û Ü Ý Þ ß
+    "a", "a", "a", "a", "a", "a", "ae", "c", // à á â ã ä å æ ç
+    "e", "e", "e", "e", "i", "i", "i", "i", // è é ê ë ì í î ï
+    "d", "n", "o", "o", "o", "o", "o", "", // ð ñ ò ó ô õ ö ÷
+    "o", "u", "u", "u", "u", "y", "th", "y", // ø ù ú û ü ý þ ÿ
+    "a", "a", "a", "a", "a", "a", "c", "c", // Ā ā Ă ă Ą ą Ć ć
+    "c", "c", "c", "c", "c", "c", "d", "d", // Ĉ ĉ Ċ ċ Č č Ď ď
+    "d", "d", "e", "e", "e", "e", "e", "e", // Đ đ Ē ē Ĕ ĕ Ė ė
+    "e", "e", "e", "e", "g", "g", "g", "g", // Ę ę Ě ě Ĝ ĝ Ğ ğ
+    "g", "g", "g", "g", "h", "h", "h", "h", // Ġ ġ Ģ ģ Ĥ ĥ Ħ ħ
+    "i", "i", "i", "i", "i", "i", "i", "i", // Ĩ ĩ Ī ī Ĭ ĭ Į į
+    "i", "i", "ij", "ij", "j", "j", "k", "k", // İ ı Ĳ ĳ Ĵ ĵ Ķ ķ
+    "k", "l", "l", "l", "l", "l", "l", "l", // ĸ Ĺ ĺ Ļ ļ Ľ ľ Ŀ
+    "l", "l", "l", "n", "n", "n", "n", "n", // ŀ Ł ł Ń ń Ņ ņ Ň
+    "n", "n", "n", "n", "o", "o", "o", "o", // ň ŉ Ŋ ŋ Ō ō Ŏ ŏ
+    "o", "o", "oe", "oe", "r", "r", "r", "r", // Ő ő Œ œ Ŕ ŕ Ŗ ŗ
+    "r", "r", "s", "s", "s", "s", "s", "s", // Ř ř Ś ś Ŝ ŝ Ş ş
+    "s", "s", "t", "t", "t", "t", "t", "t", // Š š Ţ ţ Ť ť Ŧ ŧ
+    "u", "u", "u", "u", "u", "u", "u", "u", // Ũ ũ Ū ū Ŭ ŭ Ů ů
+    "u", "u", "u", "u", "w", "w", "y", "y", // Ű ű Ų ų Ŵ ŵ Ŷ ŷ
+    "y", "z", "z", "z", "z", "z", "z", "s", // Ÿ Ź ź Ż ż Ž ž ſ
+};
 
-        // Manejo de caracteres ASCII de 1 byte (los más comunes)
-        if (c1 < 128) {
-            char lower = tolower(c1);
-            if ((lower >= 'a' && lower <= 'z') || (lower >= '0' && lower <= '9')) {
-                out[out_idx++] = lower;
+// Recorre la normalizacion de [p, end) un byte de salida a la vez, sin escribirla en ningun lado
+typedef struct {
+    const unsigned char *p;
+    const unsigned char *end;
+    const char *pending; // Resto de un plegado de dos letras (ß -> ss)
+} norm_iter_t;
+
+// Siguiente byte de la salida, o '\0' al terminar
+static unsigned char norm_next(norm_iter_t *it) {
+    if (it->pending != NULL && *it->pending != '\0') return (unsigned char)*it->pending++;
+    while (it->p < it->end) {
+        unsigned char cls = norm_class[*it->p];
+        if (cls > NORM_LEAD) {
+            it->p++;
+            return cls;
+        }
+        // Una secuencia cortada (sin byte de continuacion) se descarta sin leer fuera de la entrada
+        if (cls == NORM_LEAD && it->end - it->p >= 2 && (it->p[1] & 0xC0) == 0x80) {
+            unsigned cp = ((unsigned)(it->p[0] & 0x1F) << 6) | (it->p[1] & 0x3F);
+            it->p += 2;
+            const char *fold = latin_fold[cp - LATIN_FOLD_FIRST];
+            if (fold[0] != '\0') {
+                it->pending = fold + 1;
+                return (unsigned char)fold[0];
             }
-            i++;
             continue;
         }
+        it->p++;
+    }
+    return '\0';
+}
 
-        // Manejo de caracteres UTF-8 de 2 bytes para español
-        if (c1 == 0xc3) {
-            unsigned char c2 = s[i+1];
-            switch (c2) {
-                case 0x81: // Á
-                case 0xa1: // á
-                    out[out_idx++] = 'a';
-                    break;
-                case 0x89: // É
-                case 0xa9: // é
-                    out[out_idx++] = 'e';
-                    break;
-                case 0x8d: // Í
-                case 0xad: // í
-                    out[out_idx++] = 'i';
-                    break;
-                case 0x93: // Ó
-                case 0xb3: // ó
-                    out[out_idx++] = 'o';
-                    break;
-                case 0x9a: // Ú
-                case 0xba: // ú
-                    out[out_idx++] = 'u';
-                    break;
-                case 0x91: // Ñ
-                case 0xb1: // ñ
-                    out[out_idx++] = 'n';
-                    break;
-                default:
-                    // Si es un carácter UTF-8 que no manejamos, lo ignoramos
-                    break;
-            }
+#ifdef UTIL_X86
+/* Tramos ASCII de 16 bytes: minusculas con una suma y los alfanumericos se compactan con la mascara.
+ * Procesa desde *ip mientras haya 16 bytes ASCII de entrada y 16 de espacio en la salida */
+static void normalize_ascii_sse2(const unsigned char *s, size_t len, size_t *ip, char *out, size_t *op,
+                                 size_t max_out) {
+    const __m128i upper_lo = _mm_set1_epi8('A' - 1), upper_hi = _mm_set1_epi8('Z' + 1);
+    const __m128i lower_lo = _mm_set1_epi8('a' - 1), lower_hi = _mm_set1_epi8('z' + 1);
+    const __m128i digit_lo = _mm_set1_epi8('0' - 1), digit_hi = _mm_set1_epi8('9' + 1);
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    size_t i = *ip, o = *op;
+    while (len - i >= 16 && max_out - o >= 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(s + i));
+        if (_mm_movemask_epi8(x) != 0) break; // Hay bytes no ASCII: los resuelve la tabla
+        // Solo ASCII: las comparaciones con signo sirven
+        __m128i is_upper = _mm_and_si128(_mm_cmpgt_epi8(x, upper_lo), _mm_cmplt_epi8(x, upper_hi));
+        x = _mm_add_epi8(x, _mm_and_si128(is_upper, case_bit));
+        __m128i keep = _mm_or_si128(_mm_and_si128(_mm_cmpgt_epi8(x, lower_lo), _mm_cmplt_epi8(x, lower_hi)),
+                                    _mm_and_si128(_mm_cmpgt_epi8(x, digit_lo), _mm_cmplt_epi8(x, digit_hi)));
+        unsigned mask = (unsigned)_mm_movemask_epi8(keep);
+        if (mask == 0xFFFF) {
+            _mm_storeu_si128((__m128i *)(out + o), x);
+            o += 16;
+        } else {
+            char lowered[16];
+            _mm_storeu_si128((__m128i *)lowered, x);
+            for (; mask != 0; mask &= mask - 1) out[o++] = lowered[__builtin_ctz(mask)];
+        }
+        i += 16;
+    }
+    *ip = i;
+    *op = o;
+}
+#endif
+
+/* Igual que normalize_into pero para cuando la salida llega a max_out bytes (out de max_out + 1):
+ * el prefijo de la llave normalizada, sin normalizar el resto */
+static size_t normalize_prefix(const char *s, size_t len, char *out, size_t max_out) {
+    const unsigned char *u = (const unsigned char *)s;
+    size_t i = 0, o = 0;
+    while (i < len && o < max_out) {
+#ifdef UTIL_X86
+        normalize_ascii_sse2(u, len, &i, out, &o, max_out);
+        if (i >= len || o >= max_out) break;
+#endif
+        unsigned char cls = norm_class[u[i]];
+        if (cls > NORM_LEAD) {
+            out[o++] = (char)cls;
+            i++;
+        } else if (cls == NORM_LEAD && len - i >= 2 && (u[i + 1] & 0xC0) == 0x80) {
+            unsigned cp = ((unsigned)(u[i] & 0x1F) << 6) | (u[i + 1] & 0x3F);
+            const char *fold = latin_fold[cp - LATIN_FOLD_FIRST];
+            for (int k = 0; fold[k] != '\0' && o < max_out; k++) out[o++] = fold[k];
             i += 2;
         } else {
             i++;
         }
     }
-    
-    out[out_idx] = '\0';
-    return out;
+    out[o] = '\0';
+    return o;
+}
+
+size_t normalize_into(const char *s, size_t len, char *out) {
+    return normalize_prefix(s, len, out, len);
+}
+
+/* normalized_strcmp: compares normalized versions of a and b.
+ * returns same semantics as strcmp.
+ * handles NULL pointers (treat as empty).
+ */
+int normalized_strcmp(const char *a, const char *b) {
+    a = a ? a : "";
+    b = b ? b : "";
+    norm_iter_t ia = {(const unsigned char *)a, (const unsigned char *)a + strlen(a), NULL};
+    norm_iter_t ib = {(const unsigned char *)b, (const unsigned char *)b + strlen(b), NULL};
+    for (;;) {
+        unsigned char ca = norm_next(&ia);
+        unsigned char cb = norm_next(&ib);
+        if (ca != cb || ca == '\0') return (int)ca - (int)cb;
+    }
 }
@@ -4,6 +4,13 @@
 #include <stdint.h>
 #include <stddef.h>
 
+/* Normalizacion de llaves: se conservan las letras y digitos ASCII en minuscula, las letras latinas
+ * con diacritico en UTF-8 (Latin-1 y Latin Extended-A) se pliegan a su letra base (á -> a, ß -> ss)
+ * y todo lo demas se descarta. La salida nunca es mas larga que la entrada */
+
+// Normaliza los len bytes de s en out (len + 1 bytes, termina en '\0'). Retorna la longitud de la salida
+size_t normalize_into(const char *s, size_t len, char *out);
+
+// Compara las versiones normalizadas de a y b (NULL = ""), con la semantica de strcmp. Sin malloc
 int normalized_strcmp(const char *a, const char *b);
-char *normalize_string(const char *s);
 #endif // UTIL_H
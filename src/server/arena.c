@@ -0,0 +1,61 @@
+#include "arena.h"
+#include <stdlib.h>
+
+#define ARENA_ALIGN 8
+
+struct arena_block {
+    arena_block_t *next;
+    size_t size;   // Bytes utiles del bloque
+    size_t used;
+    unsigned char data[];
+};
+
+void arena_init(arena_t *a, size_t block_size) {
+    a->head = NULL;
+    a->cur = NULL;
+    a->block_size = block_size;
+}
+
+void *arena_alloc(arena_t *a, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    // Buscar espacio en el bloque actual o en los siguientes (ya reservados en peticiones anteriores)
+    while (a->cur != NULL) {
+        if (a->cur->size - a->cur->used >= size) {
+            void *p = a->cur->data + a->cur->used;
+            a->cur->used += size;
+            return p;
+        }
+        if (a->cur->next == NULL) break;
+        a->cur = a->cur->next;
+        a->cur->used = 0;
+    }
+
+    // Agregar un bloque nuevo al final
+    size_t block_size = size > a->block_size ? size : a->block_size;
+    arena_block_t *b = malloc(sizeof(arena_block_t) + block_size);
+    if (b == NULL) return NULL;
+    b->next = NULL;
+    b->size = block_size;
+    b->used = size;
+    if (a->cur) a->cur->next = b;
+    else a->head = b;
+    a->cur = b;
+    return b->data;
+}
+
+void arena_reset(arena_t *a) {
+    a->cur = a->head;
+    if (a->cur) a->cur->used = 0;
+}
+
+void arena_free(arena_t *a) {
+    arena_block_t *b = a->head;
+    while (b) {
+        arena_block_t *next = b->next;
+        free(b);
+        b = next;
+    }
+    a->head = NULL;
+    a->cur = NULL;
+}
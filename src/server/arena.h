@@ -0,0 +1,28 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* Arena (bump allocator) para memoria que vive lo mismo que una peticion.
+ * arena_reset no libera los bloques: en estado estable una peticion no hace ningun malloc. */
+
+typedef struct arena_block arena_block_t;
+
+typedef struct {
+    arena_block_t *head;   // Primer bloque
+    arena_block_t *cur;    // Bloque del que se esta asignando
+    size_t block_size;     // Tamaño de los bloques nuevos
+} arena_t;
+
+void arena_init(arena_t *a, size_t block_size);
+
+/* Retorna size bytes alineados a 8, o NULL si falla malloc */
+void *arena_alloc(arena_t *a, size_t size);
+
+/* Libera de golpe todo lo asignado (los bloques se conservan para reutilizarlos) */
+void arena_reset(arena_t *a);
+
+/* Devuelve todos los bloques al sistema */
+void arena_free(arena_t *a);
+
+#endif // ARENA_H
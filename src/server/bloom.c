@@ -0,0 +1,176 @@
+#define _GNU_SOURCE
+#include "bloom.h"
+#include "common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Menor potencia de dos de bloques con BLOOM_BITS_PER_KEY bits por llave
+static uint64_t blocks_for(uint64_t expected_keys) {
+    uint64_t nblocks = BLOOM_MIN_BLOCKS;
+    while (nblocks * BLOOM_BLOCK_SIZE * 8 < expected_keys * BLOOM_BITS_PER_KEY) nblocks *= 2;
+    return nblocks;
+}
+
+size_t bloom_size(uint64_t expected_keys) {
+    return (size_t)blocks_for(expected_keys) * BLOOM_BLOCK_SIZE;
+}
+
+int bloom_init(bloom_t *b, uint64_t expected_keys, uint64_t seed) {
+    uint64_t nblocks = blocks_for(expected_keys);
+    b->seed = seed;
+    b->nblocks = nblocks;
+    b->map = NULL;
+    b->map_len = 0;
+    b->words = calloc(nblocks * BLOOM_BLOCK_WORDS, sizeof(uint64_t));
+    if (b->words == NULL) {
+        perror("calloc (bloom)");
+        return -1;
+    }
+    return 0;
+}
+
+void bloom_add(bloom_t *b, uint64_t hash) {
+    uint64_t *block = b->words + bloom_block_of(b, hash) * BLOOM_BLOCK_WORDS;
+    for (int i = 0; i < BLOOM_BLOCK_WORDS; i++) block[i] |= bloom_word_mask(hash, i);
+}
+
+static void encode_header(const bloom_t *b, unsigned char *buf) {
+    uint64_t magic = BLOOM_MAGIC;
+    uint32_t version = BLOOM_FORMAT_VERSION;
+    memset(buf, 0, BLOOM_HEADER_SIZE);
+    memcpy(buf, &magic, 8);
+    memcpy(buf + 8, &version, 4);
+    memcpy(buf + 16, &b->seed, 8);
+    memcpy(buf + 24, &b->nblocks, 8);
+}
+
+// Lee el encabezado y valida formato, semilla y tamaño del archivo (file_size bytes)
+static int decode_header(const unsigned char *buf, uint64_t seed, size_t file_size, bloom_t *b) {
+    uint64_t magic;
+    uint32_t version;
+    memcpy(&magic, buf, 8);
+    memcpy(&version, buf + 8, 4);
+    memcpy(&b->seed, buf + 16, 8);
+    memcpy(&b->nblocks, buf + 24, 8);
+    if (magic != BLOOM_MAGIC || version != BLOOM_FORMAT_VERSION || b->seed != seed) return -1;
+    if (b->nblocks == 0 || (b->nblocks & (b->nblocks - 1)) != 0) return -1;
+    if (file_size != BLOOM_HEADER_SIZE + b->nblocks * BLOOM_BLOCK_SIZE) return -1;
+    return 0;
+}
+
+int bloom_write(const bloom_t *b, const char *path) {
+    char tmp_path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    int fd = open(tmp_path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "open %s fallo: %s\n", tmp_path, strerror(errno));
+        return -1;
+    }
+    unsigned char hdr[BLOOM_HEADER_SIZE];
+    encode_header(b, hdr);
+    size_t size = (size_t)b->nblocks * BLOOM_BLOCK_SIZE;
+    if (safe_pwrite(fd, hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+        safe_pwrite(fd, b->words, size, BLOOM_HEADER_SIZE) != (ssize_t)size || fsync(fd) != 0) {
+        fprintf(stderr, "Error, no se pudo escribir el filtro de Bloom\n");
+        close(fd);
+        unlink(tmp_path);
+        return -1;
+    }
+    close(fd);
+    if (rename(tmp_path, path) != 0) {
+        perror("rename (bloom)");
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+int bloom_map(bloom_t *b, const char *path, uint64_t seed) {
+    b->words = NULL;
+    b->map = NULL;
+    b->map_len = 0;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < BLOOM_HEADER_SIZE) {
+        close(fd);
+        return -1;
+    }
+    // El filtro completo queda en memoria: una consulta no debe esperar al disco
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        perror("mmap (bloom)");
+        return -1;
+    }
+    if (decode_header(p, seed, (size_t)st.st_size, b) != 0) {
+        fprintf(stderr, "Aviso: %s no corresponde al indice, se ignora\n", path);
+        munmap(p, (size_t)st.st_size);
+        return -1;
+    }
+    b->map = p;
+    b->map_len = (size_t)st.st_size;
+    b->words = (uint64_t *)((unsigned char *)p + BLOOM_HEADER_SIZE);
+    return 0;
+}
+
+int bloom_add_file(const char *path, uint64_t seed, const uint64_t *hashes, size_t n) {
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) return errno == ENOENT ? 0 : -1; // Sin filtro no hay nada que mantener
+    struct stat st;
+    unsigned char hdr[BLOOM_HEADER_SIZE];
+    bloom_t b = {.words = NULL, .map = NULL, .map_len = 0};
+    if (fstat(fd, &st) != 0 || safe_pread(fd, hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+        decode_header(hdr, seed, (size_t)st.st_size, &b) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    int status = 0;
+    size_t size = (size_t)b.nblocks * BLOOM_BLOCK_SIZE;
+    if (n * BLOOM_BLOCK_SIZE < size / 4) { // Pocas llaves: se reescriben solo sus bloques
+        uint64_t block[BLOOM_BLOCK_WORDS];
+        for (size_t k = 0; k < n && status == 0; k++) {
+            off_t pos = BLOOM_HEADER_SIZE + (off_t)(bloom_block_of(&b, hashes[k]) * BLOOM_BLOCK_SIZE);
+            if (safe_pread(fd, block, sizeof(block), pos) != (ssize_t)sizeof(block)) {
+                status = -1;
+                break;
+            }
+            for (int i = 0; i < BLOOM_BLOCK_WORDS; i++) block[i] |= bloom_word_mask(hashes[k], i);
+            if (safe_pwrite(fd, block, sizeof(block), pos) != (ssize_t)sizeof(block)) status = -1;
+        }
+    } else { // Muchas llaves (--incremental): el filtro completo se lee, se marca y se escribe
+        b.words = malloc(size);
+        if (b.words == NULL || safe_pread(fd, b.words, size, BLOOM_HEADER_SIZE) != (ssize_t)size) {
+            status = -1;
+        } else {
+            for (size_t k = 0; k < n; k++) bloom_add(&b, hashes[k]);
+            if (safe_pwrite(fd, b.words, size, BLOOM_HEADER_SIZE) != (ssize_t)size) status = -1;
+        }
+        free(b.words);
+    }
+    close(fd);
+    if (status != 0) fprintf(stderr, "Error, no se pudo actualizar el filtro de Bloom\n");
+    return status;
+}
+
+void bloom_remove(const char *path) {
+    if (unlink(path) != 0 && errno != ENOENT) perror("unlink (bloom)");
+}
+
+void bloom_free(bloom_t *b) {
+    if (b->map != NULL) {
+        munmap(b->map, b->map_len);
+    } else {
+        free(b->words);
+    }
+    b->words = NULL;
+    b->map = NULL;
+    b->map_len = 0;
+}
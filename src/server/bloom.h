@@ -0,0 +1,81 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BLOOM_PATH "data/index/title_bloom.dat"
+
+/* Filtro de Bloom por bloques sobre los hashes de las llaves del indice (title_bloom.dat).
+ * Cada hash cae en un bloque de BLOOM_BLOCK_SIZE bytes (una linea de cache) y marca un bit en
+ * cada una de sus BLOOM_BLOCK_WORDS palabras, asi que una consulta lee un solo bloque. Con
+ * BLOOM_BITS_PER_KEY bits por llave o mas (el numero de bloques se redondea a potencia de dos)
+ * los falsos positivos quedan alrededor del 1% o menos. Un hash que no esta en el filtro no
+ * esta en el indice: index_lookup_many responde sin leer el indice.
+ * El filtro se dimensiona al construir (--build, --compact); OP_ADD_BOOK y --incremental marcan
+ * los bits de las llaves nuevas en el mismo archivo, antes de enlazar sus nodos, y los lectores
+ * lo tienen mapeado con MAP_SHARED: ven los bits nuevos sin volver a abrirlo.
+ * Archivo: [uint64 magic][uint32 version][uint32 pad][uint64 seed][uint64 nblocks][pad hasta 64][bloques] */
+#define BLOOM_HEADER_SIZE 64
+#define BLOOM_MAGIC 0x314d4c4249444e49ULL // "INDIBLM1"
+#define BLOOM_FORMAT_VERSION 1
+#define BLOOM_BLOCK_WORDS 8
+#define BLOOM_BLOCK_SIZE (BLOOM_BLOCK_WORDS * sizeof(uint64_t))
+#define BLOOM_BITS_PER_KEY 10
+#define BLOOM_MIN_BLOCKS 16  // Potencia de dos
+
+typedef struct {
+    uint64_t seed;     // Semilla de los hashes (la del encabezado del indice)
+    uint64_t nblocks;  // Potencia de dos
+    uint64_t *words;   // nblocks * BLOOM_BLOCK_WORDS palabras (malloc, o dentro de map); NULL = sin filtro
+    void *map;         // bloom_map: archivo mapeado (NULL si words es de malloc)
+    size_t map_len;
+} bloom_t;
+
+// Filtro vacio para unas expected_keys llaves. Retorna 0, o -1 si falla malloc
+int bloom_init(bloom_t *b, uint64_t expected_keys, uint64_t seed);
+
+// Bytes de los bloques que reserva bloom_init para unas expected_keys llaves
+size_t bloom_size(uint64_t expected_keys);
+
+// Bloque y mascaras de un hash: bloque por los 32 bits altos, un bit por palabra con los 32 bajos
+static inline uint64_t bloom_block_of(const bloom_t *b, uint64_t hash) {
+    return (hash >> 32) & (b->nblocks - 1);
+}
+
+static inline uint64_t bloom_word_mask(uint64_t hash, int i) {
+    static const uint32_t salt[BLOOM_BLOCK_WORDS] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                                                     0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+    return 1ULL << (((uint32_t)hash * salt[i]) >> 26);
+}
+
+void bloom_add(bloom_t *b, uint64_t hash);
+
+// 0 si hash seguro no esta en el indice; 1 si puede estar (o si no hay filtro)
+static inline int bloom_may_contain(const bloom_t *b, uint64_t hash) {
+    if (b->words == NULL) return 1;
+    const uint64_t *block = b->words + bloom_block_of(b, hash) * BLOOM_BLOCK_WORDS;
+    for (int i = 0; i < BLOOM_BLOCK_WORDS; i++) {
+        if ((block[i] & bloom_word_mask(hash, i)) == 0) return 0;
+    }
+    return 1;
+}
+
+// Escribe el filtro en path (archivo temporal + rename). Retorna 0, o -1 si falla
+int bloom_write(const bloom_t *b, const char *path);
+
+/* Mapea el filtro de path en solo lectura. Retorna 0, o -1 (b->words = NULL) si no existe, no
+ * tiene el formato actual o se construyo con otra semilla */
+int bloom_map(bloom_t *b, const char *path, uint64_t seed);
+
+/* Marca n hashes en el archivo del filtro (en su lugar: los lectores que lo tienen mapeado los
+ * ven). Si el archivo no existe no hay nada que marcar. Retorna 0, o -1 si falla (el filtro ya no
+ * cubre el indice: borrarlo con bloom_remove) */
+int bloom_add_file(const char *path, uint64_t seed, const uint64_t *hashes, size_t n);
+
+// Borra el archivo del filtro: sin filtro, las busquedas leen el indice
+void bloom_remove(const char *path);
+
+void bloom_free(bloom_t *b);
+
+#endif // BLOOM_H
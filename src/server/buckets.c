@@ -1,31 +1,116 @@
 #include "buckets.h"
 #include "common.h"
+#include "page_pool.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
-#include <sys/stat.h>
 
-// Crea el archivo de buckets
-int buckets_create(const char *path) {
-    if (mkdir("data/index", 0755) < 0 && errno != EEXIST) { // Crea un directorio si hace falta, si ya existe ignora el error
-        printf("mkdir data/index failed: %s\n", strerror(errno));
+static uint64_t table_generation = 0; // Ver buckets_generation
+
+void buckets_header_init(buckets_header_t *hdr, uint64_t expected_entries) {
+    uint64_t level_size = BUCKETS_MIN_COUNT;
+    while (level_size * BUCKETS_TARGET_LOAD_PCT < expected_entries * 100) level_size *= 2;
+    hdr->version = BUCKETS_FORMAT_VERSION;
+    hdr->max_load_pct = BUCKETS_MAX_LOAD_PCT;
+    hdr->seed = DEFAULT_HASH_SEED;
+    hdr->level_size = level_size;
+    hdr->split = 0;
+    hdr->num_buckets = level_size;
+    hdr->entry_count = 0;
+    hdr->nodes_gen = 0;
+    hdr->engine = BUCKETS_ENGINE_CHAIN;
+    hdr->hash = HASH_FNV1A_PREFIX;
+}
+
+// [magic][version u32][max_load_pct u32][seed][level_size][split][num_buckets][entry_count][nodes_gen][engine u32][hash u32]
+void buckets_encode_header(const buckets_header_t *hdr, unsigned char *buf) {
+    uint64_t magic = BUCKETS_MAGIC;
+    memset(buf, 0, BUCKETS_HEADER_SIZE);
+    memcpy(buf, &magic, 8);
+    memcpy(buf + 8, &hdr->version, 4);
+    memcpy(buf + 12, &hdr->max_load_pct, 4);
+    memcpy(buf + 16, &hdr->seed, 8);
+    memcpy(buf + 24, &hdr->level_size, 8);
+    memcpy(buf + 32, &hdr->split, 8);
+    memcpy(buf + 40, &hdr->num_buckets, 8);
+    memcpy(buf + 48, &hdr->entry_count, 8);
+    memcpy(buf + 56, &hdr->nodes_gen, 8);
+    memcpy(buf + 64, &hdr->engine, 4);
+    memcpy(buf + 68, &hdr->hash, 4);
+}
+
+int buckets_decode_header(const unsigned char *buf, buckets_header_t *hdr) {
+    uint64_t magic;
+    memcpy(&magic, buf, 8);
+    memcpy(&hdr->version, buf + 8, 4);
+    memcpy(&hdr->max_load_pct, buf + 12, 4);
+    memcpy(&hdr->seed, buf + 16, 8);
+    memcpy(&hdr->level_size, buf + 24, 8);
+    memcpy(&hdr->split, buf + 32, 8);
+    memcpy(&hdr->num_buckets, buf + 40, 8);
+    memcpy(&hdr->entry_count, buf + 48, 8);
+    memcpy(&hdr->nodes_gen, buf + 56, 8);
+    memcpy(&hdr->engine, buf + 64, 4);
+    memcpy(&hdr->hash, buf + 68, 4); // Los indices de antes tienen 0 (HASH_FNV1A_PREFIX)
+    if (magic != BUCKETS_MAGIC || hdr->version != BUCKETS_FORMAT_VERSION || hdr->hash >= HASH_COUNT) return -1;
+    if (hdr->engine != BUCKETS_ENGINE_CHAIN && hdr->engine != BUCKETS_ENGINE_SLOTS &&
+        hdr->engine != BUCKETS_ENGINE_STATIC) {
+        return -1;
+    }
+    if (hdr->engine == BUCKETS_ENGINE_STATIC) return 0; // num_buckets = llaves distintas (no hay niveles)
+    // level_size potencia de dos y split dentro del nivel
+    if (hdr->level_size == 0 || (hdr->level_size & (hdr->level_size - 1)) != 0 || hdr->split >= hdr->level_size ||
+        hdr->num_buckets != hdr->level_size + hdr->split || hdr->max_load_pct == 0) {
+        return -1;
+    }
+    return 0;
+}
+
+int buckets_read_header(int fd, buckets_header_t *hdr) {
+    unsigned char buf[BUCKETS_HEADER_SIZE];
+    if (safe_pread(fd, buf, sizeof(buf), 0) != (ssize_t)sizeof(buf) || buckets_decode_header(buf, hdr) != 0) {
+        fprintf(stderr, "Error: el archivo de buckets no tiene un encabezado valido (reconstruya el indice con --build)\n");
         return -1;
     }
+    return 0;
+}
+
+int buckets_write_header(int fd, const buckets_header_t *hdr) {
+    unsigned char buf[BUCKETS_HEADER_SIZE];
+    buckets_encode_header(hdr, buf);
+    return page_pool_pwrite(fd, buf, sizeof(buf), 0) == (ssize_t)sizeof(buf) ? 0 : -1;
+}
+
+uint64_t buckets_generation(void) {
+    return __atomic_load_n(&table_generation, __ATOMIC_ACQUIRE);
+}
+
+void buckets_generation_bump(void) {
+    __atomic_add_fetch(&table_generation, 1, __ATOMIC_ACQ_REL);
+}
+
+// Crea el archivo de buckets
+int buckets_create(const char *path, const buckets_header_t *hdr) {
     int fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0644); // File descriptor del archivo de buckets
     if (fd < 0) {
         printf("open %s fallo al crear archivo de buckets %s\n", path, strerror(errno));
         return -1;
     }
-    off_t entries_offset = 0; // Llenamos de ceros desde el inicio del archivo
-    size_t entries_size = (size_t)NUM_BUCKETS * BUCKET_ENTRY_SIZE;
+    off_t entries_offset = BUCKETS_HEADER_SIZE; // Llenamos de ceros las entradas, despues del encabezado
+    size_t entries_size = (size_t)hdr->num_buckets * BUCKET_ENTRY_SIZE;
 
     int r = posix_fallocate(fd, entries_offset, entries_size); // posix_fallocate para preasignar ceros al archivo
     if (r != 0) {
         fprintf(stderr, "posix_fallocate fallo al crear archivo de buckets: %s\n", strerror(r));
     }
+    if (buckets_write_header(fd, hdr) != 0) {
+        fprintf(stderr, "Error al escribir el encabezado de %s\n", path);
+        close(fd);
+        return -1;
+    }
     fsync(fd);
     close(fd);
     return 0;
@@ -40,15 +125,11 @@ int buckets_open_readwrite(const char *path) { // To do: Revisar si es factible
 
 // Retorna el offset dado un bucket_id (El hash despues de truncarlo al numero de buckets)
 off_t buckets_entry_offset(uint64_t bucket_id) { // To do: Revisar si es factible eliminar esta funcion y implementar el calculo en lugar de llamar la funcion
-    return (off_t)bucket_id * BUCKET_ENTRY_SIZE;
+    return BUCKETS_HEADER_SIZE + (off_t)bucket_id * BUCKET_ENTRY_SIZE;
 }
 
 // Lee el archivo de buckets en un bucket_id
 off_t buckets_read_head(int fd, uint64_t bucket_id) {
-    if (bucket_id >= NUM_BUCKETS) {
-        fprintf(stderr, "Se intento acceder a un bucket fuera del rango del archivo\n");
-        return 0;
-    }
     off_t pos = buckets_entry_offset(bucket_id); // To do: Revisar si se puede implementar la funcion aqui mismo (Una sola linea)
     unsigned char buf[8]; // To do: Revisar si esto debe ser 'char'
     if (safe_pread(fd, buf, 8, pos) != 8) {
@@ -62,11 +143,75 @@ off_t buckets_read_head(int fd, uint64_t bucket_id) {
 
 // Escribe 'head' en el bucket_id dado
 int buckets_write_head(int fd, uint64_t bucket_id, off_t head) {
-    if (bucket_id >= NUM_BUCKETS) {
-        fprintf(stderr, "Se intento acceder a un bucket fuera del rango del archivo\n");
-        return 1;
-    }
     off_t pos = buckets_entry_offset(bucket_id);
-    if (safe_pwrite(fd, &head, 8, pos) != 8) return -1;
+    if (page_pool_pwrite(fd, &head, 8, pos) != 8) return -1;
+    return 0;
+}
+
+void buckets_encode_entry(const bucket_entry_t *entry, unsigned char *buf) {
+    size_t pos = 0;
+    memcpy(buf + pos, &entry->head, sizeof(off_t));
+    pos += sizeof(off_t);
+    memcpy(buf + pos, &entry->extent_off, sizeof(off_t));
+    pos += sizeof(off_t);
+    memcpy(buf + pos, &entry->extent_len, sizeof(uint32_t));
+    pos += sizeof(uint32_t);
+    memcpy(buf + pos, &entry->extent_count, sizeof(uint32_t));
+}
+
+void buckets_decode_entry(const unsigned char *buf, bucket_entry_t *entry) {
+    size_t pos = 0;
+    memcpy(&entry->head, buf + pos, sizeof(off_t));
+    pos += sizeof(off_t);
+    memcpy(&entry->extent_off, buf + pos, sizeof(off_t));
+    pos += sizeof(off_t);
+    memcpy(&entry->extent_len, buf + pos, sizeof(uint32_t));
+    pos += sizeof(uint32_t);
+    memcpy(&entry->extent_count, buf + pos, sizeof(uint32_t));
+}
+
+// Lee la entrada completa (lista enlazada + extent) de un bucket con un solo pread
+int buckets_read_entry(int fd, uint64_t bucket_id, bucket_entry_t *entry) {
+    unsigned char buf[BUCKET_ENTRY_SIZE];
+    if (safe_pread(fd, buf, BUCKET_ENTRY_SIZE, buckets_entry_offset(bucket_id)) != BUCKET_ENTRY_SIZE) {
+        fprintf(stderr, "Error, no se pudo leer la entrada del bucket\n");
+        return -1;
+    }
+    buckets_decode_entry(buf, entry);
+    return 0;
+}
+
+int buckets_write_entry(int fd, uint64_t bucket_id, const bucket_entry_t *entry) {
+    unsigned char buf[BUCKET_ENTRY_SIZE];
+    buckets_encode_entry(entry, buf);
+    if (page_pool_pwrite(fd, buf, BUCKET_ENTRY_SIZE, buckets_entry_offset(bucket_id)) != BUCKET_ENTRY_SIZE) {
+        fprintf(stderr, "Error, no se pudo escribir la entrada del bucket\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Escribe todas las entradas en bloques grandes (un pwrite por bloque en lugar de uno por fila)
+int buckets_write_heads(int fd, const off_t *heads, uint64_t num_buckets) {
+    const uint64_t per_chunk = 65536; // Entradas por pwrite (1.5 MiB)
+    unsigned char *chunk = malloc((size_t)per_chunk * BUCKET_ENTRY_SIZE);
+    if (chunk == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    for (uint64_t first = 0; first < num_buckets; first += per_chunk) {
+        uint64_t n = num_buckets - first < per_chunk ? num_buckets - first : per_chunk;
+        for (uint64_t i = 0; i < n; i++) {
+            bucket_entry_t entry = {.head = heads[first + i], .extent_off = 0, .extent_len = 0, .extent_count = 0};
+            buckets_encode_entry(&entry, chunk + i * BUCKET_ENTRY_SIZE);
+        }
+        size_t len = (size_t)n * BUCKET_ENTRY_SIZE;
+        if (page_pool_pwrite(fd, chunk, len, buckets_entry_offset(first)) != (ssize_t)len) {
+            perror("pwrite");
+            free(chunk);
+            return -1;
+        }
+    }
+    free(chunk);
     return 0;
 }
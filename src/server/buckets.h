@@ -3,9 +3,79 @@
 
 #include <stdint.h>
 #include "common.h"
+#include "hash.h"
 
-/* Create buckets file with header and num_buckets entries zeroed */
-int buckets_create(const char *path);
+/* title_buckets.dat empieza con un encabezado de BUCKETS_HEADER_SIZE bytes y luego las
+ * entradas de los buckets. La tabla crece con hashing lineal: hay level_size + split buckets;
+ * los buckets menores que split ya se dividieron y se direccionan con un bit mas del hash. */
+#define BUCKETS_HEADER_SIZE 128 // Los bytes sin usar quedan en cero
+#define BUCKETS_MAGIC 0x314b544249444e49ULL // "INDIBTK1"
+#define BUCKETS_FORMAT_VERSION 4 // 3: nodos con una lista de postings por llave; 4: llaves con letras latinas plegadas
+#define BUCKETS_MIN_COUNT 1024       // Potencia de dos
+#define BUCKETS_TARGET_LOAD_PCT 75   // --build: el menor level_size con filas/buckets <= 0.75
+#define BUCKETS_MAX_LOAD_PCT 100     // Al pasar este load factor, cada insercion divide un bucket
+
+// Motor del indice (se elige en --build con --engine)
+#define BUCKETS_ENGINE_CHAIN 0 // Entradas de bucket + title_linked_list.dat (listas y extents)
+#define BUCKETS_ENGINE_SLOTS 1 // Direccionamiento abierto con Robin Hood (ver slots.h)
+#define BUCKETS_ENGINE_STATIC 2 // Hash perfecto minimo de solo lectura (ver static_index.h)
+
+typedef struct {
+    uint32_t version;
+    uint32_t max_load_pct;
+    uint64_t seed;         // Semilla del hash de las llaves
+    uint64_t level_size;   // Potencia de dos
+    uint64_t split;        // Siguiente bucket a dividir (0 <= split < level_size)
+    uint64_t num_buckets;  // level_size + split (entradas en el archivo)
+    uint64_t entry_count;  // Filas en el indice
+    uint64_t nodes_gen;    // Compactaciones del archivo de nodos, que guarda el mismo numero (ver linked_list_check_gen)
+    uint32_t engine;       // BUCKETS_ENGINE_*
+    uint32_t hash;         // HASH_* (funcion de hash de las llaves, ver hash.h)
+} buckets_header_t;
+
+/* Encabezado de un indice nuevo para unas expected_entries filas (split = 0), con la funcion de
+ * hash HASH_FNV1A_PREFIX (el builder pone la que se eligio con --hash) */
+void buckets_header_init(buckets_header_t *hdr, uint64_t expected_entries);
+
+// Hash de una llave normalizada con la funcion y la semilla del indice
+static inline uint64_t buckets_hash_key(const buckets_header_t *hdr, const char *nkey, size_t len) {
+    return hash_key_with(hdr->hash, nkey, len, hdr->seed);
+}
+
+// Bucket de un hash (hashing lineal)
+static inline uint64_t buckets_bucket_of(const buckets_header_t *hdr, uint64_t h) {
+    uint64_t bucket = bucket_id_from_hash(h, hdr->level_size - 1);
+    if (bucket < hdr->split) bucket = bucket_id_from_hash(h, hdr->level_size * 2 - 1);
+    return bucket;
+}
+
+/* Lee/escribe el encabezado. buckets_read_header retorna -1 si el archivo no tiene el formato
+ * actual (un indice de una version anterior se reconstruye con --build) */
+int buckets_read_header(int fd, buckets_header_t *hdr);
+int buckets_write_header(int fd, const buckets_header_t *hdr);
+void buckets_encode_header(const buckets_header_t *hdr, unsigned char *buf);
+int buckets_decode_header(const unsigned char *buf, buckets_header_t *hdr);
+
+/* Generacion de la tabla dentro del proceso: es impar mientras un split cambia el encabezado y
+ * el bucket dividido. Un lector que ve la misma generacion par antes y despues de una busqueda
+ * uso un encabezado coherente con las entradas que leyo */
+uint64_t buckets_generation(void);
+void buckets_generation_bump(void);
+
+/* Entrada de un bucket. Los nodos de un bucket estan en dos lugares:
+ *  - una lista enlazada que empieza en head (nodos agregados despues de compactar);
+ *  - un extent: extent_count nodos seguidos en [extent_off, extent_off + extent_len),
+ *    escrito por la compactacion (un nodo por llave), que se lee con un solo pread.
+ * En el archivo cada entrada ocupa BUCKET_ENTRY_SIZE bytes en este orden. */
+typedef struct {
+    off_t head;            // Primer nodo de la lista enlazada (0 = vacia)
+    off_t extent_off;      // Offset del extent en el archivo de nodos
+    uint32_t extent_len;   // Bytes del extent (0 = sin extent)
+    uint32_t extent_count; // Nodos en el extent
+} bucket_entry_t;
+
+/* Create buckets file with header and num_buckets entries zeroed (INDEX_DIR ya debe existir, ver index_dir_create) */
+int buckets_create(const char *path, const buckets_header_t *hdr);
 
 /* Open buckets file and read header (returns fd or -1) */
 int buckets_open_readwrite(const char *path);
@@ -13,9 +83,23 @@ int buckets_open_readwrite(const char *path);
 /* Read head offset for bucket_id (0..num_buckets-1) */
 off_t buckets_read_head(int fd, uint64_t bucket_id);
 
-/* Write head offset for bucket_id */
+/* Write head offset for bucket_id (el extent del bucket no cambia) */
 int buckets_write_head(int fd, uint64_t bucket_id, off_t head);
 
+/* Lee la entrada completa de bucket_id. Retorna 0, o -1 si falla */
+int buckets_read_entry(int fd, uint64_t bucket_id, bucket_entry_t *entry);
+
+/* Escribe la entrada completa de bucket_id. Retorna 0, o -1 si falla */
+int buckets_write_entry(int fd, uint64_t bucket_id, const bucket_entry_t *entry);
+
+/* Escribe la tabla completa de una vez: heads[i] es la cabeza del bucket i (sin extents).
+ * Se usa al terminar una carga masiva que mantuvo las cabezas en memoria */
+int buckets_write_heads(int fd, const off_t *heads, uint64_t num_buckets);
+
+/* Serializa/deserializa una entrada (buf de BUCKET_ENTRY_SIZE bytes) */
+void buckets_encode_entry(const bucket_entry_t *entry, unsigned char *buf);
+void buckets_decode_entry(const unsigned char *buf, bucket_entry_t *entry);
+
 /* Helper to compute offset in file for bucket entry */
 off_t buckets_entry_offset(uint64_t bucket_id);
 
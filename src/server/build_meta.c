@@ -0,0 +1,132 @@
+#include "build_meta.h"
+#include "common.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define BUILD_META_MAGIC 0x4154454d444c4942ULL // "BILDMETA"
+#define BUILD_META_VERSION 1
+// [magic u64][version u32][dev u64][ino u64][indexed_end off_t][fingerprint u64]
+#define BUILD_META_SIZE (8 + 4 + 8 + 8 + sizeof(off_t) + 8)
+
+// FNV-1a 64 sobre [off, off + len) del archivo, continuando desde h
+static int fingerprint_range(int fd, off_t off, size_t len, uint64_t *h) {
+    unsigned char buf[BUILD_META_CHECK_LEN];
+    ssize_t r = safe_pread(fd, buf, len, off);
+    if (r < 0 || (size_t)r != len) return -1;
+    for (size_t i = 0; i < len; i++) {
+        *h ^= buf[i];
+        *h *= 0x100000001b3ULL;
+    }
+    return 0;
+}
+
+int build_meta_capture(const char *csv_path, off_t indexed_end, build_meta_t *meta) {
+    int fd = open(csv_path, O_RDONLY);
+    if (fd < 0) {
+        perror("open (csv)");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < indexed_end) {
+        close(fd);
+        return -1;
+    }
+    meta->dev = (uint64_t)st.st_dev;
+    meta->ino = (uint64_t)st.st_ino;
+    meta->indexed_end = indexed_end;
+
+    // Inicio (encabezado y primeras filas) y final de la parte indexada
+    uint64_t h = 0xcbf29ce484222325ULL;
+    size_t head_len = indexed_end < BUILD_META_CHECK_LEN ? (size_t)indexed_end : BUILD_META_CHECK_LEN;
+    size_t tail_len = head_len;
+    int status = fingerprint_range(fd, 0, head_len, &h);
+    if (status == 0) status = fingerprint_range(fd, indexed_end - (off_t)tail_len, tail_len, &h);
+    close(fd);
+    meta->fingerprint = h;
+    return status;
+}
+
+int build_meta_read(const char *path, build_meta_t *meta) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    unsigned char buf[BUILD_META_SIZE];
+    ssize_t r = safe_read_full(fd, buf, sizeof(buf));
+    close(fd);
+    if (r != (ssize_t)sizeof(buf)) return -1;
+
+    uint64_t magic;
+    uint32_t version;
+    size_t p = 0;
+    memcpy(&magic, buf + p, 8); p += 8;
+    memcpy(&version, buf + p, 4); p += 4;
+    if (magic != BUILD_META_MAGIC || version != BUILD_META_VERSION) return -1;
+    memcpy(&meta->dev, buf + p, 8); p += 8;
+    memcpy(&meta->ino, buf + p, 8); p += 8;
+    memcpy(&meta->indexed_end, buf + p, sizeof(off_t)); p += sizeof(off_t);
+    memcpy(&meta->fingerprint, buf + p, 8);
+    return meta->indexed_end >= 0 ? 0 : -1;
+}
+
+int build_meta_write(const char *path, const build_meta_t *meta) {
+    unsigned char buf[BUILD_META_SIZE];
+    uint64_t magic = BUILD_META_MAGIC;
+    uint32_t version = BUILD_META_VERSION;
+    size_t p = 0;
+    memcpy(buf + p, &magic, 8); p += 8;
+    memcpy(buf + p, &version, 4); p += 4;
+    memcpy(buf + p, &meta->dev, 8); p += 8;
+    memcpy(buf + p, &meta->ino, 8); p += 8;
+    memcpy(buf + p, &meta->indexed_end, sizeof(off_t)); p += sizeof(off_t);
+    memcpy(buf + p, &meta->fingerprint, 8);
+
+    // rename es atomico: un lector ve el meta anterior o el nuevo, nunca uno a medias
+    char tmp_path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("open (meta)");
+        return -1;
+    }
+    if (safe_write_full(fd, buf, sizeof(buf)) != (ssize_t)sizeof(buf) || fsync(fd) != 0) {
+        perror("write (meta)");
+        close(fd);
+        unlink(tmp_path);
+        return -1;
+    }
+    close(fd);
+    if (rename(tmp_path, path) != 0) {
+        perror("rename (meta)");
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+int build_meta_save(const char *path, const char *csv_path, off_t indexed_end) {
+    build_meta_t meta;
+    if (build_meta_capture(csv_path, indexed_end, &meta) != 0) return -1;
+    return build_meta_write(path, &meta);
+}
+
+void build_meta_remove(const char *path) {
+    unlink(path);
+}
+
+int build_meta_matches(const char *csv_path, const build_meta_t *meta) {
+    build_meta_t now;
+    if (build_meta_capture(csv_path, meta->indexed_end, &now) != 0) return 0;
+    if (now.dev != meta->dev || now.ino != meta->ino || now.fingerprint != meta->fingerprint) return 0;
+    if (meta->indexed_end == 0) return 1;
+
+    /* Si el csv no terminaba en '\n', lo agregado continua el ultimo registro indexado
+     * (la fila ya indexada cambiaria) */
+    int fd = open(csv_path, O_RDONLY);
+    if (fd < 0) return 0;
+    char last;
+    ssize_t r = safe_pread(fd, &last, 1, meta->indexed_end - 1);
+    close(fd);
+    return r == 1 && last == '\n';
+}
@@ -0,0 +1,42 @@
+#ifndef BUILD_META_H
+#define BUILD_META_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#define BUILD_META_PATH "data/index/title_build.meta"
+#define BUILD_META_CHECK_LEN 4096 // Bytes del csv que entran en la huella (inicio y final indexado)
+
+/* Hasta donde esta indexado el csv (data/index/title_build.meta). Lo escribe cada --build
+ * completo y lo adelanta OP_ADD_BOOK; --build --incremental lo usa para indexar solo lo que se
+ * agrego al final del csv. La identidad del archivo es (dev, ino) mas una huella de los primeros
+ * y los ultimos BUILD_META_CHECK_LEN bytes indexados: si el csv se reemplazo o se edito antes
+ * de indexed_end, no coincide y hay que reconstruir todo. */
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+    off_t indexed_end;     // Los registros que empiezan antes de este offset estan en el indice
+    uint64_t fingerprint;
+} build_meta_t;
+
+/* Calcula el meta del csv indexado hasta indexed_end. Retorna 0, o -1 si falla */
+int build_meta_capture(const char *csv_path, off_t indexed_end, build_meta_t *meta);
+
+/* Lee el meta. Retorna 0, o -1 si no existe o no es valido */
+int build_meta_read(const char *path, build_meta_t *meta);
+
+/* Escribe el meta (archivo temporal + rename). Retorna 0, o -1 si falla */
+int build_meta_write(const char *path, const build_meta_t *meta);
+
+/* build_meta_capture + build_meta_write */
+int build_meta_save(const char *path, const char *csv_path, off_t indexed_end);
+
+/* Borra el meta: el indice ya no corresponde a ningun punto del csv (por ejemplo, durante
+ * una reconstruccion) */
+void build_meta_remove(const char *path);
+
+/* Retorna 1 si csv_path es el mismo archivo de meta, sin cambios hasta indexed_end y
+ * terminado en '\n' ahi (se puede seguir desde indexed_end); 0 si no */
+int build_meta_matches(const char *csv_path, const build_meta_t *meta);
+
+#endif // BUILD_META_H
@@ -4,6 +4,15 @@
 #include "linked_list.h"
 #include "common.h"
 #include "hash.h"
+#include "compact.h"
+#include "arena.h"
+#include "csv_scan.h"
+#include "build_meta.h"
+#include "grow.h"
+#include "slots.h"
+#include "static_index.h"
+#include "bloom.h"
+#include <pthread.h>
 #include "util.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -12,32 +21,77 @@
 #include <unistd.h>
 #include <time.h>
 
-// Extrae un campo de una linea formato csv, si no lo encuentra retorna NULL
-static char *csv_get_field_copy(const char *line, int field_idx) {
-    // Esta funcion tambien puede ser util en el cliente, si se necesita, mover a common
-    if (line == NULL || field_idx < 0) return NULL;
-    size_t pos = 0;
-    size_t field_len = 0;
-    int current_field = 0;
-    while (current_field != field_idx) { // Busca el inicio del campo
-        if (line[pos] == '\0') return NULL;
-        if (line[pos] == ',')  current_field++;
-        pos++;
+#define BUILD_WRITE_BUF_SIZE (4 << 20) // Los nodos se escriben al archivo en bloques de 4 MiB
+
+/* El csv sigue indexado hasta su final si lo estaba antes de la linea agregada en start_offset.
+ * Si habia filas agregadas por fuera sin indexar, el meta deja de servir: --incremental las
+ * indexaria junto con esta linea (que ya esta en el indice) */
+static void line_update_meta(const char *csv_path, off_t start_offset, off_t line_len) {
+    build_meta_t meta;
+    if (build_meta_read(BUILD_META_PATH, &meta) == 0) {
+        if (meta.indexed_end == start_offset) {
+            build_meta_save(BUILD_META_PATH, csv_path, start_offset + line_len);
+        } else {
+            build_meta_remove(BUILD_META_PATH);
+        }
     }
+}
 
-    const char *start = line + pos;
-    while (start[field_len] != ',' && start[field_len] != '\0') { // Busca hasta la siguiente coma (Obtiene la longitud del campo)
-        field_len++;
+/* Marca llaves nuevas en el filtro de Bloom antes de enlazarlas: un lector que encuentra la fila
+ * ya ve sus bits. Si no se puede, el filtro se borra (dejaria de cubrir el indice) */
+static void build_bloom_mark(uint64_t seed, const uint64_t *hashes, size_t n) {
+    if (bloom_add_file(BLOOM_PATH, seed, hashes, n) != 0) {
+        fprintf(stderr, "Aviso: se borra %s (las busquedas leeran el indice)\n", BLOOM_PATH);
+        bloom_remove(BLOOM_PATH);
     }
+}
 
-    char *output_field = malloc(field_len + 1); // Se reserva un espacio adicional para '\0'
-    if (output_field == NULL) { // Si ocurre error de malloc
-        perror("malloc");
-        return NULL;
+/* Agrega una fila a la lista enlazada de su bucket. Si el nodo mas reciente de la llave tiene
+ * lugar, la posting se escribe en el (sin nodo nuevo); si no, se enlaza al frente un nodo con el
+ * doble de lugares (hasta LINKED_LIST_MAX_CAP). Retorna 0, o -1 si falla */
+static int line_insert_chain(int bfd, int afd, const buckets_header_t *hdr, uint64_t h, const char *key, size_t key_len,
+                             off_t offset, uint32_t record_len) {
+    if (linked_list_posting_check(offset, record_len) != 0) return -1;
+    uint64_t bucket = buckets_bucket_of(hdr, h);
+    off_t head = buckets_read_head(bfd, bucket); // Cabeza de la lista enlazada
+    unsigned char *buf = malloc(LINKED_LIST_MAX_NODE_SIZE);
+    if (buf == NULL) return -1;
+    uint16_t cap = LINKED_LIST_INITIAL_CAP;
+    int status = -1;
+    for (off_t cur = head; cur != 0; ) {
+        linked_list_node_t node;
+        if (linked_list_read_node(afd, cur, &node, buf, NULL) != 0) {
+            fprintf(stderr, "Error, no se pudo leer el nodo en el offset %lld\n", (long long)cur);
+            goto done;
+        }
+        if (node.hash == h && node.key_len == key_len && memcmp(node.key, key, key_len) == 0) {
+            if (node.count < node.cap) {
+                buckets_generation_bump(); // Impar: los lectores repiten la busqueda
+                status = linked_list_append_posting(afd, cur, &node, offset, record_len);
+                buckets_generation_bump();
+                goto done;
+            }
+            cap = node.cap * 2 > LINKED_LIST_MAX_CAP ? LINKED_LIST_MAX_CAP : node.cap * 2;
+            break;
+        }
+        cur = node.next_ptr;
     }
-    memcpy(output_field, start, field_len);
-    output_field[field_len] = '\0';
-    return output_field;
+
+    unsigned char posting[LINKED_LIST_POSTING_SIZE];
+    linked_list_posting_encode(offset, record_len, posting);
+    linked_list_node_t node = {.hash = h, .next_ptr = head, .count = 1, .cap = cap, .key_len = (uint16_t)key_len,
+                               .key = (char *)key, .postings = posting};
+    off_t new_node_off = linked_list_append_node(afd, &node);
+    if (new_node_off == 0) goto done;
+    if (buckets_write_head(bfd, bucket, new_node_off) != 0) {
+        fprintf(stderr, "failed write bucket head\n");
+        goto done;
+    }
+    status = 0;
+
+done:
+    free(buf);
+    return status;
 }
 
 //Similiar a build_index_stream, pero solo para indexar una línea
@@ -58,6 +112,19 @@ int build_index_line(const char *csv_path, const char *line) {
         return -1;
     }
 
+    buckets_header_t hdr; // Numero de buckets y semilla del indice
+    if (buckets_read_header(bfd, &hdr) != 0) {
+        close(bfd);
+        close(afd);
+        return -1;
+    }
+    if (hdr.engine == BUCKETS_ENGINE_STATIC) { // Antes de tocar el csv
+        fprintf(stderr, "Error: el indice es estatico (--build --static) y no admite libros nuevos\n");
+        close(bfd);
+        close(afd);
+        return -1;
+    }
+
     FILE *csv_fp = fopen(csv_path, "a+"); // Abre el dataset
     if (!csv_fp) {
         close(bfd);
@@ -94,163 +161,841 @@ int build_index_line(const char *csv_path, const char *line) {
     fflush(csv_fp);
 
     //Indexar la linea
-    char *title = csv_get_field_copy(line, TITLE_FIELD); // Obtiene titulo de la linea
-        if (title == NULL){
+    // Mismo recorrido del registro que en la construccion completa (campos entre comillas)
+    csv_field_t title;
+    int found;
+    csv_scan_record(line, strlen(line), 0, TITLE_FIELD, &title, &found); // Obtiene titulo de la linea
+        if (!found){
             return -1;
         }
 
-        char *normalized_title = normalize_string(title); // Obtiene el titulo normalizado
-        free(title);
+        char *normalized_title = csv_field_normalized(&title); // Obtiene el titulo normalizado
         if (normalized_title == NULL) {
             return -1;
         }
 
         // Hash 
-        uint64_t h = hash_key_prefix(normalized_title, strlen(normalized_title), DEFAULT_HASH_SEED);
-        uint64_t mask = NUM_BUCKETS - 1;
-        uint64_t bucket = bucket_id_from_hash(h, mask);
-
-        // Obtiene la cabeza de la lista enlazada
-        off_t old_head = buckets_read_head(bfd, bucket);
-
-        // Inserta los datos del nodo en el archivo
-        linked_list_node_t node;
-        node.key_len = (uint16_t)strlen(normalized_title);
-        node.key = strdup(normalized_title);
-        node.entry_offset = start_offset;
-        node.next_ptr = old_head;      
-
-        off_t new_node_off = linked_list_append_node(afd, &node);
+        uint64_t h = buckets_hash_key(&hdr, normalized_title, strlen(normalized_title));
+        build_bloom_mark(hdr.seed, &h, 1);
+        if (hdr.engine == BUCKETS_ENGINE_SLOTS) { // Open addressing: solo se inserta el slot (ver slots.h)
+            free(normalized_title);
+            if (slots_insert_file(bfd, buckets_path, &hdr, h, start_offset, (uint32_t)strlen(line) + 1) != 0) {
+                fprintf(stderr, "Error al insertar el slot\n");
+                fclose(csv_fp);
+                close(bfd);
+                close(afd);
+                return -1;
+            }
+            goto update_meta;
+        }
+        int inserted = line_insert_chain(bfd, afd, &hdr, h, normalized_title, strlen(normalized_title), start_offset,
+                                         (uint32_t)strlen(line) + 1); // La linea se escribio con '\n'
         free(normalized_title);
-
-        if (new_node_off == 0) {
+        if (inserted != 0) {
             fprintf(stderr, "Error al insertar nodo\n");
-            linked_list_free_node(&node);
+            fclose(csv_fp);
+            close(bfd);
+            close(afd);
             return -1;
         }
-        
-        linked_list_free_node(&node);
-        
-        if (buckets_write_head(bfd, bucket, new_node_off) != 0) {
-            fprintf(stderr, "failed write bucket head\n");
+
+        // Una fila mas: si el load factor paso del maximo se divide un bucket (hashing lineal)
+        hdr.entry_count++;
+        if (index_grow(bfd, afd, &hdr) != 0) {
+            fprintf(stderr, "Error al actualizar el encabezado del indice\n");
         }
 
+update_meta:
+        line_update_meta(csv_path, start_offset, (off_t)strlen(line) + 1);
+
         fclose(csv_fp);
         close(bfd);
         close(afd);
         return 0;
 }
 
-/* Construye los archivos de indices */
-int build_index_stream(const char *csv_path) {
+// Segundos transcurridos desde start (reloj monotonic)
+static double elapsed_seconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Construye los archivos de indices.
+ * Las cabezas de los buckets viven en memoria durante toda la carga y los nodos se agregan
+ * con un escritor con buffer: por fila no hay ninguna syscall sobre el indice. La tabla de
+ * buckets se escribe una sola vez al final. */
+int build_index_stream(const char *csv_path, uint32_t hash) {
     char buckets_path[1024] = "data/index/title_buckets.dat";
     char linked_list_path[1024] = "data/index/title_linked_list.dat";
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (index_dir_create() != 0) return -1;
+    build_meta_remove(BUILD_META_PATH); // Hasta terminar, el indice no corresponde al csv
+    bloom_remove(BLOOM_PATH);            // --compact escribe el filtro nuevo
+
+    csv_map_t csv; // Dataset mapeado en memoria
+    if (csv_map_open(csv_path, &csv) != 0) {
+        fprintf(stderr,"open csv failed\n");
+        return -1;
+    }
+    // Numero de buckets segun el load factor objetivo: primero se cuentan los registros (sin procesarlos)
+    size_t data_start = csv.size > 0 ? csv_scan_record(csv.data, csv.size, 0, 0, NULL, NULL) : 0; // Descarta la primera linea
+    buckets_header_t hdr;
+    buckets_header_init(&hdr, csv_count_records(csv.data, csv.size, data_start));
+    hdr.hash = hash;
 
     // Verificar si se puede eliminar buckets_create y simplemente implementar aqui
-    if (buckets_create(buckets_path) != 0) {
+    if (buckets_create(buckets_path, &hdr) != 0) {
         fprintf(stderr, "Failed to create buckets file %s\n", buckets_path);
+        csv_map_close(&csv);
         return -1;
     }
 
     // Verificar si se puede eliminar linked_list_nodes_create y simplemente implementar aqui
-    if (linked_list_nodes_create(linked_list_path) != 0) {
+    if (linked_list_nodes_create(linked_list_path, hdr.nodes_gen) != 0) {
         fprintf(stderr, "Failed to create linked_list file %s\n", linked_list_path);
+        csv_map_close(&csv);
         return -1;
     }
 
     int bfd = buckets_open_readwrite(buckets_path); // buckets file descriptor
     if (bfd < 0) {
         fprintf(stderr,"open buckets failed\n");
+        csv_map_close(&csv);
         return -1;
     } 
     int afd = linked_list_open(linked_list_path); // nodes file descriptor
     if (afd < 0) { 
         close(bfd);
         fprintf(stderr,"open linked_list failed\n");
+        csv_map_close(&csv);
         return -1;
     }
 
-    FILE *csv_fp = fopen(csv_path, "rb"); // Abre el dataset
-    if (!csv_fp) {
+    off_t *heads = calloc(hdr.num_buckets, sizeof(off_t)); // Cabezas de los buckets (0 = vacio)
+    linked_list_writer_t writer;
+    if (heads == NULL || linked_list_writer_init(&writer, afd, LINKED_LIST_FILE_HEADER_SIZE, BUILD_WRITE_BUF_SIZE) != 0) {
+        perror("malloc");
+        free(heads);
+        csv_map_close(&csv);
         close(bfd);
         close(afd);
-        fprintf(stderr,"open csv failed\n");
         return -1;
     }
 
-    char *line = NULL;
-    size_t line_size = 0; // Tamaño del buffer line
-    ssize_t read_bytes; // Cantidad de bytes leidos
+    int status = 0;
+    size_t rows = 0; // Filas indexadas
+    off_t indexed_end = (off_t)csv.size;
 
-    read_bytes = getline(&line, &line_size, csv_fp); // Descarta la primera linea
-    if (read_bytes == -1) {
-        if (feof(csv_fp)) { // No hay contenido en el archivo
-            fprintf(stderr, "Error: El archivo csv esta vacio\n");
-            free(line);
-            fclose(csv_fp);
-            return 0; 
-        } else { 
-            fprintf(stderr, "Error al leer el csv\n");
-            free(line);
-            fclose(csv_fp);
-            return -1;
+    if (csv.size == 0) { // No hay contenido en el archivo: el indice queda vacio
+        fprintf(stderr, "Aviso: El archivo csv esta vacio, el indice queda vacio\n");
+        goto done;
+    }
+    size_t pos = data_start;
+
+    // Itera sobre los registros del csv
+    while (pos < csv.size) {
+        csv_field_t title; // Vista del titulo dentro del registro (sin copiarlo)
+        int found;
+        size_t next = csv_scan_record(csv.data, csv.size, pos, TITLE_FIELD, &title, &found);
+        off_t line_offset = (off_t)pos;
+        size_t record_len = next - pos;
+        pos = next;
+        if (!found) continue;
+
+        char *normalized_title = csv_field_normalized(&title); // Obtiene el titulo normalizado (Solo alfanumericos)
+        if (normalized_title == NULL) continue;
+
+        // Hash 
+        size_t key_len = strlen(normalized_title);
+        uint64_t h = buckets_hash_key(&hdr, normalized_title, key_len); // Ya esta normalizado
+        uint64_t bucket = buckets_bucket_of(&hdr, h);
+
+        // Inserta el nodo al frente de la lista del bucket (la cabeza se actualiza en memoria)
+        // (un nodo por fila; --compact los agrupa por llave)
+        unsigned char posting[LINKED_LIST_POSTING_SIZE];
+        off_t new_node_off = 0;
+        if (linked_list_posting_check(line_offset, (uint32_t)record_len) == 0) {
+            linked_list_posting_encode(line_offset, (uint32_t)record_len, posting); // Incluye '\n' si lo tiene
+            linked_list_node_t node;
+            node.hash = h; // Huella: el lector descarta nodos sin comparar la key
+            node.key_len = (uint16_t)key_len;
+            node.key = normalized_title;
+            node.count = 1;
+            node.cap = 1;
+            node.postings = posting;
+            node.next_ptr = heads[bucket];
+            new_node_off = linked_list_writer_append(&writer, &node);
         }
+        free(normalized_title);
+
+        if (new_node_off == 0) {
+            fprintf(stderr, "Error al insertar nodo\n");
+            status = -1;
+            break;
+        }
+        heads[bucket] = new_node_off;
+        rows++;
     }
 
-    // Itera sobre las lineas del csv
-    while (1) {
-        off_t start_offset = ftello(csv_fp); // posición en bytes del comienzo de la linea
-        if (start_offset == (off_t) -1) {
-            perror("ftello");
+done:
+    // Nodos pendientes del buffer, la tabla de buckets completa (una sola vez) y el encabezado
+    hdr.entry_count = rows;
+    if (linked_list_writer_flush(&writer) != 0 || buckets_write_heads(bfd, heads, hdr.num_buckets) != 0 ||
+        buckets_write_header(bfd, &hdr) != 0) {
+        fprintf(stderr, "Error al escribir los archivos del indice\n");
+        status = -1;
+    }
+    linked_list_writer_free(&writer);
+    free(heads);
+    csv_map_close(&csv);
+    close(bfd);
+    close(afd);
+    if (status != 0) return -1;
+
+    double secs = elapsed_seconds(&start);
+    printf("Indice construido: %zu filas en %.2f s (%.0f filas/s, %llu buckets)\n", rows, secs,
+           secs > 0 ? (double)rows / secs : 0.0, (unsigned long long)hdr.num_buckets);
+
+    // Carga masiva: los nodos de cada bucket quedan seguidos en un extent
+    if (index_compact(buckets_path, linked_list_path) != 0) {
+        fprintf(stderr, "Error al compactar el indice\n");
+        return -1;
+    }
+    printf("Indice compactado en %.2f s\n", elapsed_seconds(&start) - secs);
+    if (build_meta_save(BUILD_META_PATH, csv_path, indexed_end) != 0) {
+        fprintf(stderr, "Aviso: no se pudo guardar %s (--incremental hara una reconstruccion completa)\n", BUILD_META_PATH);
+    }
+    return 0;
+}
+
+/* ---- Construccion en paralelo (--build --threads N) ----
+ * El csv (mapeado) se divide en N rangos de bytes que empiezan al inicio de un registro.
+ * Los limites se buscan recorriendo los registros (un '\n' dentro de un campo entre comillas
+ * no es un limite), lo que es mucho mas rapido que procesarlos. Cada hilo recorre su rango,
+ * normaliza y calcula el hash de cada titulo y guarda las entradas en su particion (en orden
+ * del csv). El numero de buckets sale de la suma de los registros de las particiones (el mismo
+ * conteo que hace build_index_stream). Luego se ordenan las entradas por bucket con un counting
+ * sort y se escribe directamente el indice compactado: los archivos quedan identicos a los
+ * de build_index_stream (que enlaza en orden del csv y luego compacta). */
+
+#define BUILD_KEY_ARENA_BLOCK (1 << 20) // Bloques del arena de llaves de cada particion
+
+// Una fila del csv ya procesada
+typedef struct {
+    uint64_t hash;
+    off_t offset;        // Offset del registro en el csv
+    uint32_t record_len; // Bytes del registro (incluye '\n' si lo tiene)
+    uint16_t key_len;
+    const char *key;     // Llave normalizada (en el arena de la particion)
+} build_entry_t;
+
+// Rango del csv que procesa un hilo y sus resultados
+typedef struct {
+    const csv_map_t *csv;
+    size_t start;        // Inicio del primer registro del rango
+    size_t end;          // Inicio del primer registro del rango siguiente
+    uint64_t seed;       // Semilla del hash
+    uint32_t hash;       // Funcion de hash (HASH_*)
+    size_t records;      // Registros del rango (con o sin titulo)
+    build_entry_t *entries;
+    size_t count;
+    size_t cap;
+    arena_t keys;
+    int status;
+} build_part_t;
+
+static int part_push(build_part_t *part, const build_entry_t *e) {
+    if (part->count == part->cap) {
+        size_t new_cap = part->cap ? part->cap * 2 : 4096;
+        build_entry_t *tmp = realloc(part->entries, new_cap * sizeof(build_entry_t));
+        if (tmp == NULL) return -1;
+        part->entries = tmp;
+        part->cap = new_cap;
+    }
+    part->entries[part->count++] = *e;
+    return 0;
+}
+
+// Hilo de la construccion en paralelo: procesa los registros de su rango
+static void *build_part_main(void *arg) {
+    build_part_t *part = arg;
+    const csv_map_t *csv = part->csv;
+    int status = 0;
+    size_t pos = part->start;
+    while (pos < part->end) {
+        // Mismo procesamiento que build_index_stream
+        csv_field_t title;
+        int found;
+        size_t next = csv_scan_record(csv->data, csv->size, pos, TITLE_FIELD, &title, &found);
+        build_entry_t e;
+        e.offset = (off_t)pos;
+        e.record_len = (uint32_t)(next - pos);
+        pos = next;
+        part->records++;
+        if (!found) continue;
+        char *normalized_title = csv_field_normalized(&title);
+        if (normalized_title == NULL) continue;
+
+        size_t key_len = strlen(normalized_title);
+        e.hash = hash_key_with(part->hash, normalized_title, key_len, part->seed);
+        e.key_len = (uint16_t)key_len;
+        char *key = arena_alloc(&part->keys, e.key_len > 0 ? e.key_len : 1);
+        if (key != NULL) memcpy(key, normalized_title, e.key_len);
+        free(normalized_title);
+        e.key = key;
+        if (key == NULL || part_push(part, &e) != 0) {
+            fprintf(stderr, "Error: sin memoria para la particion del csv\n");
+            status = -1;
             break;
         }
+    }
+    part->status = status;
+    return NULL;
+}
+
+/* Escribe el indice compactado a partir de las particiones (en orden del csv).
+ * Cada bucket queda como un extent con un nodo por llave (linked_list_writer_append_rows), los
+ * mismos bytes que una lista enlazada construida en orden del csv y luego compactada. */
+static int build_write_partitions(const build_part_t *parts, int nparts, int bfd, int afd, const buckets_header_t *hdr) {
+    uint64_t nb = hdr->num_buckets; // Con split = 0, el bucket es hash & (nb - 1)
+    uint32_t *counts = calloc(nb, sizeof(uint32_t));
+    size_t *first = malloc(sizeof(size_t) * nb);
+    size_t total = 0;
+    for (int p = 0; p < nparts; p++) total += parts[p].count;
+    const build_entry_t **order = malloc(sizeof(build_entry_t *) * (total ? total : 1));
+    unsigned char *table = calloc(nb, BUCKET_ENTRY_SIZE);
+    linked_list_writer_t writer = {.fd = -1, .buf = NULL, .len = 0, .cap = 0, .tail = 0};
+    linked_list_row_t *rows = NULL; // Filas del bucket en curso
+    int status = -1;
+    if (counts != NULL) {
+        uint32_t max_count = 0;
+        for (int p = 0; p < nparts; p++) {
+            for (size_t i = 0; i < parts[p].count; i++) {
+                uint32_t c = ++counts[buckets_bucket_of(hdr, parts[p].entries[i].hash)];
+                if (c > max_count) max_count = c;
+            }
+        }
+        rows = malloc(sizeof(linked_list_row_t) * (max_count ? max_count : 1));
+    }
+    if (counts == NULL || first == NULL || order == NULL || table == NULL || rows == NULL ||
+        linked_list_writer_init(&writer, afd, LINKED_LIST_FILE_HEADER_SIZE, BUILD_WRITE_BUF_SIZE) != 0) {
+        perror("malloc");
+        goto cleanup;
+    }
 
-        read_bytes = getline(&line, &line_size, csv_fp);
-        if (read_bytes == -1) { 
-            if (feof(csv_fp)) break; // Fin del archivo
-            perror("getline"); // Si error
+    // Counting sort por bucket (counts ya tiene las entradas de cada bucket)
+    size_t pos = 0;
+    for (uint64_t b = 0; b < nb; b++) {
+        pos += counts[b];
+        first[b] = pos; // Fin del rango del bucket (se decrementa al colocar cada entrada)
+    }
+    for (int p = 0; p < nparts; p++) {
+        for (size_t i = 0; i < parts[p].count; i++) {
+            const build_entry_t *e = &parts[p].entries[i];
+            order[--first[buckets_bucket_of(hdr, e->hash)]] = e;
+        }
+    }
+
+    // Un extent por bucket, en orden de bucket (igual que index_compact)
+    for (uint64_t b = 0; b < nb; b++) {
+        if (counts[b] == 0) continue;
+        bucket_entry_t entry = {.head = 0, .extent_off = writer.tail, .extent_len = 0, .extent_count = 0};
+        for (size_t j = 0; j < counts[b]; j++) {
+            const build_entry_t *e = order[first[b] + j];
+            rows[j] = (linked_list_row_t){.hash = e->hash, .offset = e->offset, .record_len = e->record_len,
+                                          .key_len = e->key_len, .key = e->key};
+        }
+        int64_t nodes = linked_list_writer_append_rows(&writer, rows, counts[b]); // Un nodo por llave
+        if (nodes < 0) goto cleanup;
+        entry.extent_count = (uint32_t)nodes;
+        if ((uint64_t)(writer.tail - entry.extent_off) > UINT32_MAX) {
+            fprintf(stderr, "Error: el bucket %llu es demasiado grande para un extent\n", (unsigned long long)b);
+            goto cleanup;
+        }
+        entry.extent_len = (uint32_t)(writer.tail - entry.extent_off);
+        buckets_encode_entry(&entry, table + b * BUCKET_ENTRY_SIZE);
+    }
+    size_t table_size = (size_t)nb * BUCKET_ENTRY_SIZE;
+    if (linked_list_writer_flush(&writer) != 0 ||
+        safe_pwrite(bfd, table, table_size, BUCKETS_HEADER_SIZE) != (ssize_t)table_size ||
+        buckets_write_header(bfd, hdr) != 0) {
+        fprintf(stderr, "Error al escribir los archivos del indice\n");
+        goto cleanup;
+    }
+    status = 0;
+
+cleanup:
+    linked_list_writer_free(&writer);
+    free(counts);
+    free(first);
+    free(order);
+    free(table);
+    free(rows);
+    return status;
+}
+
+static void build_parts_free(build_part_t *parts, int nparts) {
+    for (int k = 0; k < nparts; k++) {
+        free(parts[k].entries);
+        arena_free(&parts[k].keys);
+    }
+    free(parts);
+}
+
+/* Escribe el filtro de Bloom con los hashes de las particiones (rows filas). Sin filtro las
+ * busquedas siguen siendo correctas: si falla solo se avisa */
+static void build_save_bloom(const build_part_t *parts, int nparts, uint64_t rows, uint64_t seed) {
+    bloom_t bloom;
+    if (bloom_init(&bloom, rows, seed) != 0) return;
+    for (int p = 0; p < nparts; p++) {
+        for (size_t i = 0; i < parts[p].count; i++) bloom_add(&bloom, parts[p].entries[i].hash);
+    }
+    if (bloom_write(&bloom, BLOOM_PATH) != 0) fprintf(stderr, "Aviso: no se pudo escribir %s\n", BLOOM_PATH);
+    bloom_free(&bloom);
+}
+
+/* Divide los registros del csv (desde data_start) en num_threads rangos de tamaño parecido,
+ * cada uno empezando al inicio de un registro, y los procesa en paralelo.
+ * Retorna las particiones (liberar con build_parts_free), o NULL si falla */
+static build_part_t *build_parse_parts(const csv_map_t *csv, size_t data_start, int num_threads, uint64_t seed,
+                                       uint32_t hash) {
+    build_part_t *parts = calloc((size_t)num_threads, sizeof(build_part_t));
+    pthread_t *threads = calloc((size_t)num_threads, sizeof(pthread_t));
+    if (parts == NULL || threads == NULL) {
+        perror("calloc");
+        free(parts);
+        free(threads);
+        return NULL;
+    }
+    size_t prev = data_start;
+    for (int k = 0; k < num_threads; k++) {
+        parts[k].csv = csv;
+        parts[k].seed = seed;
+        parts[k].hash = hash;
+        parts[k].start = prev;
+        size_t split = data_start + (csv->size - data_start) / (size_t)num_threads * (size_t)(k + 1);
+        size_t end = (k == num_threads - 1) ? csv->size : csv_record_start_after(csv->data, csv->size, prev, split);
+        parts[k].end = end;
+        prev = end;
+        arena_init(&parts[k].keys, BUILD_KEY_ARENA_BLOCK);
+    }
+
+    int status = 0;
+    int launched = 0;
+    for (; launched < num_threads; launched++) {
+        if (pthread_create(&threads[launched], NULL, build_part_main, &parts[launched]) != 0) {
+            fprintf(stderr, "Error: no se pudo crear el hilo %d\n", launched);
+            status = -1;
             break;
         }
-        char *title = csv_get_field_copy(line, TITLE_FIELD); // Obtiene titulo de la linea
-        if (title == NULL) continue; 
+    }
+    for (int k = 0; k < launched; k++) {
+        pthread_join(threads[k], NULL);
+        if (parts[k].status != 0) status = -1;
+    }
+    free(threads);
+    if (status != 0) {
+        build_parts_free(parts, num_threads);
+        return NULL;
+    }
+    return parts;
+}
 
-        char *normalized_title = normalize_string(title); // Obtiene el titulo normalizado (Solo alfanumericos)
-        free(title);
-        if (normalized_title == NULL) continue;
+int build_index_parallel(const char *csv_path, int num_threads, uint32_t hash) {
+    char buckets_path[1024] = "data/index/title_buckets.dat";
+    char linked_list_path[1024] = "data/index/title_linked_list.dat";
+    if (num_threads <= 0) num_threads = 1;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (index_dir_create() != 0) return -1;
+    build_meta_remove(BUILD_META_PATH);
+    bloom_remove(BLOOM_PATH);
+
+    csv_map_t csv;
+    if (csv_map_open(csv_path, &csv) != 0) {
+        fprintf(stderr,"open csv failed\n");
+        return -1;
+    }
+    if (csv.size == 0) fprintf(stderr, "Aviso: El archivo csv esta vacio, el indice queda vacio\n");
+    size_t data_start = csv.size > 0 ? csv_scan_record(csv.data, csv.size, 0, 0, NULL, NULL) : 0; // Descarta el encabezado
 
-        // Hash 
-        uint64_t h = hash_key_prefix(normalized_title, strlen(normalized_title), DEFAULT_HASH_SEED);
-        uint64_t mask = NUM_BUCKETS - 1;
-        uint64_t bucket = bucket_id_from_hash(h, mask);
+    build_part_t *parts = build_parse_parts(&csv, data_start, num_threads, DEFAULT_HASH_SEED, hash);
+    if (parts == NULL) {
+        csv_map_close(&csv);
+        return -1;
+    }
+    int status = 0;
+    size_t rows = 0;
+    size_t records = 0;
+    for (int k = 0; k < num_threads; k++) {
+        rows += parts[k].count;
+        records += parts[k].records;
+    }
+    buckets_header_t hdr;
+    buckets_header_init(&hdr, records);
+    hdr.hash = hash;
+    hdr.entry_count = rows;
+    hdr.nodes_gen = 1; // Los nodos quedan ya compactados, como los deja build_index_stream
+    double parse_secs = elapsed_seconds(&start);
+
+    if (buckets_create(buckets_path, &hdr) != 0 || linked_list_nodes_create(linked_list_path, hdr.nodes_gen) != 0) {
+        fprintf(stderr, "Failed to create index files\n");
+        status = -1;
+    }
+    if (status == 0) {
+        int bfd = buckets_open_readwrite(buckets_path);
+        int afd = linked_list_open(linked_list_path);
+        if (bfd < 0 || afd < 0 || build_write_partitions(parts, num_threads, bfd, afd, &hdr) != 0) {
+            fprintf(stderr, "Error al escribir el indice\n");
+            status = -1;
+        }
+        if (bfd >= 0) close(bfd);
+        if (afd >= 0) close(afd);
+    }
+    if (status == 0) build_save_bloom(parts, num_threads, rows, hdr.seed);
+
+    build_parts_free(parts, num_threads);
+    off_t indexed_end = (off_t)csv.size;
+    csv_map_close(&csv);
+    if (status != 0) return -1;
+    if (build_meta_save(BUILD_META_PATH, csv_path, indexed_end) != 0) {
+        fprintf(stderr, "Aviso: no se pudo guardar %s (--incremental hara una reconstruccion completa)\n", BUILD_META_PATH);
+    }
 
-        // Obtiene la cabeza de la lista enlazada
-        off_t old_head = buckets_read_head(bfd, bucket);
+    double secs = elapsed_seconds(&start);
+    printf("Indice construido con %d hilos: %zu filas en %.2f s (lectura %.2f s, %.0f filas/s)\n",
+           num_threads, rows, secs, parse_secs, secs > 0 ? (double)rows / secs : 0.0);
+    return 0;
+}
 
-        // Inserta los datos del nodo en el archivo
-        linked_list_node_t node;
-        node.key_len = (uint16_t)strlen(normalized_title);
-        node.key = strdup(normalized_title);
-        node.entry_offset = start_offset;
-        node.next_ptr = old_head;      
-        off_t new_node_off = linked_list_append_node(afd, &node);
-        free(normalized_title);
+/* ---- Motor slots (--build --engine slots) ----
+ * Las particiones se procesan igual que en la construccion en paralelo y las entradas se
+ * insertan en orden del csv en una tabla de slots en memoria (ver slots.h), que se escribe de
+ * una vez en title_buckets.dat. title_linked_list.dat queda vacio (solo el encabezado). */
+
+// Inserta las entradas de las particiones (en orden del csv) en la tabla
+static int slots_insert_parts(slots_table_t *t, const build_part_t *parts, int nparts) {
+    for (int p = 0; p < nparts; p++) {
+        for (size_t i = 0; i < parts[p].count; i++) {
+            const build_entry_t *e = &parts[p].entries[i];
+            if (slots_table_insert(t, e->hash, e->offset, e->record_len) != 0) return -1;
+        }
+    }
+    return 0;
+}
 
-        if (new_node_off == 0) {
-            fprintf(stderr, "Error al insertar nodo\n");
-            linked_list_free_node(&node);
-            continue;
+int build_index_slots(const char *csv_path, int num_threads, uint32_t hash) {
+    char buckets_path[1024] = "data/index/title_buckets.dat";
+    char linked_list_path[1024] = "data/index/title_linked_list.dat";
+    if (num_threads <= 0) num_threads = 1;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (index_dir_create() != 0) return -1;
+    build_meta_remove(BUILD_META_PATH);
+    bloom_remove(BLOOM_PATH);
+
+    csv_map_t csv;
+    if (csv_map_open(csv_path, &csv) != 0) {
+        fprintf(stderr,"open csv failed\n");
+        return -1;
+    }
+    if (csv.size == 0) fprintf(stderr, "Aviso: El archivo csv esta vacio, el indice queda vacio\n");
+    size_t data_start = csv.size > 0 ? csv_scan_record(csv.data, csv.size, 0, 0, NULL, NULL) : 0; // Descarta el encabezado
+
+    build_part_t *parts = build_parse_parts(&csv, data_start, num_threads, DEFAULT_HASH_SEED, hash);
+    if (parts == NULL) {
+        csv_map_close(&csv);
+        return -1;
+    }
+    size_t records = 0;
+    for (int k = 0; k < num_threads; k++) records += parts[k].records;
+
+    slots_table_t table = {.slots = NULL};
+    int status = slots_table_init(&table, records, DEFAULT_HASH_SEED, hash);
+    if (status == 0) status = slots_insert_parts(&table, parts, num_threads);
+    if (status == 0 && (slots_table_write(&table, buckets_path) != 0 || linked_list_nodes_create(linked_list_path, table.hdr.nodes_gen) != 0)) {
+        fprintf(stderr, "Error al escribir el indice\n");
+        status = -1;
+    }
+    size_t rows = (size_t)table.hdr.entry_count;
+    uint64_t nslots = table.hdr.num_buckets;
+    slots_table_free(&table);
+    if (status == 0) build_save_bloom(parts, num_threads, rows, DEFAULT_HASH_SEED);
+    build_parts_free(parts, num_threads);
+    off_t indexed_end = (off_t)csv.size;
+    csv_map_close(&csv);
+    if (status != 0) return -1;
+    if (build_meta_save(BUILD_META_PATH, csv_path, indexed_end) != 0) {
+        fprintf(stderr, "Aviso: no se pudo guardar %s (--incremental hara una reconstruccion completa)\n", BUILD_META_PATH);
+    }
+
+    double secs = elapsed_seconds(&start);
+    printf("Indice (slots) construido con %d hilos: %zu filas en %.2f s (%.0f filas/s, %llu slots)\n", num_threads,
+           rows, secs, secs > 0 ? (double)rows / secs : 0.0, (unsigned long long)nslots);
+    return 0;
+}
+
+/* ---- Motor static (--build --static) ----
+ * Las particiones se procesan igual que en la construccion en paralelo y todas las filas se
+ * pasan a static_index_write (ver static_index.h). No se guarda title_build.meta: el indice no
+ * admite filas nuevas, asi que --incremental siempre hace una construccion completa. */
+
+int build_index_static(const char *csv_path, int num_threads, uint32_t hash) {
+    char buckets_path[1024] = "data/index/title_buckets.dat";
+    char linked_list_path[1024] = "data/index/title_linked_list.dat";
+    if (num_threads <= 0) num_threads = 1;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (index_dir_create() != 0) return -1;
+    build_meta_remove(BUILD_META_PATH);
+    bloom_remove(BLOOM_PATH);
+
+    csv_map_t csv;
+    if (csv_map_open(csv_path, &csv) != 0) {
+        fprintf(stderr,"open csv failed\n");
+        return -1;
+    }
+    if (csv.size == 0) fprintf(stderr, "Aviso: El archivo csv esta vacio, el indice queda vacio\n");
+    size_t data_start = csv.size > 0 ? csv_scan_record(csv.data, csv.size, 0, 0, NULL, NULL) : 0; // Descarta el encabezado
+
+    build_part_t *parts = build_parse_parts(&csv, data_start, num_threads, DEFAULT_HASH_SEED, hash);
+    if (parts == NULL) {
+        csv_map_close(&csv);
+        return -1;
+    }
+    size_t rows = 0;
+    for (int k = 0; k < num_threads; k++) rows += parts[k].count;
+    slot_t *table_rows = malloc(sizeof(slot_t) * (rows ? rows : 1)); // Las llaves ya no hacen falta
+    int status = 0;
+    if (table_rows == NULL) {
+        perror("malloc");
+        status = -1;
+    } else {
+        size_t n = 0;
+        for (int k = 0; k < num_threads; k++) {
+            for (size_t i = 0; i < parts[k].count; i++) {
+                const build_entry_t *e = &parts[k].entries[i];
+                table_rows[n].hash = e->hash;
+                table_rows[n].offset = e->offset;
+                table_rows[n].record_len = e->record_len;
+                n++;
+            }
+        }
+        build_save_bloom(parts, num_threads, rows, DEFAULT_HASH_SEED); // Las particiones se liberan antes de escribir el indice
+    }
+    build_parts_free(parts, num_threads);
+    csv_map_close(&csv);
+    if (status == 0 && (static_index_write(buckets_path, DEFAULT_HASH_SEED, hash, table_rows, rows) != 0 ||
+                        linked_list_nodes_create(linked_list_path, 0) != 0)) { // Sin nodos: la tabla tiene nodes_gen 0
+        fprintf(stderr, "Error al escribir el indice\n");
+        bloom_remove(BLOOM_PATH); // El filtro es del csv nuevo, no del indice que quedo
+        status = -1;
+    }
+    free(table_rows);
+    if (status != 0) return -1;
+
+    double secs = elapsed_seconds(&start);
+    printf("Indice estatico construido con %d hilos: %zu filas en %.2f s (%.0f filas/s)\n", num_threads, rows, secs,
+           secs > 0 ? (double)rows / secs : 0.0);
+    return 0;
+}
+
+/* ---- Construccion incremental (--build --incremental) ----
+ * Indexa solo los registros agregados al final del csv desde la ultima construccion (segun
+ * title_build.meta). Se procesan como una particion de la construccion en paralelo, se ordenan
+ * por bucket y cada bucket recibe al frente de su lista enlazada un nodo por llave nueva (con
+ * todas sus filas nuevas; el extent no cambia). Los nodos se escriben antes que las
+ * cabezas y el meta al final: si se interrumpe, el indice sigue valido y se puede repetir.
+ * Si con las filas nuevas el load factor pasa del maximo, se dividen buckets (index_grow).
+ * Con el motor slots la tabla se carga completa, recibe las filas nuevas y se reescribe. */
+
+// Orden por bucket (segun el encabezado hdr), llave y, dentro de la llave, por offset en el csv
+static int entry_bucket_cmp(const void *a, const void *b, void *hdr) {
+    const build_entry_t *x = a;
+    const build_entry_t *y = b;
+    uint64_t bx = buckets_bucket_of(hdr, x->hash);
+    uint64_t by = buckets_bucket_of(hdr, y->hash);
+    if (bx != by) return bx < by ? -1 : 1;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    if (x->key_len != y->key_len) return x->key_len < y->key_len ? -1 : 1;
+    int c = memcmp(x->key, y->key, x->key_len);
+    if (c != 0) return c;
+    return (x->offset > y->offset) - (x->offset < y->offset);
+}
+
+static int same_key(const build_entry_t *x, const build_entry_t *y) {
+    return x->hash == y->hash && x->key_len == y->key_len && memcmp(x->key, y->key, x->key_len) == 0;
+}
+
+// --incremental con el motor slots: las filas nuevas se insertan en la tabla completa y se reescribe
+static int incremental_slots(int bfd, const char *buckets_path, buckets_header_t *hdr, const build_part_t *part) {
+    slots_table_t table;
+    if (slots_table_load(&table, bfd) != 0) return -1;
+    int status = slots_insert_parts(&table, part, 1);
+    if (status == 0 && slots_table_write(&table, buckets_path) != 0) {
+        fprintf(stderr, "Error al escribir la tabla de slots\n");
+        status = -1;
+    }
+    if (status == 0) *hdr = table.hdr;
+    slots_table_free(&table);
+    return status;
+}
+
+int build_index_incremental(const char *csv_path) {
+    char buckets_path[1024] = "data/index/title_buckets.dat";
+    char linked_list_path[1024] = "data/index/title_linked_list.dat";
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    build_meta_t meta;
+    if (build_meta_read(BUILD_META_PATH, &meta) != 0) {
+        printf("No hay %s: se reconstruye el indice completo\n", BUILD_META_PATH);
+        return BUILD_INCREMENTAL_FULL;
+    }
+    if (!build_meta_matches(csv_path, &meta)) {
+        printf("El csv no es una continuacion de lo indexado: se reconstruye el indice completo\n");
+        return BUILD_INCREMENTAL_FULL;
+    }
+
+    int bfd = buckets_open_readwrite(buckets_path);
+    int afd = linked_list_open(linked_list_path);
+    if (bfd < 0 || afd < 0) {
+        if (bfd >= 0) close(bfd);
+        if (afd >= 0) close(afd);
+        printf("No se pudieron abrir los archivos del indice: se reconstruye el indice completo\n");
+        return BUILD_INCREMENTAL_FULL;
+    }
+    buckets_header_t hdr;
+    if (buckets_read_header(bfd, &hdr) != 0 || hdr.engine == BUCKETS_ENGINE_STATIC ||
+        linked_list_check_gen(afd, hdr.nodes_gen) != 0) {
+        close(bfd);
+        close(afd);
+        printf("Se reconstruye el indice completo\n");
+        return BUILD_INCREMENTAL_FULL;
+    }
+    csv_map_t csv;
+    if (csv_map_open(csv_path, &csv) != 0) {
+        close(bfd);
+        close(afd);
+        fprintf(stderr,"open csv failed\n");
+        return -1;
+    }
+    if ((off_t)csv.size == meta.indexed_end) {
+        printf("El indice ya esta al dia (%lld bytes del csv)\n", (long long)meta.indexed_end);
+        csv_map_close(&csv);
+        close(bfd);
+        close(afd);
+        return 0;
+    }
+
+    build_part_t part = {.csv = &csv, .start = (size_t)meta.indexed_end, .end = csv.size, .seed = hdr.seed,
+                         .hash = hdr.hash};
+    arena_init(&part.keys, BUILD_KEY_ARENA_BLOCK);
+    build_part_main(&part);
+    int status = part.status;
+    if (status == 0 && part.count > 0) { // Las llaves nuevas van al filtro antes de enlazarse
+        uint64_t *hashes = malloc(sizeof(uint64_t) * part.count);
+        if (hashes == NULL) {
+            perror("malloc");
+            status = -1;
+        } else {
+            for (size_t i = 0; i < part.count; i++) hashes[i] = part.entries[i].hash;
+            build_bloom_mark(hdr.seed, hashes, part.count);
+            free(hashes);
         }
-        
-        linked_list_free_node(&node);
-        
-        if (buckets_write_head(bfd, bucket, new_node_off) != 0) {
+    }
+
+    linked_list_writer_t writer = {.fd = -1, .buf = NULL, .len = 0, .cap = 0, .tail = 0};
+    uint64_t *buckets = NULL;
+    off_t *heads = NULL;
+    size_t nheads = 0;
+    if (hdr.engine == BUCKETS_ENGINE_SLOTS) { // Sin nodos: la tabla se carga, recibe las filas nuevas y se reescribe
+        if (status == 0) status = incremental_slots(bfd, buckets_path, &hdr, &part);
+        goto save_meta;
+    }
+    off_t tail = lseek(afd, 0, SEEK_END);
+    if (status == 0 && (tail <= 0 || linked_list_writer_init(&writer, afd, tail, BUILD_WRITE_BUF_SIZE) != 0)) {
+        fprintf(stderr, "Error al abrir el archivo de nodos\n");
+        status = -1;
+    }
+
+    // Cabezas nuevas de los buckets tocados (como mucho una por entrada)
+    buckets = malloc(sizeof(uint64_t) * (part.count ? part.count : 1));
+    heads = malloc(sizeof(off_t) * (part.count ? part.count : 1));
+    if (status == 0 && (buckets == NULL || heads == NULL)) {
+        perror("malloc");
+        status = -1;
+    }
+    if (status == 0) {
+        qsort_r(part.entries, part.count, sizeof(build_entry_t), entry_bucket_cmp, &hdr);
+        for (size_t i = 0; i < part.count && status == 0; ) {
+            uint64_t bucket = buckets_bucket_of(&hdr, part.entries[i].hash);
+            off_t head = buckets_read_head(bfd, bucket);
+            /* Un nodo por llave nueva (en tramos de hasta LINKED_LIST_MAX_CAP filas, en orden del
+             * csv: el tramo mas reciente queda mas cerca del frente) */
+            while (i < part.count && buckets_bucket_of(&hdr, part.entries[i].hash) == bucket && status == 0) {
+                const build_entry_t *first = &part.entries[i];
+                uint32_t count = 0;
+                unsigned char postings[LINKED_LIST_MAX_CAP * LINKED_LIST_POSTING_SIZE];
+                for (; i < part.count && count < LINKED_LIST_MAX_CAP && same_key(&part.entries[i], first); i++, count++) {
+                    const build_entry_t *e = &part.entries[i];
+                    if (linked_list_posting_check(e->offset, e->record_len) != 0) {
+                        status = -1;
+                        break;
+                    }
+                    linked_list_posting_encode(e->offset, e->record_len, postings + (size_t)count * LINKED_LIST_POSTING_SIZE);
+                }
+                if (status != 0) break;
+                linked_list_node_t node = {.hash = first->hash, .next_ptr = head, .count = (uint16_t)count, .cap = (uint16_t)count,
+                                           .key_len = first->key_len, .key = (char *)first->key, .postings = postings};
+                head = linked_list_writer_append(&writer, &node);
+                if (head == 0) {
+                    fprintf(stderr, "Error al insertar nodo\n");
+                    status = -1;
+                }
+            }
+            buckets[nheads] = bucket;
+            heads[nheads++] = head;
+        }
+    }
+    // Primero los nodos (en disco), despues las cabezas que apuntan a ellos
+    if (status == 0 && (linked_list_writer_flush(&writer) != 0 || fdatasync(afd) != 0)) {
+        fprintf(stderr, "Error al escribir los nodos\n");
+        status = -1;
+    }
+    for (size_t k = 0; k < nheads && status == 0; k++) {
+        if (buckets_write_head(bfd, buckets[k], heads[k]) != 0) {
             fprintf(stderr, "failed write bucket head\n");
+            status = -1;
         }
     }
-    free(line);
-    fclose(csv_fp);
+    // Filas nuevas en el encabezado; si el load factor paso del maximo, la tabla crece con splits
+    if (status == 0) {
+        hdr.entry_count += part.count;
+        if (linked_list_writer_flush(&writer) != 0 || index_grow(bfd, afd, &hdr) != 0) status = -1;
+    }
+save_meta:
+    if (status == 0 && build_meta_save(BUILD_META_PATH, csv_path, (off_t)csv.size) != 0) {
+        fprintf(stderr, "Error al guardar %s\n", BUILD_META_PATH);
+        status = -1;
+    }
+
+    size_t rows = part.count;
+    size_t new_bytes = csv.size - (size_t)meta.indexed_end;
+    linked_list_writer_free(&writer);
+    free(buckets);
+    free(heads);
+    free(part.entries);
+    arena_free(&part.keys);
+    csv_map_close(&csv);
     close(bfd);
     close(afd);
+    if (status != 0) return -1;
+
+    double secs = elapsed_seconds(&start);
+    printf("Indice actualizado: %zu filas nuevas (%zu bytes) en %.2f s (%llu buckets)\n", rows, new_bytes, secs,
+           (unsigned long long)hdr.num_buckets);
     return 0;
 }
-  
\ No newline at end of file
@@ -3,9 +3,30 @@
 
 #include <stdint.h>
 
-/* Functions for building the two index files from dataset CSV */
+/* Functions for building the two index files from dataset CSV.
+ * hash: funcion de hash de las llaves del indice nuevo (HASH_*, --build --hash, ver hash.h) */
 
-int build_index_stream(const char *csv_path);
+int build_index_stream(const char *csv_path, uint32_t hash);
 int build_index_line(const char *csv_path, const char *line);
 
+/* Igual que build_index_stream (mismos archivos, byte a byte) pero procesa el csv en
+ * num_threads rangos en paralelo. Mantiene todas las entradas en memoria hasta escribirlas */
+int build_index_parallel(const char *csv_path, int num_threads, uint32_t hash);
+
+/* Construye el indice con el motor slots (--build --engine slots, ver slots.h), procesando el
+ * csv en num_threads rangos como build_index_parallel */
+int build_index_slots(const char *csv_path, int num_threads, uint32_t hash);
+
+/* Construye el indice de solo lectura con hash perfecto minimo (--build --static, ver
+ * static_index.h), procesando el csv en num_threads rangos */
+int build_index_static(const char *csv_path, int num_threads, uint32_t hash);
+
+#define BUILD_INCREMENTAL_FULL 1 // build_index_incremental: hace falta una construccion completa
+
+/* Indexa solo los registros agregados al final del csv despues de la ultima construccion
+ * (ver build_meta.h). Retorna 0, -1 si falla, o BUILD_INCREMENTAL_FULL si no hay meta o el csv
+ * no es una continuacion del que se indexo (el llamador decide como reconstruir). Usa la funcion
+ * de hash del indice existente */
+int build_index_incremental(const char *csv_path);
+
 #endif // BUILDER_H
@@ -0,0 +1,174 @@
+#include "compact.h"
+#include "buckets.h"
+#include "linked_list.h"
+#include "bloom.h"
+#include "common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define COMPACT_WRITE_BUF_SIZE (1 << 20) // Los nodos se escriben en bloques de 1 MiB
+#define COMPACT_KEY_BLOCK (64 * 1024)     // Bloques del arena de llaves de un bucket
+
+/* Junta las filas de un bucket: la lista enlazada (con nodos por fila o parciales de una llave)
+ * y el extent anterior, si lo hay. linked_list_writer_append_rows las reagrupa en un nodo por
+ * llave; el orden de los resultados solo depende de los offsets, asi que se conserva. */
+static int collect_bucket(int afd, const bucket_entry_t *old, linked_list_rows_t *rows, unsigned char *node_buf,
+                          unsigned char **extent_buf, size_t *extent_cap) {
+    off_t cur = old->head;
+    while (cur != 0) {
+        linked_list_node_t node;
+        if (linked_list_read_node(afd, cur, &node, node_buf, NULL) != 0) {
+            fprintf(stderr, "Error, no se pudo leer el nodo en el offset %lld\n", (long long)cur);
+            return -1;
+        }
+        if (linked_list_rows_add_node(rows, &node) != 0) return -1;
+        cur = node.next_ptr;
+    }
+
+    if (old->extent_len == 0) return 0;
+    if (old->extent_len > *extent_cap) {
+        unsigned char *tmp = realloc(*extent_buf, old->extent_len);
+        if (tmp == NULL) {
+            perror("realloc");
+            return -1;
+        }
+        *extent_buf = tmp;
+        *extent_cap = old->extent_len;
+    }
+    if (safe_pread(afd, *extent_buf, old->extent_len, old->extent_off) != (ssize_t)old->extent_len) {
+        fprintf(stderr, "Error, no se pudo leer el extent del bucket\n");
+        return -1;
+    }
+    size_t pos = 0;
+    for (uint32_t i = 0; i < old->extent_count; i++) {
+        linked_list_node_t node;
+        size_t size = linked_list_decode_node(*extent_buf + pos, old->extent_len - pos, &node);
+        if (size == 0) {
+            fprintf(stderr, "Error, extent corrupto\n");
+            return -1;
+        }
+        if (linked_list_rows_add_node(rows, &node) != 0) return -1;
+        pos += size;
+    }
+    return 0;
+}
+
+int index_compact(const char *buckets_path, const char *linked_list_path) {
+    char new_buckets_path[1024];
+    char new_linked_list_path[1024];
+    snprintf(new_buckets_path, sizeof(new_buckets_path), "%s.tmp", buckets_path);
+    snprintf(new_linked_list_path, sizeof(new_linked_list_path), "%s.tmp", linked_list_path);
+
+    int status = -1;
+    int bfd = -1, afd = -1, new_bfd = -1, new_afd = -1;
+    unsigned char *table = NULL, *node_buf = NULL, *extent_buf = NULL;
+    size_t extent_cap = 0;
+    linked_list_writer_t w = {.fd = -1, .buf = NULL, .len = 0, .cap = 0, .tail = 0};
+    linked_list_rows_t rows;
+    linked_list_rows_init(&rows, COMPACT_KEY_BLOCK);
+    bloom_t bloom = {.words = NULL, .map = NULL};
+
+    bfd = buckets_open_readwrite(buckets_path);
+    afd = linked_list_open(linked_list_path);
+    if (bfd < 0 || afd < 0) {
+        fprintf(stderr, "Error: no se pudo abrir el indice (ejecute --build primero)\n");
+        goto cleanup;
+    }
+
+    // La tabla de buckets completa se procesa en memoria (del encabezado solo cambia nodes_gen)
+    buckets_header_t hdr;
+    if (buckets_read_header(bfd, &hdr) != 0 || linked_list_check_gen(afd, hdr.nodes_gen) != 0) goto cleanup;
+    if (hdr.engine != BUCKETS_ENGINE_CHAIN) { // No hay listas enlazadas que reagrupar
+        printf("El indice usa el motor %s: no hay nada que compactar\n",
+               hdr.engine == BUCKETS_ENGINE_SLOTS ? "slots" : "static");
+        status = 0;
+        goto cleanup;
+    }
+    size_t table_size = (size_t)hdr.num_buckets * BUCKET_ENTRY_SIZE;
+    table = malloc(table_size);
+    node_buf = malloc(LINKED_LIST_MAX_NODE_SIZE);
+    // El filtro de Bloom se rehace del tamaño del indice actual (las filas ya se recorren aqui)
+    if (table == NULL || node_buf == NULL || bloom_init(&bloom, hdr.entry_count, hdr.seed) != 0) {
+        perror("malloc");
+        goto cleanup;
+    }
+    if (safe_pread(bfd, table, table_size, BUCKETS_HEADER_SIZE) != (ssize_t)table_size) {
+        fprintf(stderr, "Error, no se pudo leer el archivo de buckets\n");
+        goto cleanup;
+    }
+
+    hdr.nodes_gen++; // Si se interrumpe entre los dos rename, la tabla vieja no se acepta con los nodos nuevos
+    if (linked_list_nodes_create(new_linked_list_path, hdr.nodes_gen) != 0) goto cleanup;
+    new_afd = linked_list_open(new_linked_list_path);
+    if (new_afd < 0) {
+        fprintf(stderr, "open %s fallo: %s\n", new_linked_list_path, strerror(errno));
+        goto cleanup;
+    }
+    if (linked_list_writer_init(&w, new_afd, LINKED_LIST_FILE_HEADER_SIZE, COMPACT_WRITE_BUF_SIZE) != 0) goto cleanup;
+
+    // Buckets en orden: los extents quedan en el mismo orden que la tabla
+    for (uint64_t b = 0; b < hdr.num_buckets; b++) {
+        unsigned char *raw = table + b * BUCKET_ENTRY_SIZE;
+        bucket_entry_t old;
+        buckets_decode_entry(raw, &old);
+        if (old.head == 0 && old.extent_len == 0) continue; // Bucket vacio
+
+        bucket_entry_t entry = {.head = 0, .extent_off = w.tail, .extent_len = 0, .extent_count = 0};
+        linked_list_rows_reset(&rows);
+        if (collect_bucket(afd, &old, &rows, node_buf, &extent_buf, &extent_cap) != 0) goto cleanup;
+        for (size_t i = 0; i < rows.count; i++) bloom_add(&bloom, rows.rows[i].hash);
+        int64_t nodes = linked_list_writer_append_rows(&w, rows.rows, rows.count); // Un nodo por llave
+        if (nodes < 0) goto cleanup;
+        entry.extent_count = (uint32_t)nodes;
+        if ((uint64_t)(w.tail - entry.extent_off) > UINT32_MAX) {
+            fprintf(stderr, "Error: el bucket %llu es demasiado grande para un extent\n", (unsigned long long)b);
+            goto cleanup;
+        }
+        entry.extent_len = (uint32_t)(w.tail - entry.extent_off);
+        buckets_encode_entry(&entry, raw);
+    }
+    if (linked_list_writer_flush(&w) != 0 || fsync(new_afd) != 0) goto cleanup;
+
+    // Tabla nueva en un archivo aparte: los originales quedan intactos hasta el rename
+    new_bfd = open(new_buckets_path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (new_bfd < 0) {
+        fprintf(stderr, "open %s fallo: %s\n", new_buckets_path, strerror(errno));
+        goto cleanup;
+    }
+    if (buckets_write_header(new_bfd, &hdr) != 0 ||
+        safe_pwrite(new_bfd, table, table_size, BUCKETS_HEADER_SIZE) != (ssize_t)table_size || fsync(new_bfd) != 0) {
+        fprintf(stderr, "Error, no se pudo escribir el archivo de buckets\n");
+        goto cleanup;
+    }
+
+    if (rename(new_linked_list_path, linked_list_path) != 0 || rename(new_buckets_path, buckets_path) != 0) {
+        perror("rename");
+        goto cleanup;
+    }
+    status = 0;
+    if (bloom_write(&bloom, BLOOM_PATH) != 0) { // Sin filtro las busquedas siguen siendo correctas
+        fprintf(stderr, "Aviso: no se pudo escribir %s\n", BLOOM_PATH);
+        bloom_remove(BLOOM_PATH);
+    }
+
+cleanup:
+    if (bfd >= 0) close(bfd);
+    if (afd >= 0) close(afd);
+    if (new_bfd >= 0) close(new_bfd);
+    if (new_afd >= 0) close(new_afd);
+    if (status != 0) { // No dejar archivos temporales a medias
+        unlink(new_linked_list_path);
+        unlink(new_buckets_path);
+    }
+    free(table);
+    free(node_buf);
+    free(extent_buf);
+    linked_list_writer_free(&w);
+    linked_list_rows_free(&rows);
+    bloom_free(&bloom);
+    return status;
+}
@@ -0,0 +1,16 @@
+#ifndef COMPACT_H
+#define COMPACT_H
+
+/* Compactacion del indice: reescribe el archivo de nodos para que los nodos de cada bucket
+ * queden seguidos (un extent por bucket, con un solo nodo por llave) y actualiza las entradas
+ * de los buckets.
+ * Despues de compactar, una busqueda es un pread de la entrada del bucket y un pread del extent.
+ * Tambien reescribe el filtro de Bloom (bloom.h) con el tamaño del indice actual.
+ *
+ * Es una operacion offline: el servidor no debe estar sirviendo el indice mientras corre.
+ * Retorna 0, o -1 si falla (en ese caso los archivos originales no se modifican, salvo
+ * que falle el rename final). Los archivos nuevos llevan una generacion mas (nodes_gen): si el
+ * proceso muere entre los dos rename, index_open rechaza la tabla vieja con los nodos nuevos. */
+int index_compact(const char *buckets_path, const char *linked_list_path);
+
+#endif // COMPACT_H
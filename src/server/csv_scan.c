@@ -0,0 +1,191 @@
+#include "csv_scan.h"
+#include "util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CSV_SCAN_X86 1
+#endif
+
+/* ---- Busqueda del primer byte igual a a o b en [p, end) ---- */
+
+static const char *find2_scalar(const char *p, const char *end, char a, char b) {
+    for (; p < end; p++) {
+        if (*p == a || *p == b) return p;
+    }
+    return end;
+}
+
+#ifdef CSV_SCAN_X86
+// SSE2 es parte de x86-64: 16 bytes por iteracion
+static const char *find2_sse2(const char *p, const char *end, char a, char b) {
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    while (end - p >= 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)p);
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, va), _mm_cmpeq_epi8(x, vb)));
+        if (mask != 0) return p + __builtin_ctz((unsigned)mask);
+        p += 16;
+    }
+    return find2_scalar(p, end, a, b);
+}
+
+// AVX2 (si el procesador lo tiene): 32 bytes por iteracion
+__attribute__((target("avx2")))
+static const char *find2_avx2(const char *p, const char *end, char a, char b) {
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    while (end - p >= 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)p);
+        int mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(x, va), _mm256_cmpeq_epi8(x, vb)));
+        if (mask != 0) return p + __builtin_ctz((unsigned)mask);
+        p += 32;
+    }
+    return find2_sse2(p, end, a, b);
+}
+#endif
+
+static const char *find2(const char *p, const char *end, char a, char b) {
+#ifdef CSV_SCAN_X86
+    if (__builtin_cpu_supports("avx2")) return find2_avx2(p, end, a, b);
+    return find2_sse2(p, end, a, b);
+#else
+    return find2_scalar(p, end, a, b);
+#endif
+}
+
+/* ---- Registros ---- */
+
+// p apunta despues de la comilla que abre: retorna la comilla que cierra (o end)
+static const char *skip_quoted(const char *p, const char *end) {
+    while (p < end) {
+        const char *q = memchr(p, '"', (size_t)(end - p));
+        if (q == NULL) return end;
+        if (q + 1 < end && q[1] == '"') { // "" es una comilla dentro del campo
+            p = q + 2;
+            continue;
+        }
+        return q;
+    }
+    return end;
+}
+
+/* Salta hasta el final del registro desde p (fuera de comillas). Solo se detiene en '\n' y '"':
+ * las comas no importan aqui, y una comilla solo abre un campo si esta al inicio de el */
+static size_t skip_rest(const char *data, const char *rec_start, const char *p, const char *end) {
+    while (p < end) {
+        const char *q = find2(p, end, '\n', '"');
+        if (q == end) break;
+        if (*q == '\n') return (size_t)(q + 1 - data);
+        if (q == rec_start || q[-1] == ',') { // Campo entre comillas
+            q = skip_quoted(q + 1, end);
+            if (q == end) break;
+        }
+        p = q + 1;
+    }
+    return (size_t)(end - data);
+}
+
+size_t csv_scan_record(const char *data, size_t size, size_t pos, int field_idx, csv_field_t *field, int *found) {
+    const char *end = data + size;
+    const char *rec_start = data + pos;
+    const char *p = rec_start;
+    if (found) *found = 0;
+    if (field == NULL) return skip_rest(data, rec_start, p, end);
+
+    field->ptr = p;
+    field->len = 0;
+    field->quoted = 0;
+    // Campo por campo hasta llegar a field_idx
+    for (int idx = 0; idx <= field_idx; idx++) {
+        const char *fstart = p;
+        const char *fend;
+        int quoted = 0;
+        if (p < end && *p == '"') {
+            quoted = 1;
+            fstart = p + 1;
+            fend = skip_quoted(fstart, end);
+            p = fend < end ? fend + 1 : end;
+            p = find2(p, end, ',', '\n'); // Lo que siga a la comilla de cierre no es parte de la vista
+        } else {
+            p = find2(p, end, ',', '\n');
+            fend = p;
+        }
+        if (idx == field_idx) {
+            field->ptr = fstart;
+            field->len = (size_t)(fend - fstart);
+            field->quoted = quoted;
+            if (found) *found = 1;
+        }
+        if (p == end) return size;
+        if (*p == '\n') return (size_t)(p + 1 - data); // Fin del registro (puede que sin el campo buscado)
+        p++; // Salta la coma
+    }
+    return skip_rest(data, rec_start, p, end);
+}
+
+size_t csv_record_start_after(const char *data, size_t size, size_t pos, size_t from) {
+    while (pos < from && pos < size) pos = csv_scan_record(data, size, pos, 0, NULL, NULL);
+    return pos < size ? pos : size;
+}
+
+size_t csv_count_records(const char *data, size_t size, size_t pos) {
+    size_t n = 0;
+    while (pos < size) {
+        pos = csv_scan_record(data, size, pos, 0, NULL, NULL);
+        n++;
+    }
+    return n;
+}
+
+/* ---- Archivo ---- */
+
+int csv_map_open(const char *path, csv_map_t *map) {
+    map->data = NULL;
+    map->size = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("open (csv)");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror("fstat (csv)");
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // El mapeo sigue valido sin el fd
+    if (p == MAP_FAILED) {
+        perror("mmap (csv)");
+        return -1;
+    }
+    posix_madvise(p, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL); // Lectura de principio a fin
+    map->data = p;
+    map->size = (size_t)st.st_size;
+    return 0;
+}
+
+void csv_map_close(csv_map_t *map) {
+    if (map->data != NULL) munmap((void *)map->data, map->size);
+    map->data = NULL;
+    map->size = 0;
+}
+
+char *csv_field_normalized(const csv_field_t *field) {
+    char *out = malloc(field->len + 1);
+    if (out == NULL) return NULL;
+    // La normalizacion descarta las comillas, asi que el campo se normaliza tal como esta en el CSV
+    normalize_into(field->ptr, field->len, out);
+    return out;
+}
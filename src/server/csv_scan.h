@@ -0,0 +1,47 @@
+#ifndef CSV_SCAN_H
+#define CSV_SCAN_H
+
+#include <stddef.h>
+
+/* Lectura del csv para el builder: el archivo se mapea en memoria y los registros se recorren
+ * buscando '\n', ',' y '"' con kernels SSE2/AVX2 (con version escalar si no hay SIMD).
+ *
+ * Formato (RFC 4180): un campo que empieza con '"' va entre comillas, puede contener comas y
+ * saltos de linea, y una comilla dentro de el se escribe "". Una comilla en medio de un campo
+ * sin comillas es un caracter normal. Un registro termina en el primer '\n' fuera de comillas. */
+
+// Archivo csv mapeado (solo lectura). Un archivo vacio queda con data = NULL y size = 0
+typedef struct {
+    const char *data;
+    size_t size;
+} csv_map_t;
+
+/* Vista de un campo dentro del registro (sin copiar). Si quoted, la vista excluye las comillas
+ * exteriores pero las comillas internas siguen escritas como "" */
+typedef struct {
+    const char *ptr;
+    size_t len;
+    int quoted;
+} csv_field_t;
+
+/* Mapea el csv con MADV_SEQUENTIAL. Retorna 0, o -1 si falla */
+int csv_map_open(const char *path, csv_map_t *map);
+
+void csv_map_close(csv_map_t *map);
+
+/* Recorre el registro que empieza en pos. Si field no es NULL, recibe la vista del campo
+ * field_idx (len 0 si el registro tiene menos campos; retorna tambien found = 0 en ese caso).
+ * Retorna el offset del inicio del siguiente registro (size si es el ultimo) */
+size_t csv_scan_record(const char *data, size_t size, size_t pos, int field_idx, csv_field_t *field, int *found);
+
+/* Primer inicio de registro en from o despues, recorriendo los registros desde pos
+ * (pos debe ser inicio de registro). Retorna size si no hay mas registros */
+size_t csv_record_start_after(const char *data, size_t size, size_t pos, size_t from);
+
+/* Numero de registros desde pos (inicio de registro) hasta el final, sin procesar los campos */
+size_t csv_count_records(const char *data, size_t size, size_t pos);
+
+/* Normaliza el campo (ver normalize_into). Retorna un string con malloc, o NULL si falla */
+char *csv_field_normalized(const csv_field_t *field);
+
+#endif // CSV_SCAN_H
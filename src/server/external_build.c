@@ -0,0 +1,517 @@
+#define _GNU_SOURCE
+#include "external_build.h"
+#include "buckets.h"
+#include "linked_list.h"
+#include "bloom.h"
+#include "common.h"
+#include "hash.h"
+#include "util.h"
+#include "csv_scan.h"
+#include "build_meta.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+/* Tupla de un run (en memoria y en disco, sin alineacion):
+ * [uint64 hash][off_t offset][uint32 record_len][uint16 key_len][key]
+ * El bucket sale del hash; el orden es por bucket y, dentro del bucket, por offset descendente
+ * (la fila mas reciente primero, como en la lista enlazada de build_index_stream). */
+#define RUN_REC_HEADER (sizeof(uint64_t) + sizeof(off_t) + sizeof(uint32_t) + sizeof(uint16_t))
+#define RUN_REC_MAX (RUN_REC_HEADER + UINT16_MAX)
+#define RUN_READ_BUF_MIN ((size_t)2 * RUN_REC_MAX) // Siempre cabe una tupla completa
+#define OUT_NODE_BUF_SIZE ((size_t)4 << 20)     // Buffer del archivo de nodos
+#define OUT_TABLE_CHUNK 65536                   // Entradas de bucket por escritura
+#define OUT_KEY_BLOCK (64 * 1024)               // Arena de llaves del bucket abierto
+
+typedef struct {
+    uint64_t hash;
+    off_t offset;
+    uint32_t record_len;
+    uint16_t key_len;
+    const char *key; // Apunta al buffer del que se leyo la tupla
+} run_rec_t;
+
+static void rec_decode(const unsigned char *p, run_rec_t *r) {
+    size_t pos = 0;
+    memcpy(&r->hash, p + pos, sizeof(uint64_t));
+    pos += sizeof(uint64_t);
+    memcpy(&r->offset, p + pos, sizeof(off_t));
+    pos += sizeof(off_t);
+    memcpy(&r->record_len, p + pos, sizeof(uint32_t));
+    pos += sizeof(uint32_t);
+    memcpy(&r->key_len, p + pos, sizeof(uint16_t));
+    pos += sizeof(uint16_t);
+    r->key = (const char *)p + pos;
+}
+
+static size_t rec_encode(const run_rec_t *r, unsigned char *p) {
+    size_t pos = 0;
+    memcpy(p + pos, &r->hash, sizeof(uint64_t));
+    pos += sizeof(uint64_t);
+    memcpy(p + pos, &r->offset, sizeof(off_t));
+    pos += sizeof(off_t);
+    memcpy(p + pos, &r->record_len, sizeof(uint32_t));
+    pos += sizeof(uint32_t);
+    memcpy(p + pos, &r->key_len, sizeof(uint16_t));
+    pos += sizeof(uint16_t);
+    memcpy(p + pos, r->key, r->key_len);
+    return pos + r->key_len;
+}
+
+/* Mascara del bucket de la construccion en curso (la tabla nueva tiene split = 0). Es global
+ * porque la usan qsort y el heap de la mezcla; la construccion externa no corre en paralelo */
+static uint64_t run_bucket_mask;
+
+// Orden de las tuplas: bucket ascendente, offset descendente
+static int rec_less(const run_rec_t *a, const run_rec_t *b) {
+    uint64_t ba = bucket_id_from_hash(a->hash, run_bucket_mask), bb = bucket_id_from_hash(b->hash, run_bucket_mask);
+    if (ba != bb) return ba < bb;
+    return a->offset > b->offset;
+}
+
+static int rec_ptr_cmp(const void *x, const void *y) {
+    run_rec_t a, b;
+    rec_decode(*(const unsigned char *const *)x, &a);
+    rec_decode(*(const unsigned char *const *)y, &b);
+    if (rec_less(&a, &b)) return -1;
+    if (rec_less(&b, &a)) return 1;
+    return 0;
+}
+
+/* ---- Salida: archivo de nodos y tabla de buckets, ambos secuenciales ---- */
+
+typedef struct {
+    linked_list_writer_t nodes;
+    int bfd;
+    buckets_header_t hdr;
+    unsigned char *table;  // OUT_TABLE_CHUNK entradas pendientes de escribir
+    size_t table_len;      // Entradas en table
+    uint64_t next_bucket;  // Siguiente bucket que se agrega a la tabla
+    int has_cur;           // Hay un bucket abierto (con tuplas)
+    bucket_entry_t cur;
+    uint64_t cur_bucket;
+    linked_list_rows_t rows; // Filas del bucket abierto (se agrupan por llave al cerrarlo)
+    bloom_t bloom;           // Filtro de Bloom de todas las llaves (words = NULL si no hay memoria)
+} build_out_t;
+
+static int out_table_push(build_out_t *o, const bucket_entry_t *entry) {
+    buckets_encode_entry(entry, o->table + o->table_len * BUCKET_ENTRY_SIZE);
+    o->table_len++;
+    o->next_bucket++;
+    if (o->table_len == OUT_TABLE_CHUNK) {
+        size_t len = o->table_len * BUCKET_ENTRY_SIZE;
+        off_t pos = buckets_entry_offset(o->next_bucket - o->table_len);
+        if (safe_pwrite(o->bfd, o->table, len, pos) != (ssize_t)len) {
+            perror("pwrite (buckets)");
+            return -1;
+        }
+        o->table_len = 0;
+    }
+    return 0;
+}
+
+// Agrega buckets vacios hasta (sin incluir) bucket
+static int out_fill_empty(build_out_t *o, uint64_t bucket) {
+    bucket_entry_t empty = {.head = 0, .extent_off = 0, .extent_len = 0, .extent_count = 0};
+    while (o->next_bucket < bucket) {
+        if (out_table_push(o, &empty) != 0) return -1;
+    }
+    return 0;
+}
+
+static int out_close_bucket(build_out_t *o) {
+    if (!o->has_cur) return 0;
+    int64_t nodes = linked_list_writer_append_rows(&o->nodes, o->rows.rows, o->rows.count); // Un nodo por llave
+    linked_list_rows_reset(&o->rows);
+    if (nodes < 0) return -1;
+    o->cur.extent_count = (uint32_t)nodes;
+    if ((uint64_t)(o->nodes.tail - o->cur.extent_off) > UINT32_MAX) {
+        fprintf(stderr, "Error: el bucket %llu es demasiado grande para un extent\n", (unsigned long long)o->cur_bucket);
+        return -1;
+    }
+    o->cur.extent_len = (uint32_t)(o->nodes.tail - o->cur.extent_off);
+    o->has_cur = 0;
+    return out_table_push(o, &o->cur);
+}
+
+// Agrega una tupla (deben llegar en el orden de rec_less)
+static int out_add(build_out_t *o, const run_rec_t *r) {
+    uint64_t bucket = buckets_bucket_of(&o->hdr, r->hash);
+    if (!o->has_cur || bucket != o->cur_bucket) {
+        if (out_close_bucket(o) != 0 || out_fill_empty(o, bucket) != 0) return -1;
+        o->has_cur = 1;
+        o->cur_bucket = bucket;
+        o->cur.head = 0;
+        o->cur.extent_off = o->nodes.tail;
+        o->cur.extent_len = 0;
+        o->cur.extent_count = 0;
+    }
+    if (o->bloom.words != NULL) bloom_add(&o->bloom, r->hash);
+    return linked_list_rows_add(&o->rows, r->hash, r->key, r->key_len, r->offset, r->record_len);
+}
+
+static int out_finish(build_out_t *o) {
+    if (out_close_bucket(o) != 0 || out_fill_empty(o, o->hdr.num_buckets) != 0) return -1;
+    if (o->table_len > 0) {
+        size_t len = o->table_len * BUCKET_ENTRY_SIZE;
+        off_t pos = buckets_entry_offset(o->next_bucket - o->table_len);
+        if (safe_pwrite(o->bfd, o->table, len, pos) != (ssize_t)len) {
+            perror("pwrite (buckets)");
+            return -1;
+        }
+        o->table_len = 0;
+    }
+    if (buckets_write_header(o->bfd, &o->hdr) != 0) {
+        perror("pwrite (buckets)");
+        return -1;
+    }
+    return linked_list_writer_flush(&o->nodes);
+}
+
+/* ---- Runs en disco ---- */
+
+// Lector secuencial de un run; cur es la tupla actual (valida hasta la siguiente llamada)
+typedef struct {
+    int fd;
+    unsigned char *buf;
+    size_t cap;
+    size_t len;  // Bytes validos en buf
+    size_t pos;  // Inicio de la siguiente tupla
+    run_rec_t cur;
+} run_reader_t;
+
+// Avanza a la siguiente tupla. Retorna 1 si hay tupla, 0 al final del run, -1 si falla
+static int run_next(run_reader_t *rr) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        size_t avail = rr->len - rr->pos;
+        if (avail >= RUN_REC_HEADER) {
+            uint16_t key_len;
+            memcpy(&key_len, rr->buf + rr->pos + RUN_REC_HEADER - sizeof(uint16_t), sizeof(uint16_t));
+            if (avail >= RUN_REC_HEADER + key_len) {
+                rec_decode(rr->buf + rr->pos, &rr->cur);
+                rr->pos += RUN_REC_HEADER + key_len;
+                return 1;
+            }
+        }
+        // La tupla esta incompleta: mover el resto al inicio y leer mas
+        memmove(rr->buf, rr->buf + rr->pos, avail);
+        rr->len = avail;
+        rr->pos = 0;
+        ssize_t got = safe_read_full(rr->fd, rr->buf + rr->len, rr->cap - rr->len);
+        if (got < 0) {
+            perror("read (run)");
+            return -1;
+        }
+        rr->len += (size_t)got;
+        if (got == 0) break;
+    }
+    if (rr->len != rr->pos) {
+        fprintf(stderr, "Error: run incompleto\n");
+        return -1;
+    }
+    return 0;
+}
+
+static void run_path(char *out, size_t size, int run) {
+    snprintf(out, size, "%s/title_run_%d.tmp", INDEX_DIR, run);
+}
+
+/* ---- Construccion ---- */
+
+typedef struct {
+    unsigned char *recs;    // Tuplas serializadas del bloque actual
+    size_t recs_len;
+    size_t recs_cap;
+    unsigned char **order;  // Punteros a las tuplas (se ordenan)
+    size_t n;
+    size_t order_cap;
+} run_buffer_t;
+
+// Ordena el bloque en memoria y lo escribe como el run numero 'run'
+static int run_spill(run_buffer_t *rb, int run) {
+    qsort(rb->order, rb->n, sizeof(unsigned char *), rec_ptr_cmp);
+    char path[256];
+    run_path(path, sizeof(path), run);
+    int fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "open %s fallo: %s\n", path, strerror(errno));
+        return -1;
+    }
+    // Las tuplas se copian en orden a un buffer y se escriben por bloques de 1 MiB
+    size_t chunk_cap = (size_t)1 << 20;
+    unsigned char *chunk = malloc(chunk_cap);
+    if (chunk == NULL) {
+        close(fd);
+        return -1;
+    }
+    size_t chunk_len = 0;
+    int status = 0;
+    for (size_t i = 0; i < rb->n && status == 0; i++) {
+        run_rec_t r;
+        rec_decode(rb->order[i], &r);
+        size_t size = RUN_REC_HEADER + r.key_len;
+        if (chunk_len + size > chunk_cap) {
+            if (safe_write_full(fd, chunk, chunk_len) != (ssize_t)chunk_len) status = -1;
+            chunk_len = 0;
+        }
+        memcpy(chunk + chunk_len, rb->order[i], size);
+        chunk_len += size;
+    }
+    if (status == 0 && safe_write_full(fd, chunk, chunk_len) != (ssize_t)chunk_len) status = -1;
+    if (status != 0) perror("write (run)");
+    free(chunk);
+    close(fd);
+    rb->recs_len = 0;
+    rb->n = 0;
+    return status;
+}
+
+// Heap binario de minimos (por rec_less sobre la tupla actual de cada run): baja el elemento i
+static void heap_sift_down(const run_reader_t *readers, int *heap, int heap_len, int i) {
+    while (1) {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        if (l < heap_len && rec_less(&readers[heap[l]].cur, &readers[heap[m]].cur)) m = l;
+        if (r < heap_len && rec_less(&readers[heap[r]].cur, &readers[heap[m]].cur)) m = r;
+        if (m == i) return;
+        int t = heap[i];
+        heap[i] = heap[m];
+        heap[m] = t;
+        i = m;
+    }
+}
+
+// Mezcla los runs con un heap de minimos y escribe la salida
+static int merge_runs(int nruns, size_t memory_budget, build_out_t *out) {
+    run_reader_t *readers = calloc((size_t)nruns, sizeof(run_reader_t));
+    int *heap = malloc(sizeof(int) * (size_t)nruns);
+    if (readers == NULL || heap == NULL) {
+        free(readers);
+        free(heap);
+        return -1;
+    }
+    size_t per_run = memory_budget / (size_t)nruns;
+    if (per_run < RUN_READ_BUF_MIN) per_run = RUN_READ_BUF_MIN;
+
+    int status = 0;
+    int heap_len = 0;
+    for (int i = 0; i < nruns; i++) readers[i].fd = -1;
+    for (int i = 0; i < nruns && status == 0; i++) {
+        char path[256];
+        run_path(path, sizeof(path), i);
+        readers[i].fd = open(path, O_RDONLY);
+        readers[i].buf = malloc(per_run);
+        readers[i].cap = per_run;
+        if (readers[i].fd < 0 || readers[i].buf == NULL) {
+            fprintf(stderr, "Error: no se pudo abrir el run %s\n", path);
+            status = -1;
+            break;
+        }
+        posix_fadvise(readers[i].fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        int r = run_next(&readers[i]);
+        if (r < 0) status = -1;
+        else if (r == 1) heap[heap_len++] = i;
+    }
+
+    for (int i = heap_len / 2 - 1; i >= 0; i--) heap_sift_down(readers, heap, heap_len, i);
+    while (heap_len > 0 && status == 0) {
+        run_reader_t *top = &readers[heap[0]];
+        if (out_add(out, &top->cur) != 0) {
+            status = -1;
+            break;
+        }
+        int r = run_next(top);
+        if (r < 0) {
+            status = -1;
+            break;
+        }
+        if (r == 0) heap[0] = heap[--heap_len]; // Run agotado
+        heap_sift_down(readers, heap, heap_len, 0);
+    }
+
+    for (int i = 0; i < nruns; i++) {
+        if (readers[i].fd >= 0) close(readers[i].fd);
+        free(readers[i].buf);
+        char path[256];
+        run_path(path, sizeof(path), i);
+        unlink(path);
+    }
+    free(readers);
+    free(heap);
+    return status;
+}
+
+static double seconds_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int build_index_external(const char *csv_path, size_t memory_budget, uint32_t hash) {
+    char buckets_path[1024] = "data/index/title_buckets.dat";
+    char linked_list_path[1024] = "data/index/title_linked_list.dat";
+    if (memory_budget < EXTERNAL_BUILD_MIN_BUDGET) {
+        fprintf(stderr, "Aviso: el presupuesto de memoria se sube al minimo de %zu MiB\n", EXTERNAL_BUILD_MIN_BUDGET >> 20);
+        memory_budget = EXTERNAL_BUILD_MIN_BUDGET;
+    }
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (index_dir_create() != 0) return -1;
+    build_meta_remove(BUILD_META_PATH); // Hasta terminar, el indice no corresponde al csv
+    bloom_remove(BLOOM_PATH);
+
+    /* El csv se mapea: sus paginas son cache del archivo (el kernel las puede soltar), asi que
+     * no cuentan contra memory_budget */
+    csv_map_t csv;
+    if (csv_map_open(csv_path, &csv) != 0) {
+        fprintf(stderr,"open csv failed\n");
+        return -1;
+    }
+    /* El numero de buckets hace falta antes de ordenar: se cuentan los registros con una pasada
+     * que solo busca los fines de registro (mismo conteo que build_index_stream) */
+    size_t data_start = csv.size > 0 ? csv_scan_record(csv.data, csv.size, 0, 0, NULL, NULL) : 0; // Descarta el encabezado
+    size_t records = csv_count_records(csv.data, csv.size, data_start);
+    buckets_header_t hdr;
+    buckets_header_init(&hdr, records);
+    hdr.hash = hash;
+    hdr.nodes_gen = 1; // Los nodos quedan ya compactados, como los deja build_index_stream
+    run_bucket_mask = hdr.level_size - 1;
+    if (buckets_create(buckets_path, &hdr) != 0 || linked_list_nodes_create(linked_list_path, hdr.nodes_gen) != 0) {
+        fprintf(stderr, "Failed to create index files\n");
+        csv_map_close(&csv);
+        return -1;
+    }
+
+    /* El filtro de Bloom cuenta dentro de memory_budget: se descuenta su tamaño para todos los
+     * registros (cota de las filas con titulo) y el resto queda para ordenar y para mezclar. Si
+     * ocupa mas de la mitad del presupuesto, el indice queda sin filtro */
+    size_t bloom_bytes = bloom_size(records);
+    if (bloom_bytes > memory_budget / 2) {
+        fprintf(stderr, "Aviso: el filtro de Bloom (%zu MiB) no cabe en --memory, el indice queda sin filtro\n",
+                (bloom_bytes + ((size_t)1 << 20) - 1) >> 20);
+        bloom_bytes = 0;
+    }
+    size_t sort_budget = memory_budget - bloom_bytes;
+
+    // El resto del presupuesto se reparte entre las tuplas (4/5) y los punteros para ordenarlas (1/5)
+    run_buffer_t rb = {0};
+    rb.order_cap = sort_budget / 5 / sizeof(unsigned char *);
+    rb.recs_cap = sort_budget - rb.order_cap * sizeof(unsigned char *);
+    rb.recs = malloc(rb.recs_cap);
+    rb.order = malloc(rb.order_cap * sizeof(unsigned char *));
+    build_out_t out = {.bfd = -1, .hdr = hdr, .table = NULL, .bloom = {.words = NULL, .map = NULL}};
+    linked_list_rows_init(&out.rows, OUT_KEY_BLOCK);
+    int afd = -1;
+    int status = 0;
+    int nruns = 0;
+    size_t rows = 0;
+    if (rb.recs == NULL || rb.order == NULL) {
+        perror("malloc");
+        status = -1;
+        goto cleanup;
+    }
+
+    if (csv.size == 0) fprintf(stderr, "Aviso: El archivo csv esta vacio, el indice queda vacio\n");
+    size_t pos = data_start;
+
+    // Fase 1: tuplas ordenadas por bloques (un run por bloque lleno)
+    while (pos < csv.size) {
+        csv_field_t title;
+        int found;
+        size_t next = csv_scan_record(csv.data, csv.size, pos, TITLE_FIELD, &title, &found);
+        off_t offset = (off_t)pos;
+        uint32_t record_len = (uint32_t)(next - pos);
+        pos = next;
+        if (!found) continue;
+        char *normalized_title = csv_field_normalized(&title);
+        if (normalized_title == NULL) continue;
+
+        size_t key_len = strlen(normalized_title);
+        run_rec_t r = {.hash = buckets_hash_key(&hdr, normalized_title, key_len), .offset = offset,
+                       .record_len = record_len, .key_len = (uint16_t)key_len, .key = normalized_title};
+        size_t size = RUN_REC_HEADER + r.key_len;
+        if (rb.recs_len + size > rb.recs_cap || rb.n == rb.order_cap) { // Bloque lleno: a disco
+            if (run_spill(&rb, nruns) != 0) {
+                free(normalized_title);
+                status = -1;
+                goto cleanup;
+            }
+            nruns++;
+        }
+        rb.order[rb.n++] = rb.recs + rb.recs_len;
+        rb.recs_len += rec_encode(&r, rb.recs + rb.recs_len);
+        free(normalized_title);
+        rows++;
+    }
+
+    // Fase 2: salida secuencial
+    out.hdr.entry_count = rows;
+    out.bfd = buckets_open_readwrite(buckets_path);
+    afd = linked_list_open(linked_list_path);
+    out.table = malloc((size_t)OUT_TABLE_CHUNK * BUCKET_ENTRY_SIZE);
+    if (bloom_bytes > 0 && bloom_init(&out.bloom, rows, hdr.seed) != 0) out.bloom.words = NULL; // Sin filtro: solo se avisa
+    if (out.bfd < 0 || afd < 0 || out.table == NULL ||
+        linked_list_writer_init(&out.nodes, afd, LINKED_LIST_FILE_HEADER_SIZE, OUT_NODE_BUF_SIZE) != 0) {
+        fprintf(stderr, "Error al abrir los archivos del indice\n");
+        status = -1;
+        goto cleanup;
+    }
+    if (nruns == 0) { // Todo cupo en memoria: no hace falta pasar por disco
+        qsort(rb.order, rb.n, sizeof(unsigned char *), rec_ptr_cmp);
+        for (size_t i = 0; i < rb.n && status == 0; i++) {
+            run_rec_t r;
+            rec_decode(rb.order[i], &r);
+            if (out_add(&out, &r) != 0) status = -1;
+        }
+    } else {
+        if (rb.n > 0) {
+            if (run_spill(&rb, nruns) != 0) {
+                status = -1;
+                goto cleanup;
+            }
+            nruns++;
+        }
+        // Los buffers del bloque ya no se usan: la mezcla usa el presupuesto para leer los runs
+        free(rb.recs);
+        free(rb.order);
+        rb.recs = NULL;
+        rb.order = NULL;
+        if (merge_runs(nruns, sort_budget, &out) != 0) status = -1;
+    }
+    if (status == 0 && out_finish(&out) != 0) status = -1;
+    if (status == 0) {
+        double secs = seconds_since(&start);
+        printf("Indice construido (ordenamiento externo, %d runs): %zu filas en %.2f s (%.0f filas/s)\n",
+               nruns, rows, secs, secs > 0 ? (double)rows / secs : 0.0);
+        if (bloom_bytes > 0 && (out.bloom.words == NULL || bloom_write(&out.bloom, BLOOM_PATH) != 0)) {
+            fprintf(stderr, "Aviso: no se pudo escribir %s\n", BLOOM_PATH);
+        }
+        if (build_meta_save(BUILD_META_PATH, csv_path, (off_t)csv.size) != 0) {
+            fprintf(stderr, "Aviso: no se pudo guardar %s (--incremental hara una reconstruccion completa)\n", BUILD_META_PATH);
+        }
+    } else {
+        fprintf(stderr, "Error al escribir el indice\n");
+    }
+
+cleanup:
+    if (status != 0) { // Los runs de una construccion fallida no sirven
+        for (int i = 0; i < nruns; i++) {
+            char path[256];
+            run_path(path, sizeof(path), i);
+            unlink(path);
+        }
+    }
+    linked_list_writer_free(&out.nodes);
+    linked_list_rows_free(&out.rows);
+    bloom_free(&out.bloom);
+    free(out.table);
+    if (out.bfd >= 0) close(out.bfd);
+    if (afd >= 0) close(afd);
+    free(rb.recs);
+    free(rb.order);
+    csv_map_close(&csv);
+    return status;
+}
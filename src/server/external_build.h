@@ -0,0 +1,19 @@
+#ifndef EXTERNAL_BUILD_H
+#define EXTERNAL_BUILD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define EXTERNAL_BUILD_DEFAULT_BUDGET ((size_t)256 << 20) // Memoria por defecto: 256 MiB
+#define EXTERNAL_BUILD_MIN_BUDGET ((size_t)4 << 20)       // Minimo de --memory: 4 MiB
+
+/* Construccion con ordenamiento externo (--build --external), para csv mas grandes que la RAM.
+ * Lee el csv una vez y genera tuplas (bucket, llave, offset) que se ordenan en memoria por
+ * bloques de hasta memory_budget bytes (menos el filtro de Bloom, que cuenta dentro del
+ * presupuesto) y se guardan como runs ordenados en data/index/.
+ * Luego mezcla los runs (k-way merge) y escribe title_linked_list.dat y title_buckets.dat
+ * en una sola pasada secuencial cada uno. El resultado es identico al de build_index_stream.
+ * hash: funcion de hash de las llaves (HASH_*, ver hash.h). Retorna 0, o -1 si falla */
+int build_index_external(const char *csv_path, size_t memory_budget, uint32_t hash);
+
+#endif // EXTERNAL_BUILD_H
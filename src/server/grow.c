@@ -0,0 +1,147 @@
+#include "grow.h"
+#include "linked_list.h"
+#include "arena.h"
+#include "common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define GROW_WRITE_BUF_SIZE (64 * 1024)
+#define GROW_ARENA_BLOCK (64 * 1024)
+
+typedef struct {
+    linked_list_writer_t writer;
+    unsigned char *node_buf;
+    arena_t arena;            // Extent del bucket que se divide
+    linked_list_rows_t rows;  // Filas del bucket que se divide (con sus llaves)
+    linked_list_row_t *part;  // Filas que quedan en uno de los dos buckets
+} grow_state_t;
+
+static int needs_split(const buckets_header_t *hdr) {
+    return hdr->entry_count * 100 > hdr->num_buckets * hdr->max_load_pct;
+}
+
+// Filas del bucket: lista enlazada y extent
+static int collect_rows(int afd, const bucket_entry_t *entry, grow_state_t *g) {
+    off_t cur = entry->head;
+    while (cur != 0) {
+        linked_list_node_t node;
+        if (linked_list_read_node(afd, cur, &node, g->node_buf, NULL) != 0) {
+            fprintf(stderr, "Error, no se pudo leer el nodo en el offset %lld\n", (long long)cur);
+            return -1;
+        }
+        if (linked_list_rows_add_node(&g->rows, &node) != 0) return -1;
+        cur = node.next_ptr;
+    }
+    if (entry->extent_len == 0) return 0;
+    unsigned char *extent = arena_alloc(&g->arena, entry->extent_len);
+    if (extent == NULL) return -1;
+    if (safe_pread(afd, extent, entry->extent_len, entry->extent_off) != (ssize_t)entry->extent_len) {
+        fprintf(stderr, "Error, no se pudo leer el extent del bucket\n");
+        return -1;
+    }
+    size_t pos = 0;
+    for (uint32_t i = 0; i < entry->extent_count; i++) {
+        linked_list_node_t node;
+        size_t size = linked_list_decode_node(extent + pos, entry->extent_len - pos, &node);
+        if (size == 0) {
+            fprintf(stderr, "Error, extent corrupto\n");
+            return -1;
+        }
+        if (linked_list_rows_add_node(&g->rows, &node) != 0) return -1;
+        pos += size;
+    }
+    return 0;
+}
+
+// Escribe como un extent (un nodo por llave) las filas que caen en bucket (con mask)
+static int write_extent(grow_state_t *g, uint64_t bucket, uint64_t mask, bucket_entry_t *out) {
+    size_t n = 0;
+    for (size_t i = 0; i < g->rows.count; i++) {
+        if (bucket_id_from_hash(g->rows.rows[i].hash, mask) == bucket) g->part[n++] = g->rows.rows[i];
+    }
+    out->head = 0;
+    out->extent_off = g->writer.tail;
+    int64_t nodes = linked_list_writer_append_rows(&g->writer, g->part, n);
+    if (nodes < 0) return -1;
+    out->extent_count = (uint32_t)nodes;
+    if ((uint64_t)(g->writer.tail - out->extent_off) > UINT32_MAX) {
+        fprintf(stderr, "Error: el bucket %llu es demasiado grande para un extent\n", (unsigned long long)bucket);
+        return -1;
+    }
+    out->extent_len = (uint32_t)(g->writer.tail - out->extent_off);
+    if (out->extent_count == 0) out->extent_off = 0;
+    return 0;
+}
+
+static int split_next(int bfd, int afd, buckets_header_t *hdr, grow_state_t *g) {
+    uint64_t s = hdr->split;
+    uint64_t t = s + hdr->level_size; // Siempre es la entrada siguiente a la ultima del archivo
+    uint64_t mask = hdr->level_size * 2 - 1;
+
+    bucket_entry_t old;
+    if (buckets_read_entry(bfd, s, &old) != 0) return -1;
+    arena_reset(&g->arena);
+    linked_list_rows_reset(&g->rows);
+    if (collect_rows(afd, &old, g) != 0) return -1;
+    size_t moved = 0;
+    for (size_t i = 0; i < g->rows.count; i++) {
+        if (bucket_id_from_hash(g->rows.rows[i].hash, mask) == t) moved++;
+    }
+    linked_list_row_t *part = realloc(g->part, sizeof(linked_list_row_t) * (g->rows.count ? g->rows.count : 1));
+    if (part == NULL) return -1;
+    g->part = part;
+
+    bucket_entry_t es = old;
+    bucket_entry_t et = {.head = 0, .extent_off = 0, .extent_len = 0, .extent_count = 0};
+    if (moved > 0) { // Si ninguna fila cambia de bucket, s queda como estaba
+        if (write_extent(g, s, mask, &es) != 0 || write_extent(g, t, mask, &et) != 0 ||
+            linked_list_writer_flush(&g->writer) != 0) {
+            fprintf(stderr, "Error al escribir los nodos del split\n");
+            return -1;
+        }
+    }
+    if (buckets_write_entry(bfd, t, &et) != 0) return -1;
+
+    buckets_header_t next = *hdr;
+    next.split++;
+    next.num_buckets++;
+    if (next.split == next.level_size) { // Termino el nivel: todos los buckets usan el bit nuevo
+        next.level_size *= 2;
+        next.split = 0;
+    }
+    int status = 0;
+    buckets_generation_bump(); // Impar: los lectores repiten la busqueda
+    if (buckets_write_header(bfd, &next) != 0) status = -1;
+    if (status == 0 && moved > 0 && buckets_write_entry(bfd, s, &es) != 0) status = -1;
+    buckets_generation_bump();
+    if (status == 0) *hdr = next;
+    return status;
+}
+
+int index_grow(int bfd, int afd, buckets_header_t *hdr) {
+    if (!needs_split(hdr)) return buckets_write_header(bfd, hdr);
+
+    grow_state_t g = {.writer = {.fd = -1, .buf = NULL, .len = 0, .cap = 0, .tail = 0}, .node_buf = NULL,
+                      .part = NULL};
+    arena_init(&g.arena, GROW_ARENA_BLOCK);
+    linked_list_rows_init(&g.rows, GROW_ARENA_BLOCK);
+    int status = -1;
+    off_t tail = lseek(afd, 0, SEEK_END);
+    g.node_buf = malloc(LINKED_LIST_MAX_NODE_SIZE);
+    if (tail > 0 && g.node_buf != NULL && linked_list_writer_init(&g.writer, afd, tail, GROW_WRITE_BUF_SIZE) == 0) {
+        status = 0;
+        while (status == 0 && needs_split(hdr)) status = split_next(bfd, afd, hdr, &g);
+    }
+    if (status != 0) {
+        fprintf(stderr, "Error al dividir el bucket %llu\n", (unsigned long long)hdr->split);
+        buckets_write_header(bfd, hdr); // Al menos el entry_count queda al dia
+    }
+    linked_list_writer_free(&g.writer);
+    free(g.node_buf);
+    free(g.part);
+    linked_list_rows_free(&g.rows);
+    arena_free(&g.arena);
+    return status;
+}
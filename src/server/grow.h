@@ -0,0 +1,20 @@
+#ifndef GROW_H
+#define GROW_H
+
+#include "buckets.h"
+
+/* Crecimiento en linea de la tabla de buckets (hashing lineal).
+ * Mientras entry_count (filas) / num_buckets pase de max_load_pct, divide el bucket hdr->split:
+ * sus filas (lista enlazada y extent) se reparten entre split y split + level_size segun un bit
+ * mas del hash y se escriben como dos extents nuevos, con un nodo por llave, al final del archivo
+ * de nodos (los nodos viejos
+ * quedan sin uso hasta el proximo --compact). Solo se toca un bucket por split, asi que no hace
+ * falta reconstruir el indice.
+ *
+ * Orden de escritura: nodos, entrada del bucket nuevo, encabezado y al final la entrada del bucket
+ * dividido; las dos ultimas dentro de una generacion impar (ver buckets_generation) para que los
+ * lectores del mismo proceso repitan la busqueda si se cruzan con el split.
+ * Siempre deja escrito el encabezado (con el entry_count de hdr). Retorna 0, o -1 si falla */
+int index_grow(int bfd, int afd, buckets_header_t *hdr);
+
+#endif // GROW_H
@@ -0,0 +1,488 @@
+#define _GNU_SOURCE
+#include "handlers.h"
+#include "builder.h"
+#include "common.h"
+#include "csv_scan.h"
+#include "util.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define INLINE_RECORD_MAX (16 * 1024) // Lineas mas largas se envian con sendfile
+#define INLINE_RESPONSE_MAX (64 * 1024) // Bytes de lineas copiados a memoria por respuesta; el resto va con sendfile
+
+// Definición de las rutas (ajusta si es necesario)
+const char *BUCKETS_PATH = "data/index/title_buckets.dat";
+const char *linked_list_PATH = "data/index/title_linked_list.dat";
+
+// Serializa las llamadas a build_index_line entre hilos (las busquedas no lo necesitan)
+static pthread_mutex_t add_book_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void *handler_ctx_init(int worker_id, void *arg) {
+    const handler_config_t *cfg = arg;
+    handler_ctx_t *ctx = malloc(sizeof(*ctx));
+    if (ctx == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    ctx->worker_id = worker_id;
+    int use_mmap = cfg != NULL && cfg->use_mmap;
+    int opened = use_mmap ? index_open_mmap(&ctx->index, BUCKETS_PATH, linked_list_PATH)
+                          : index_open(&ctx->index, BUCKETS_PATH, linked_list_PATH);
+    if (opened != 0) {
+        fprintf(stderr, "Error: No se pudo abrir el índice. Para construir el indice use --build\n");
+        free(ctx);
+        return NULL;
+    }
+    ctx->line_buf = NULL;
+    ctx->line_buf_size = 0;
+    ctx->reads = NULL;
+    ctx->reads_cap = 0;
+    ctx->cache = cfg != NULL ? cfg->cache : NULL;
+    ctx->key_buf = NULL;
+    ctx->key_buf_size = 0;
+    ctx->csv_fd = open(CSV_PATH, O_RDONLY | O_CLOEXEC); // Dataset
+    if (ctx->csv_fd < 0) {
+        perror("open (CSV_PATH)");
+        fprintf(stderr, "Error: No se pudo abrir el archivo CSV: %s\n", CSV_PATH);
+        index_close(&ctx->index);
+        free(ctx);
+        return NULL;
+    }
+    page_pool_t *pool = cfg != NULL ? cfg->pool : NULL;
+    if (pool_file_open(&ctx->csv_pf, pool, POOL_RECORDS, ctx->csv_fd) != 0 || index_use_pool(&ctx->index, pool) != 0) {
+        fprintf(stderr, "Error: No se pudo usar el pool de paginas\n");
+        pool_file_close(&ctx->csv_pf);
+        close(ctx->csv_fd);
+        index_close(&ctx->index);
+        free(ctx);
+        return NULL;
+    }
+    // Sin io_uring en el kernel el anillo queda en NULL y las lecturas siguen con pread
+    ctx->ring = cfg != NULL && cfg->use_io_uring ? io_ring_create(IO_RING_ENTRIES) : NULL;
+    index_use_ring(&ctx->index, ctx->ring);
+    return ctx;
+}
+
+void handler_ctx_free(void *arg) {
+    handler_ctx_t *ctx = arg;
+    pool_file_close(&ctx->csv_pf);
+    close(ctx->csv_fd);
+    index_close(&ctx->index);
+    io_ring_destroy(ctx->ring);
+    free(ctx->line_buf);
+    free(ctx->reads);
+    free(ctx->key_buf);
+    free(ctx);
+}
+
+/**
+ * @brief Normaliza len bytes de s en ctx->key_buf (la llave del cache).
+ * Retorna la longitud de la llave, o -1 si falla malloc.
+ */
+static long cache_key(handler_ctx_t *ctx, const char *s, size_t len) {
+    if (ctx->key_buf_size < len + 1) {
+        char *tmp = realloc(ctx->key_buf, len + 1);
+        if (tmp == NULL) return -1;
+        ctx->key_buf = tmp;
+        ctx->key_buf_size = len + 1;
+    }
+    return (long)normalize_into(s, len, ctx->key_buf);
+}
+
+/**
+ * @brief Invalida en el cache las respuestas que cambia la linea agregada (ver result_cache_invalidate_title).
+ */
+static void cache_invalidate_line(handler_ctx_t *ctx, const char *line) {
+    csv_field_t title;
+    int found;
+    csv_scan_record(line, strlen(line), 0, TITLE_FIELD, &title, &found); // Mismo titulo que indexa build_index_line
+    if (!found) return;
+    long len = cache_key(ctx, title.ptr, title.len);
+    if (len < 0) { // Sin la llave no se sabe que borrar: se vacia el cache
+        result_cache_clear(ctx->cache);
+        return;
+    }
+    result_cache_invalidate_title(ctx->cache, ctx->key_buf, (size_t)len);
+}
+
+/**
+ * @brief Agrega un libro (una linea CSV) al dataset y al indice.
+ * Respuesta: [uint32_t ok]
+ */
+static int handle_add_book(handler_ctx_t *ctx, const char *body, uint32_t body_len, response_t *resp) {
+    // Copiar la linea para terminarla en '\0'
+    char *line_buf = malloc(body_len + 1);
+    if (!line_buf) {
+        perror("malloc");
+        return -1;
+    }
+    memcpy(line_buf, body, body_len);
+    line_buf[body_len] = '\0'; 
+
+    printf("Recibido nuevo libro:\n%s\n", line_buf);
+
+    // Guardar la linea en el CSV e indexar y confirmar exito
+    // build_index_line lee y reescribe cabezas de buckets: solo un hilo a la vez puede agregar libros
+    pthread_mutex_lock(&add_book_lock);
+    int add_status = build_index_line(CSV_PATH, line_buf);
+    pthread_mutex_unlock(&add_book_lock);
+    // Aunque falle, parte de la fila pudo quedar en el indice: las respuestas guardadas ya no valen
+    if (ctx->cache != NULL) cache_invalidate_line(ctx, line_buf);
+    uint32_t ok = (add_status == 0);
+    if (ok) {
+        printf("Libro indexado correctamente.\n");
+    } else {
+        fprintf(stderr, "Error al agregar libro.\n");
+    }
+
+    free(line_buf);
+    return response_append_u32(resp, ok);
+}
+
+/**
+ * @brief Decide si una linea va copiada en la respuesta o con sendfile, dado el largo *len que
+ * tendria la respuesta en memoria, y avanza *len como lo haria agregarla.
+ */
+static int line_is_inline(size_t *len, uint32_t line_len) {
+    int inline_line = line_len <= INLINE_RECORD_MAX && *len + line_len <= INLINE_RESPONSE_MAX;
+    *len += sizeof(uint32_t) + (inline_line ? line_len : 0);
+    return inline_line;
+}
+
+/**
+ * @brief Lee en ctx->line_buf, todas juntas, las lineas de entries que van copiadas en una
+ * respuesta de largo len (ver line_is_inline): con io_uring quedan todas en vuelo a la vez; si no,
+ * se leen una tras otra (por el pool de paginas si hay uno). ctx->reads[k] es la k-esima.
+ * Retorna el numero de lecturas, o -1 si falla malloc.
+ */
+static long csv_read_records(handler_ctx_t *ctx, const index_entry_t *entries, uint32_t count, size_t len) {
+    size_t n = 0, bytes = 0, sim = len;
+    for (uint32_t i = 0; i < count; i++) {
+        if (entries[i].length == 0 || !line_is_inline(&sim, entries[i].length)) continue;
+        n++;
+        bytes += entries[i].length;
+    }
+    if (n == 0) return 0;
+    if (ctx->line_buf_size < bytes) { // Crecer los buffers a lo necesario
+        char *tmp = realloc(ctx->line_buf, bytes);
+        if (tmp == NULL) return -1;
+        ctx->line_buf = tmp;
+        ctx->line_buf_size = bytes;
+    }
+    if (ctx->reads_cap < n) {
+        io_read_t *tmp = realloc(ctx->reads, n * sizeof(io_read_t));
+        if (tmp == NULL) return -1;
+        ctx->reads = tmp;
+        ctx->reads_cap = n;
+    }
+
+    size_t k = 0, pos = 0;
+    sim = len;
+    for (uint32_t i = 0; i < count; i++) {
+        if (entries[i].length == 0 || !line_is_inline(&sim, entries[i].length)) continue;
+        ctx->reads[k++] = (io_read_t){.fd = ctx->csv_fd, .buf = ctx->line_buf + pos, .len = entries[i].length,
+                                      .offset = entries[i].offset};
+        pos += entries[i].length;
+    }
+    if (ctx->csv_pf.pool == NULL) {
+        io_read_batch(ctx->ring, ctx->reads, n);
+    } else {
+        for (k = 0; k < n; k++) {
+            io_read_t *rd = &ctx->reads[k];
+            rd->result = pool_file_pread(&ctx->csv_pf, rd->buf, rd->len, rd->offset);
+        }
+    }
+    return (long)n;
+}
+
+/**
+ * @brief Agrega a la respuesta un grupo de resultados: [int32_t count] seguido de
+ * count x [uint32_t line_len][char* line]. Las lineas cortas se copian a la respuesta
+ * (se envian junto con las cabeceras en un solo writev); las largas y las que exceden
+ * INLINE_RESPONSE_MAX se referencian como rangos del CSV que el reactor envia con sendfile.
+ * lookup_status distinto de 0 se envia como count = -1.
+ * *cacheable queda en 1 si el grupo salio completo y entero en memoria (se puede guardar en el cache).
+ */
+static int append_result_group(handler_ctx_t *ctx, int lookup_status, const index_entry_t *entries, uint32_t count,
+                               response_t *resp, int *cacheable) {
+    *cacheable = lookup_status == 0;
+    int32_t response_count = lookup_status != 0 ? -1 : (int32_t)count; // -1: Código de error
+    if (lookup_status != 0) count = 0; // No enviaremos datos
+
+    // El numero de resultados se corrige al final, cuando se sabe cuantas lineas se pudieron leer
+    size_t count_pos = resp->len;
+    if (response_append_i32(resp, response_count) != 0) return -1;
+
+    // Primero se leen juntas todas las lineas que van copiadas
+    size_t sim = resp->len;
+    if (csv_read_records(ctx, entries, count, sim) < 0) return -1;
+
+    int32_t sent = 0;
+    size_t k = 0; // Siguiente lectura de ctx->reads
+    for (uint32_t i = 0; i < count; i++) {
+        // El indice guarda la longitud de la linea: no hace falta buscar el '\n'
+        uint32_t net_line_len = entries[i].length;
+        if (net_line_len == 0) continue; // Saltar este resultado
+
+        int inline_line = line_is_inline(&sim, net_line_len); // Lo mismo que decidio csv_read_records
+        const io_read_t *rd = inline_line ? &ctx->reads[k++] : NULL;
+        if (inline_line && rd->result != (ssize_t)net_line_len) {
+            perror("pread (csv)");
+            *cacheable = 0;
+            continue; // Saltar este resultado
+        }
+        if (!inline_line) *cacheable = 0;
+        if (response_append_u32(resp, net_line_len) != 0) return -1;
+        if (inline_line) {
+            if (response_append(resp, rd->buf, net_line_len) != 0) return -1;
+        } else {
+            // Se envia con sendfile desde el CSV, sin leerla en el proceso
+            if (response_append_file(resp, ctx->csv_fd, entries[i].offset, net_line_len) != 0) return -1;
+        }
+        sent++;
+    }
+    memcpy(resp->data + count_pos, &sent, sizeof(sent)); // Solo se anuncian las lineas que realmente se enviaran
+    return 0;
+}
+
+/**
+ * @brief Busca un titulo en el indice y arma la respuesta con las lineas del CSV.
+ * Respuesta: [int32_t count] seguido de count x [uint32_t line_len][char* line]
+ */
+static int handle_lookup(handler_ctx_t *ctx, const char *body, uint32_t body_len, response_t *resp) {
+    // --- 0. Cache: una consulta repetida se responde con un probe, sin leer el indice ni el CSV ---
+    long key_len = -1;
+    uint64_t epoch = 0;
+    if (ctx->cache != NULL) {
+        key_len = cache_key(ctx, body, strnlen(body, body_len)); // index_lookup tambien termina en el primer '\0'
+        int hit = key_len < 0 ? 0 : result_cache_get(ctx->cache, ctx->key_buf, (size_t)key_len, resp);
+        if (hit < 0) return -1;
+        if (hit) {
+            printf("Consulta '%.*s' respondida desde el cache.\n", (int)body_len, body);
+            return 0;
+        }
+        epoch = result_cache_epoch(ctx->cache); // Antes de leer el indice
+    }
+
+    // --- 1. Copiar la consulta ---
+    char *query_buf = malloc(body_len + 1);
+    if (!query_buf) {
+        perror("malloc");
+        return -1;
+    }
+    memcpy(query_buf, body, body_len);
+    query_buf[body_len] = '\0'; // Asegurar NUL-terminator para index_lookup
+
+    // --- 2. Procesar la Consulta ---
+    
+    index_entry_t *entries = NULL;
+    uint32_t count = 0;
+    int lookup_status = index_lookup(&ctx->index, query_buf, &entries, &count);
+    if (lookup_status != 0) {
+        fprintf(stderr, "Error durante index_lookup.\n");
+    } else {
+        printf("Consulta '%s' procesada. Resultados: %u\n", query_buf, count);
+    }
+
+    // --- 3. Armar la Respuesta ---
+    size_t group_start = resp->len;
+    int cacheable;
+    int status = append_result_group(ctx, lookup_status, entries, count, resp, &cacheable);
+    if (status == 0 && cacheable && key_len >= 0) {
+        result_cache_put(ctx->cache, ctx->key_buf, (size_t)key_len, resp->data + group_start, resp->len - group_start,
+                         epoch);
+    }
+
+    // --- 4. Limpieza ---
+    free(query_buf);
+    if (entries) {
+        free(entries); // index_lookup alocó esto, lo liberamos aquí.
+    }
+    return status;
+}
+
+/**
+ * @brief Busca varios titulos en una sola peticion.
+ * Cuerpo: [uint32_t n] seguido de n x [uint32_t len][char* title]
+ * Respuesta: [int32_t n] seguido de n grupos con el formato de OP_LOOKUP, en el mismo orden.
+ */
+static int handle_multi_lookup(handler_ctx_t *ctx, const char *body, uint32_t body_len, response_t *resp) {
+    uint32_t n;
+    if (body_len < sizeof(n)) return -1;
+    memcpy(&n, body, sizeof(n));
+    if (n > PROTO_MAX_MULTI_KEYS) {
+        fprintf(stderr, "OP_MULTI_LOOKUP con demasiados titulos (%u)\n", n);
+        return -1;
+    }
+
+    // --- 1. Separar los titulos (copia terminada en '\0' de todo el cuerpo) ---
+    char *titles_buf = malloc(body_len + n + 1);
+    const char **keys = malloc(sizeof(char *) * (n ? n : 1));
+    index_result_t *results = malloc(sizeof(index_result_t) * (n ? n : 1));
+    if (!titles_buf || !keys || !results) {
+        perror("malloc");
+        free(titles_buf);
+        free(keys);
+        free(results);
+        return -1;
+    }
+
+    size_t pos = sizeof(n);
+    size_t out = 0;
+    uint32_t parsed = 0;
+    for (uint32_t i = 0; i < n; i++, parsed++) {
+        uint32_t len;
+        if (body_len - pos < sizeof(len)) break;
+        memcpy(&len, body + pos, sizeof(len));
+        pos += sizeof(len);
+        if (body_len - pos < len) break;
+        keys[i] = titles_buf + out;
+        memcpy(titles_buf + out, body + pos, len);
+        out += len;
+        titles_buf[out++] = '\0';
+        pos += len;
+    }
+    if (parsed != n || pos != body_len) { // Cuerpo truncado o con bytes de mas
+        fprintf(stderr, "OP_MULTI_LOOKUP mal formado\n");
+        free(titles_buf);
+        free(keys);
+        free(results);
+        return -1;
+    }
+
+    // --- 2. Cache: los grupos guardados se copian a hits; solo los demas titulos van al indice ---
+    response_t hits;
+    response_init(&hits);
+    size_t *hit_end = NULL;   // Con cache: fin del grupo del titulo i en hits (sin avanzar si no estaba)
+    char *nkeys = NULL;       // Llaves normalizadas de los titulos que no estaban, seguidas
+    size_t *nkey_end = NULL;  // Fin de la llave del titulo i en nkeys (sin avanzar si estaba)
+    const char **miss_keys = keys;
+    uint32_t nmiss = n;
+    uint64_t epoch = 0;
+    int status = 0;
+    if (ctx->cache != NULL && n > 0) {
+        hit_end = malloc(sizeof(size_t) * n);
+        nkey_end = malloc(sizeof(size_t) * n);
+        nkeys = malloc(out); // Una llave normalizada no es mas larga que el titulo
+        miss_keys = malloc(sizeof(char *) * n);
+        if (!hit_end || !nkey_end || !nkeys || !miss_keys) {
+            perror("malloc");
+            status = -1;
+        }
+        epoch = result_cache_epoch(ctx->cache); // Antes de leer el indice
+        size_t kpos = 0;
+        nmiss = 0;
+        for (uint32_t i = 0; status == 0 && i < n; i++) {
+            size_t len = normalize_into(keys[i], strlen(keys[i]), nkeys + kpos);
+            // Como las lineas leidas del csv, lo copiado del cache se limita a INLINE_RESPONSE_MAX por respuesta
+            int hit = hits.len < INLINE_RESPONSE_MAX ? result_cache_get(ctx->cache, nkeys + kpos, len, &hits) : 0;
+            if (hit < 0) status = -1;
+            if (hit == 0) {
+                miss_keys[nmiss++] = keys[i];
+                kpos += len;
+            }
+            hit_end[i] = hits.len;
+            nkey_end[i] = kpos;
+        }
+    }
+
+    // --- 3. Buscar las llaves que faltan, todas juntas ---
+    int lookup_status = status;
+    if (status == 0) {
+        lookup_status = index_lookup_many(&ctx->index, miss_keys, nmiss, results);
+        if (lookup_status != 0) {
+            fprintf(stderr, "Error durante index_lookup_many.\n");
+        } else {
+            printf("Consulta multiple de %u titulos procesada (%u desde el cache).\n", n, n - nmiss);
+        }
+    }
+
+    // --- 4. Armar la Respuesta, en el orden de los titulos ---
+    if (status == 0) status = response_append_i32(resp, lookup_status != 0 ? -1 : (int32_t)n);
+    uint32_t m = 0; // Siguiente resultado de index_lookup_many
+    for (uint32_t i = 0; status == 0 && lookup_status == 0 && i < n; i++) {
+        size_t hit_start = (hit_end != NULL && i > 0) ? hit_end[i - 1] : 0;
+        if (hit_end != NULL && hit_end[i] > hit_start) { // Estaba en el cache
+            status = response_append(resp, hits.data + hit_start, hit_end[i] - hit_start);
+            continue;
+        }
+        size_t group_start = resp->len;
+        int cacheable;
+        status = append_result_group(ctx, 0, results[m].entries, results[m].count, resp, &cacheable);
+        if (status == 0 && cacheable && hit_end != NULL) {
+            size_t key_start = i > 0 ? nkey_end[i - 1] : 0;
+            result_cache_put(ctx->cache, nkeys + key_start, nkey_end[i] - key_start, resp->data + group_start,
+                             resp->len - group_start, epoch);
+        }
+        m++;
+    }
+
+    // --- 5. Limpieza ---
+    if (lookup_status == 0) index_results_free(results, nmiss);
+    if (miss_keys != keys) free((void *)miss_keys);
+    free(nkey_end);
+    free(nkeys);
+    free(hit_end);
+    response_free(&hits);
+    free(results);
+    free(keys);
+    free(titles_buf);
+    return status;
+}
+
+/**
+ * @brief Contadores del servidor: cache de respuestas y pool de paginas.
+ * Respuesta: [uint32_t len] seguido de len bytes de texto, una linea "nombre valor" por contador.
+ */
+static int handle_stats(handler_ctx_t *ctx, response_t *resp) {
+    char text[1024];
+    int len;
+    if (ctx->cache == NULL) {
+        len = snprintf(text, sizeof(text), "cache_enabled 0\n");
+    } else {
+        result_cache_stats_t st;
+        result_cache_stats(ctx->cache, &st);
+        len = snprintf(text, sizeof(text),
+                       "cache_enabled 1\ncache_hits %llu\ncache_misses %llu\ncache_inserts %llu\n"
+                       "cache_evictions %llu\ncache_invalidations %llu\ncache_entries %llu\n"
+                       "cache_bytes %llu\ncache_max_bytes %llu\n",
+                       (unsigned long long)st.hits, (unsigned long long)st.misses, (unsigned long long)st.inserts,
+                       (unsigned long long)st.evictions, (unsigned long long)st.invalidations,
+                       (unsigned long long)st.entries, (unsigned long long)st.bytes, (unsigned long long)st.max_bytes);
+    }
+    static const char *const pool_names[POOL_KINDS] = {"index", "records"};
+    for (int k = 0; k < POOL_KINDS && len >= 0 && (size_t)len < sizeof(text); k++) {
+        page_pool_stats_t st = {0};
+        if (ctx->index.pool != NULL) page_pool_stats(ctx->index.pool, k, &st);
+        const char *n = pool_names[k];
+        len += snprintf(text + len, sizeof(text) - (size_t)len,
+                        "pool_%s_hits %llu\npool_%s_misses %llu\npool_%s_evictions %llu\n"
+                        "pool_%s_invalidations %llu\npool_%s_pages %llu\npool_%s_max_pages %llu\n",
+                        n, (unsigned long long)st.hits, n, (unsigned long long)st.misses, n,
+                        (unsigned long long)st.evictions, n, (unsigned long long)st.invalidations, n,
+                        (unsigned long long)st.pages, n, (unsigned long long)st.max_pages);
+    }
+    if (len < 0 || (size_t)len >= sizeof(text)) return -1;
+    if (response_append_u32(resp, (uint32_t)len) != 0) return -1;
+    return response_append(resp, text, (size_t)len);
+}
+
+int handle_request(handler_ctx_t *ctx, proto_op_t op, const char *body, uint32_t body_len, response_t *resp) {
+    switch (op) {
+        case OP_LOOKUP:
+            return handle_lookup(ctx, body, body_len, resp);
+        case OP_ADD_BOOK:
+            return handle_add_book(ctx, body, body_len, resp);
+        case OP_MULTI_LOOKUP:
+            return handle_multi_lookup(ctx, body, body_len, resp);
+        case OP_STATS:
+            return handle_stats(ctx, resp);
+        default:
+            fprintf(stderr, "Operación desconocida\n");
+            return -1;
+    }
+}
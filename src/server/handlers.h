@@ -0,0 +1,53 @@
+#ifndef HANDLERS_H
+#define HANDLERS_H
+
+#include <stdint.h>
+#include "reader.h"
+#include "response.h"
+#include "protocol.h"
+#include "result_cache.h"
+#include "page_pool.h"
+#include "io_ring.h"
+
+// Rutas de los archivos del indice
+extern const char *BUCKETS_PATH;
+extern const char *linked_list_PATH;
+
+// Opciones del servidor que afectan a todos los hilos de I/O (se pasan como arg a handler_ctx_init)
+typedef struct {
+    int use_mmap; // Abrir el indice con index_open_mmap en lugar de index_open
+    result_cache_t *cache; // Cache de respuestas compartido por los hilos (NULL = sin cache)
+    page_pool_t *pool;     // Pool de paginas para las lecturas con pread (NULL = sin pool)
+    int use_io_uring;      // Leer los lotes de lineas del CSV y de buckets con io_uring (si el kernel lo tiene)
+} handler_config_t;
+
+/* Recursos propios de cada hilo de I/O: el handle del indice y el buffer de lectura no se comparten.
+ * csv_fd solo se usa con pread/sendfile (offset explicito) y sigue abierto mientras viva el pool,
+ * asi que el reactor puede enviar con sendfile los rangos del CSV que referencia una respuesta. */
+typedef struct {
+    int worker_id;
+    index_handle_t index;
+    int csv_fd;
+    char *line_buf;       // Lineas del CSV de un grupo de resultados, seguidas
+    pool_file_t csv_pf;   // Lecturas de csv_fd (por el pool de paginas si hay uno)
+    io_ring_t *ring;      // io_uring del hilo (NULL = un pread tras otro)
+    io_read_t *reads;     // Lecturas del grupo en curso (ver csv_read_records)
+    size_t reads_cap;
+    size_t line_buf_size;
+    result_cache_t *cache; // Compartido (ver handler_config_t)
+    char *key_buf;        // Llaves normalizadas para el cache
+    size_t key_buf_size;
+} handler_ctx_t;
+
+/* Abre el indice y el csv para un hilo del pool (firma de worker_ctx_init_fn).
+ * arg es un const handler_config_t * (o NULL para las opciones por defecto) */
+void *handler_ctx_init(int worker_id, void *arg);
+
+/* Cierra los recursos del hilo (firma de worker_ctx_free_fn) */
+void handler_ctx_free(void *ctx);
+
+/* Ejecuta una peticion completa (ya leida del socket) y escribe la respuesta en resp.
+ * body no esta terminado en '\0'. Retorna 0, o -1 si la conexion debe cerrarse */
+int handle_request(handler_ctx_t *ctx, proto_op_t op, const char *body, uint32_t body_len, response_t *resp);
+
+#endif // HANDLERS_H
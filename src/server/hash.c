@@ -6,23 +6,25 @@
 #include <stdlib.h>
 #include <string.h>
 
-/* FNV-1a 64-bit mixed with hashseed. */
-uint64_t hash_key_prefix(const char *key, size_t len, uint64_t seed) {
-    const uint64_t FNV_OFFSET = 14695981039346656037ULL;
-    const uint64_t FNV_PRIME = 1099511628211ULL;
+static const char *const hash_names[HASH_COUNT] = {"fnv-prefix", "fnv", "wyhash"};
 
-    char *norm = normalize_string(key ? key : "");
-    const unsigned char *data = NULL;
-    size_t max = 0;
+const char *hash_name(uint32_t hash) {
+    return hash < HASH_COUNT ? hash_names[hash] : "?";
+}
 
-    if (norm) {
-        data = (const unsigned char *)norm;
-        size_t nlen = strlen(norm);
-        max = (nlen < KEY_PREFIX_LEN) ? nlen : KEY_PREFIX_LEN;
-    } else {
-        data = (const unsigned char *)key;
-        max = (len < KEY_PREFIX_LEN) ? len : KEY_PREFIX_LEN;
+int hash_from_name(const char *name) {
+    for (int i = 0; i < HASH_COUNT; i++) {
+        if (strcmp(name, hash_names[i]) == 0) return i;
     }
+    return -1;
+}
+
+/* FNV-1a 64-bit mixed with hashseed, over the first max bytes. */
+static uint64_t fnv1a_mix(const char *nkey, size_t max, uint64_t seed) {
+    const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+    const uint64_t FNV_PRIME = 1099511628211ULL;
+
+    const unsigned char *data = (const unsigned char *)nkey;
 
     uint64_t h = FNV_OFFSET ^ seed;
     for (size_t i = 0; i < max; ++i) {
@@ -35,7 +37,98 @@ uint64_t hash_key_prefix(const char *key, size_t len, uint64_t seed) {
     h ^= h >> 33;
     h *= 0xc4ceb9fe1a85ec53ULL;
     h ^= h >> 33;
-
-    if (norm) free(norm);
     return h;
 }
+
+uint64_t hash_normalized_key(const char *nkey, size_t len, uint64_t seed) {
+    return fnv1a_mix(nkey, (len < KEY_PREFIX_LEN) ? len : KEY_PREFIX_LEN, seed);
+}
+
+uint64_t hash_fnv1a_key(const char *nkey, size_t len, uint64_t seed) {
+    return fnv1a_mix(nkey, len, seed);
+}
+
+/* ---- Estilo wyhash (final 4): lee 8 bytes por paso y mezcla con productos de 128 bits ---- */
+
+static const uint64_t wy_secret[4] = {0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL, 0x4b33a62ed433d4a3ULL,
+                                      0x4d5a2da51de1aa47ULL};
+
+// *a, *b = mitades baja y alta de *a * *b
+static inline void wy_mum(uint64_t *a, uint64_t *b) {
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t wy_mix(uint64_t a, uint64_t b) {
+    wy_mum(&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t wy_r8(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint64_t wy_r4(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+// 1 a 3 bytes: primero, del medio y ultimo
+static inline uint64_t wy_r3(const unsigned char *p, size_t k) {
+    return ((uint64_t)p[0] << 16) | ((uint64_t)p[k >> 1] << 8) | p[k - 1];
+}
+
+uint64_t hash_wyhash_key(const char *nkey, size_t len, uint64_t seed) {
+    const unsigned char *p = (const unsigned char *)nkey;
+    uint64_t a, b;
+    seed ^= wy_mix(seed ^ wy_secret[0], wy_secret[1]);
+    if (len <= 16) {
+        if (len >= 4) { // Dos lecturas de 4 bytes desde cada punta (se solapan si len < 8)
+            a = (wy_r4(p) << 32) | wy_r4(p + ((len >> 3) << 2));
+            b = (wy_r4(p + len - 4) << 32) | wy_r4(p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = wy_r3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (i > 48) { // Tres cadenas independientes de 16 bytes por vuelta
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = wy_mix(wy_r8(p) ^ wy_secret[1], wy_r8(p + 8) ^ seed);
+                see1 = wy_mix(wy_r8(p + 16) ^ wy_secret[2], wy_r8(p + 24) ^ see1);
+                see2 = wy_mix(wy_r8(p + 32) ^ wy_secret[3], wy_r8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = wy_mix(wy_r8(p) ^ wy_secret[1], wy_r8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = wy_r8(p + i - 16); // Los ultimos 16 bytes (se solapan con la vuelta anterior)
+        b = wy_r8(p + i - 8);
+    }
+    a ^= wy_secret[1];
+    b ^= seed;
+    wy_mum(&a, &b);
+    return wy_mix(a ^ wy_secret[0] ^ len, b ^ wy_secret[1]);
+}
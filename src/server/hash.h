@@ -5,8 +5,38 @@
 #include <stddef.h>
 
 
-/* Compute 64-bit hash based on first up to HASH_KEY_PREFIX_LEN bytes */
-uint64_t hash_key_prefix(const char *key, size_t len, uint64_t seed);
+/* Hash de HASH_FNV1A_PREFIX: FNV-1a de los primeros KEY_PREFIX_LEN bytes de una llave ya
+ * normalizada (ver normalize_into) */
+uint64_t hash_normalized_key(const char *nkey, size_t len, uint64_t seed);
+
+/* Funcion de hash de las llaves: se elige en --build con --hash y queda en el encabezado del
+ * indice (buckets_header_t.hash). Con HASH_FNV1A_PREFIX (la de siempre) una consulta de
+ * KEY_PREFIX_LEN caracteres o mas encuentra los titulos que empiezan con ella, pero todos los
+ * titulos con el mismo prefijo ("harry potter and the ...") caen en el mismo bucket. Las otras
+ * hashean la llave completa: no hay esas colisiones y la busqueda es exacta */
+#define HASH_FNV1A_PREFIX 0 // FNV-1a byte a byte sobre los primeros KEY_PREFIX_LEN bytes
+#define HASH_FNV1A 1        // FNV-1a byte a byte sobre la llave completa
+#define HASH_WYHASH 2       // Estilo wyhash: 8 bytes por paso con multiplicaciones de 64x64 -> 128 bits
+#define HASH_COUNT 3
+
+// Nombre para --hash ("fnv-prefix", "fnv", "wyhash") y el inverso (-1 si no existe)
+const char *hash_name(uint32_t hash);
+int hash_from_name(const char *name);
+
+uint64_t hash_fnv1a_key(const char *nkey, size_t len, uint64_t seed);
+uint64_t hash_wyhash_key(const char *nkey, size_t len, uint64_t seed);
+
+// Hash de una llave normalizada con la funcion hash (HASH_*)
+static inline uint64_t hash_key_with(uint32_t hash, const char *nkey, size_t len, uint64_t seed) {
+    if (hash == HASH_WYHASH) return hash_wyhash_key(nkey, len, seed);
+    if (hash == HASH_FNV1A) return hash_fnv1a_key(nkey, len, seed);
+    return hash_normalized_key(nkey, len, seed);
+}
+
+// 1 si la funcion solo cubre los primeros KEY_PREFIX_LEN bytes (busqueda por prefijo)
+static inline int hash_is_prefix(uint32_t hash) {
+    return hash == HASH_FNV1A_PREFIX;
+}
 
 /* Given hash and mask (num_buckets is power of two) */
 static inline uint64_t bucket_id_from_hash(uint64_t h, uint64_t mask) {
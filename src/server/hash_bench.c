@@ -0,0 +1,174 @@
+#include "hash_bench.h"
+#include "hash.h"
+#include "buckets.h"
+#include "arena.h"
+#include "csv_scan.h"
+#include "common.h"
+#include "util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_KEY_ARENA_BLOCK (1u << 20)
+#define BENCH_MIN_SECONDS 0.2 // Cada funcion se repite sobre todas las llaves hasta medir al menos esto
+#define BENCH_CHAIN_CLASSES 8
+
+typedef struct {
+    const char *key;
+    size_t len;
+} bench_key_t;
+
+static int bench_key_cmp(const void *a, const void *b) {
+    const bench_key_t *x = a, *y = b;
+    size_t n = x->len < y->len ? x->len : y->len;
+    int c = memcmp(x->key, y->key, n);
+    if (c != 0) return c;
+    return (x->len > y->len) - (x->len < y->len);
+}
+
+static int u64_cmp(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double seconds_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Clase del histograma para una cadena de len llaves: 0, 1, 2, 3, 4, 5-8, 9-16, 17+
+static int chain_class(uint32_t len) {
+    if (len <= 4) return (int)len;
+    if (len <= 8) return 5;
+    if (len <= 16) return 6;
+    return 7;
+}
+
+/* Lee los titulos del csv, normalizados, y deja las llaves distintas en *out (las llaves viven en
+ * keys). Retorna el numero de llaves distintas, o -1 si falla */
+static long load_keys(const char *csv_path, arena_t *keys, bench_key_t **out, size_t *records, size_t *rows) {
+    csv_map_t csv;
+    if (csv_map_open(csv_path, &csv) != 0) {
+        fprintf(stderr, "open csv failed\n");
+        return -1;
+    }
+    size_t cap = 4096, n = 0;
+    bench_key_t *arr = malloc(cap * sizeof(bench_key_t));
+    if (arr == NULL) {
+        perror("malloc");
+        csv_map_close(&csv);
+        return -1;
+    }
+    *records = 0;
+    size_t pos = csv.size > 0 ? csv_scan_record(csv.data, csv.size, 0, 0, NULL, NULL) : 0; // Descarta el encabezado
+    while (pos < csv.size) {
+        csv_field_t title;
+        int found;
+        pos = csv_scan_record(csv.data, csv.size, pos, TITLE_FIELD, &title, &found);
+        (*records)++;
+        if (!found) continue;
+        char *key = arena_alloc(keys, title.len + 1);
+        if (n == cap) {
+            bench_key_t *tmp = realloc(arr, cap * 2 * sizeof(bench_key_t));
+            if (tmp == NULL) {
+                key = NULL;
+            } else {
+                arr = tmp;
+                cap *= 2;
+            }
+        }
+        if (key == NULL) {
+            fprintf(stderr, "Error: sin memoria para las llaves\n");
+            free(arr);
+            csv_map_close(&csv);
+            return -1;
+        }
+        arr[n].key = key;
+        arr[n].len = normalize_into(title.ptr, title.len, key);
+        n++;
+    }
+    csv_map_close(&csv);
+    *rows = n;
+
+    // El indice guarda un nodo por llave distinta: las cadenas se miden sobre esas
+    qsort(arr, n, sizeof(bench_key_t), bench_key_cmp);
+    size_t distinct = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (distinct == 0 || bench_key_cmp(&arr[distinct - 1], &arr[i]) != 0) arr[distinct++] = arr[i];
+    }
+    *out = arr;
+    return (long)distinct;
+}
+
+// Mide y muestra una funcion de hash sobre las n llaves, con level_size buckets
+static int bench_one(uint32_t hash, const bench_key_t *keys, size_t n, uint64_t level_size) {
+    uint64_t *hashes = malloc(n * sizeof(uint64_t));
+    uint32_t *chains = calloc(level_size, sizeof(uint32_t));
+    if (hashes == NULL || chains == NULL) {
+        perror("malloc");
+        free(hashes);
+        free(chains);
+        return -1;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    size_t passes = 0;
+    double secs;
+    do {
+        for (size_t i = 0; i < n; i++) hashes[i] = hash_key_with(hash, keys[i].key, keys[i].len, DEFAULT_HASH_SEED);
+        passes++;
+        secs = seconds_since(&start);
+    } while (secs < BENCH_MIN_SECONDS);
+
+    for (size_t i = 0; i < n; i++) chains[bucket_id_from_hash(hashes[i], level_size - 1)]++;
+    uint64_t classes[BENCH_CHAIN_CLASSES] = {0};
+    uint32_t max_chain = 0;
+    double probe = 0; // Nodos por bucket que ve en promedio una busqueda de una llave presente
+    for (uint64_t b = 0; b < level_size; b++) {
+        classes[chain_class(chains[b])]++;
+        if (chains[b] > max_chain) max_chain = chains[b];
+        probe += (double)chains[b] * chains[b];
+    }
+
+    // Llaves distintas con un hash identico al de otra: el hash no puede separarlas
+    qsort(hashes, n, sizeof(uint64_t), u64_cmp);
+    size_t same_hash = 0;
+    for (size_t i = 0; i < n; i++) {
+        if ((i > 0 && hashes[i] == hashes[i - 1]) || (i + 1 < n && hashes[i] == hashes[i + 1])) same_hash++;
+    }
+
+    printf("%-11s %8.1f %10.2f %9u %10zu", hash_name(hash), secs * 1e9 / ((double)passes * (double)n),
+           n ? probe / (double)n : 0.0, max_chain, same_hash);
+    for (int c = 0; c < BENCH_CHAIN_CLASSES; c++) printf(" %8llu", (unsigned long long)classes[c]);
+    printf("\n");
+    free(hashes);
+    free(chains);
+    return 0;
+}
+
+int hash_bench(const char *csv_path) {
+    arena_t keys;
+    arena_init(&keys, BENCH_KEY_ARENA_BLOCK);
+    bench_key_t *arr = NULL;
+    size_t records = 0, rows = 0;
+    long n = load_keys(csv_path, &keys, &arr, &records, &rows);
+    if (n < 0) {
+        arena_free(&keys);
+        return -1;
+    }
+    buckets_header_t hdr; // Mismo numero de buckets que --build para este csv
+    buckets_header_init(&hdr, records);
+    printf("%zu filas, %ld llaves distintas, %llu buckets\n", rows, n, (unsigned long long)hdr.level_size);
+    printf("%-11s %8s %10s %9s %10s %8s %8s %8s %8s %8s %8s %8s %8s\n", "hash", "ns/llave", "nodos/busq",
+           "cad.max", "hash igual", "vacios", "1", "2", "3", "4", "5-8", "9-16", "17+");
+    int status = 0;
+    for (uint32_t h = 0; h < HASH_COUNT && status == 0; h++) {
+        status = bench_one(h, arr, (size_t)n, hdr.level_size);
+    }
+    free(arr);
+    arena_free(&keys);
+    return status;
+}
@@ -0,0 +1,10 @@
+#ifndef HASH_BENCH_H
+#define HASH_BENCH_H
+
+/* Compara las funciones de hash de las llaves (HASH_*, ver hash.h) sobre los titulos del csv
+ * (--hash-bench): para cada una informa ns por llave y la distribucion del largo de las cadenas
+ * (llaves distintas por bucket) con el numero de buckets que elegiria --build. No toca el indice.
+ * Retorna 0, o -1 si falla */
+int hash_bench(const char *csv_path);
+
+#endif // HASH_BENCH_H
@@ -3,230 +3,153 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <signal.h>
 #include <sys/socket.h>
+#include <sys/resource.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
-#include "reader.h" // Nuestro motor de búsqueda
 #include "common.h" // Para las rutas y safe_pread/pwrite
-#include "builder.h" // Para agregar nuevos libros al índice
+#include "builder.h" // Para construir el índice con --build
+#include "compact.h" // Para compactar el índice con --compact
+#include "external_build.h" // Para construir el índice con --build --external
+#include "hash.h" // Para elegir la funcion de hash con --build --hash
+#include "hash_bench.h" // Para comparar las funciones de hash con --hash-bench
+#include "handlers.h" // Para las rutas del índice
+#include "reactor.h" // Bucle de eventos que atiende las conexiones
 
 #define SERVER_PORT 8080
-#define LISTEN_BACKLOG 10
+#define LISTEN_BACKLOG 4096
 
-// Definición de las rutas (ajusta si es necesario)
-const char *BUCKETS_PATH = "data/index/title_buckets.dat";
-const char *linked_list_PATH = "data/index/title_linked_list.dat";
-
-/**
- * @brief Maneja una única conexión de cliente.
- * * Lee una petición (protocolo: [uint32_t len][char* query]),
- * busca en el índice y envía una respuesta 
- * (protocolo: [int32_t count][off_t* results]).
- * * @param h Handle del índice (fd's de buckets y linked_list)
- * @param client_fd File descriptor del socket del cliente
- */
-
-static void handle_add_book(int client_fd) {
-    uint32_t line_len;
-
-    // Leer del socket la longitud de la línea CSV
-    if (read(client_fd, &line_len, sizeof(line_len)) != sizeof(line_len)) {
-        perror("read (line_len)");
-        close(client_fd);
-        return;
-    }
-                  
-    // Reservar memoria para la línea completa
-    char *line_buf = malloc(line_len + 1);
-    if (!line_buf) {
-        perror("malloc");
-        close(client_fd);  
-        return;
-    }
-
-    //Leer la linea CSV completa desde el socket
-    if (read(client_fd, line_buf, line_len) != (ssize_t)line_len) {
-        perror("read (csv_line)");
-        free(line_buf);
-        close(client_fd);
-        return;
-    }
-    line_buf[line_len] = '\0'; 
-
-    printf("Recibido nuevo libro:\n%s\n", line_buf);
-
-    // Guardar la linea en el CSV e indexar y confirmar exito
-    if (build_index_line(CSV_PATH, line_buf) == 0) {
-        printf("Libro indexado correctamente.\n");
-        uint32_t ok = 1;
-        write(client_fd, &ok, sizeof(ok));
-    } else {
-        fprintf(stderr, "Error al agregar libro.\n");
-        uint32_t fail = 0;
-        write(client_fd, &fail, sizeof(fail));
-    }
-
-    free(line_buf);
-    close(client_fd);
+static int default_num_workers(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
 }
 
-static void handle_lookup(index_handle_t *h, FILE *csv_fp, int client_fd) {
-    printf("Cliente conectado. Esperando consulta...\n");
-
-    // --- 1. Leer Petición del Cliente ---
-    
-    // Leer la longitud de la consulta (4 bytes)
-    uint32_t query_len;
-    ssize_t r = read(client_fd, &query_len, sizeof(query_len));
-    if (r != sizeof(query_len)) {
-        fprintf(stderr, "Error al leer la longitud de la consulta.\n");
-        close(client_fd);
-        return;
-    }
-    
-    // query_len = ntohl(query_len); // Opcional: manejar endianness si cliente/servidor difieren
-
-    // Reservar memoria y leer la consulta
-    char *query_buf = malloc(query_len + 1);
-    if (!query_buf) {
-        perror("malloc");
-        close(client_fd);
-        return;
-    }
-
-    r = read(client_fd, query_buf, query_len);
-    if (r != query_len) {
-        fprintf(stderr, "Error al leer la consulta.\n");
-        free(query_buf);
-        close(client_fd);
-        return;
-    }
-    query_buf[query_len] = '\0'; // Asegurar NUL-terminator para index_lookup
-
-    // --- 2. Procesar la Consulta ---
-    
-    off_t *offsets = NULL;
-    uint32_t count = 0;
-    int lookup_status = index_lookup(h, query_buf, &offsets, &count);
-
-    int32_t response_count;
-    if (lookup_status != 0) {
-        response_count = -1; // Código de error
-        count = 0; // No enviaremos datos
-        fprintf(stderr, "Error durante index_lookup.\n");
-    } else {
-        response_count = (int32_t)count;
-        printf("Consulta '%s' procesada. Resultados: %u\n", query_buf, count);
-    }
-
-    // --- 3. Enviar Respuesta al Cliente ---
-
-    // Enviar el número de resultados (o código de error)
-
-    ssize_t w = write(client_fd, &response_count, sizeof(response_count));
-    if (w != sizeof(response_count)) {
-        fprintf(stderr, "Error al escribir el conteo de respuesta.\n");
-        free(query_buf);
-        if (offsets) free(offsets);
-        close(client_fd);
-        return;
+// Sube el limite de descriptores abiertos al maximo permitido (una conexion = un fd)
+static void raise_fd_limit(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &rl) != 0) perror("setrlimit (RLIMIT_NOFILE)");
     }
+}
 
-    // Si encontramos resultados, los leemos del CSV y los enviamos
-    if (count > 0) {
-        char *line_buf = NULL; // Buffer para getline
-        size_t line_buf_size = 0;
-        ssize_t line_len;
-
-        for (uint32_t i = 0; i < count; i++) {
-            // Buscamos el offset en el CSV
-            if (fseek(csv_fp, offsets[i], SEEK_SET) != 0) {
-                perror("fseek");
-                continue; // Saltar este resultado
+int main(int argc, char *argv[]) {
+    int num_workers = default_num_workers();
+    int threads_given = 0;
+    int external = 0;
+    int incremental = 0;
+    int slots_engine = 0;
+    int static_index = 0;
+    uint32_t key_hash = HASH_FNV1A_PREFIX;
+    size_t memory_budget = EXTERNAL_BUILD_DEFAULT_BUDGET;
+    long cache_mb = RESULT_CACHE_DEFAULT_MB;
+    long pool_index_mb = 0; // Pool de paginas (0 = esa clase se lee con pread normal)
+    long pool_records_mb = 0;
+    handler_config_t cfg = {.use_mmap = 0};
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) { // Numero de hilos de I/O (o de construccion con --build)
+            num_workers = atoi(argv[++i]);
+            threads_given = 1;
+            if (num_workers <= 0) {
+                fprintf(stderr, "Error: --threads debe ser mayor que 0\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--mmap") == 0) { // Lee el indice desde memoria mapeada
+            cfg.use_mmap = 1;
+        } else if (strcmp(argv[i], "--io-uring") == 0) { // Lotes de lecturas con io_uring
+            cfg.use_io_uring = 1;
+        } else if (strcmp(argv[i], "--external") == 0) { // --build con ordenamiento externo
+            external = 1;
+        } else if (strcmp(argv[i], "--incremental") == 0) { // --build solo de lo agregado al csv
+            incremental = 1;
+        } else if (strcmp(argv[i], "--static") == 0) { // --build de un indice de solo lectura
+            static_index = 1;
+        } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) { // Motor del indice de --build
+            const char *engine = argv[++i];
+            if (strcmp(engine, "slots") == 0) {
+                slots_engine = 1;
+            } else if (strcmp(engine, "chain") != 0) {
+                fprintf(stderr, "Error: --engine debe ser chain o slots\n");
+                return 1;
             }
-            
-            // Leemos la línea completa
-            line_len = getline(&line_buf, &line_buf_size, csv_fp);
-            if (line_len == -1) {
-                perror("getline");
-                continue; // Saltar este resultado
+        } else if (strcmp(argv[i], "--hash") == 0 && i + 1 < argc) { // Funcion de hash de las llaves de --build
+            int hash = hash_from_name(argv[++i]);
+            if (hash < 0) {
+                fprintf(stderr, "Error: --hash debe ser fnv-prefix, fnv o wyhash\n");
+                return 1;
             }
-            
-            // Enviamos la longitud de la línea
-            uint32_t net_line_len = (uint32_t)line_len;
-            if (write(client_fd, &net_line_len, sizeof(net_line_len)) != sizeof(net_line_len)) {
-                fprintf(stderr, "Error al escribir longitud de línea\n");
-                break; // Salir del bucle for
+            key_hash = (uint32_t)hash;
+        } else if (strcmp(argv[i], "--memory") == 0 && i + 1 < argc) { // Presupuesto (MiB) de --external
+            long mb = atol(argv[++i]);
+            if (mb < (long)(EXTERNAL_BUILD_MIN_BUDGET >> 20)) {
+                fprintf(stderr, "Error: --memory debe ser al menos %zu (MiB)\n", EXTERNAL_BUILD_MIN_BUDGET >> 20);
+                return 1;
             }
-            
-            // Enviamos la línea
-            if (write(client_fd, line_buf, net_line_len) != (ssize_t)net_line_len) {
-                fprintf(stderr, "Error al escribir datos de línea\n");
-                break; // Salir del bucle for
+            memory_budget = (size_t)mb << 20;
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) { // Memoria (MiB) del cache de respuestas
+            cache_mb = atol(argv[++i]);
+            if (cache_mb < 0) {
+                fprintf(stderr, "Error: --cache debe ser 0 (sin cache) o mayor\n");
+                return 1;
+            }
+        } else if ((strcmp(argv[i], "--pool-index") == 0 || strcmp(argv[i], "--pool-records") == 0) && i + 1 < argc) {
+            // MiB del pool de paginas O_DIRECT para el indice o para los registros del csv
+            long *mb = strcmp(argv[i], "--pool-index") == 0 ? &pool_index_mb : &pool_records_mb;
+            *mb = atol(argv[++i]);
+            if (*mb < 0) {
+                fprintf(stderr, "Error: %s debe ser 0 (sin pool) o mayor\n", argv[i - 1]);
+                return 1;
             }
         }
-        free(line_buf); // Liberar el buffer de getline
-    }
-
-    // --- 4. Limpieza ---
-    free(query_buf);
-    if (offsets) {
-        free(offsets); // index_lookup alocó esto, lo liberamos aquí.
     }
-    close(client_fd);
-    printf("Cliente desconectado.\n");
-}
-
-static void handle_client(index_handle_t *h, FILE *csv_fp, int client_fd) {
-    uint32_t op_len;
-    read(client_fd, &op_len, sizeof(op_len));
-
-    char op_buf[64];
-    read(client_fd, op_buf, op_len);
-    op_buf[op_len] = '\0';
-
-    if (strcmp(op_buf, "OP_LOOKUP") == 0) {
-        handle_lookup(h, csv_fp, client_fd);
-    } else if (strcmp(op_buf, "OP_ADD_BOOK") == 0) {
-        handle_add_book(client_fd);
-    } else {
-        fprintf(stderr, "Operación desconocida: %s\n", op_buf);
-    }
-
-    close(client_fd);
-}
-
-int main(int argc, char *argv[]) {
     for (int i = 1; i < argc; ++i) { // Si se pasa --build como argumento, construye los indices
         if (strcmp(argv[i], "--build") == 0) {
-            build_index_stream(CSV_PATH);
-            return 0;
+            // Con --incremental se indexa solo la cola nueva del csv; si no se puede, se sigue con una completa
+            if (incremental) {
+                int updated = build_index_incremental(CSV_PATH);
+                if (updated != BUILD_INCREMENTAL_FULL) return updated == 0 ? 0 : 1;
+            }
+            // Con --engine slots el indice es una tabla de direccionamiento abierto (ver slots.h)
+            // Con --static es un hash perfecto minimo de solo lectura (ver static_index.h)
+            if (slots_engine || static_index) {
+                if (external) {
+                    fprintf(stderr, "Error: --external solo construye el motor chain\n");
+                    return 1;
+                }
+                if (slots_engine && static_index) {
+                    fprintf(stderr, "Error: --static no se combina con --engine slots\n");
+                    return 1;
+                }
+                int nthreads = threads_given ? num_workers : 1;
+                int built = static_index ? build_index_static(CSV_PATH, nthreads, key_hash)
+                                         : build_index_slots(CSV_PATH, nthreads, key_hash);
+                return built == 0 ? 0 : 1;
+            }
+            // Con --threads N el csv se procesa en N rangos en paralelo (mismo resultado)
+            // Con --external las tuplas se ordenan en runs en disco con un presupuesto de memoria
+            // Con --hash fnv o wyhash se hashea la llave completa (busqueda exacta, ver hash.h)
+            int built = external ? build_index_external(CSV_PATH, memory_budget, key_hash)
+                      : threads_given ? build_index_parallel(CSV_PATH, num_workers, key_hash)
+                                      : build_index_stream(CSV_PATH, key_hash);
+            return built == 0 ? 0 : 1;
+        }
+        if (strcmp(argv[i], "--hash-bench") == 0) { // Compara las funciones de hash sobre el csv
+            return hash_bench(CSV_PATH) == 0 ? 0 : 1;
+        }
+        if (strcmp(argv[i], "--compact") == 0) { // Reagrupa los nodos agregados con OP_ADD_BOOK
+            return index_compact(BUCKETS_PATH, linked_list_PATH) == 0 ? 0 : 1;
         }
     }
 
-    // --- Abrir el Índice ---
-    index_handle_t index_h;
-    if (index_open(&index_h, BUCKETS_PATH, linked_list_PATH) != 0) {
-        fprintf(stderr, "Error: No se pudo abrir el índice. Para construir el indice use --build\n");
-        return 1;
-    }
-    printf("Índice cargado (FDs: b=%d, a=%d)\n", index_h.buckets_fd, index_h.linked_list_fd);
-
-    FILE *csv_fp = fopen(CSV_PATH, "r"); // Dataset
-    if (csv_fp == NULL) {
-        perror("fopen (CSV_PATH)");
-        fprintf(stderr, "Error: No se pudo abrir el archivo CSV: %s\n", CSV_PATH);
-        index_close(&index_h);
-        return 1;
-    }
-    printf("Archivo CSV '%s' abierto para lectura.\n", CSV_PATH);
+    signal(SIGPIPE, SIG_IGN); // Un cliente que se desconecta no debe terminar el servidor
+    raise_fd_limit();
 
     // --- Configurar el Socket ---
-    int server_fd, client_fd;
-    struct sockaddr_in server_addr, client_addr; // Direcciones del servidor y cliente
-    socklen_t client_len = sizeof(client_addr);
+    int server_fd;
+    struct sockaddr_in server_addr; // Dirección del servidor
 
-    server_fd = socket(AF_INET, SOCK_STREAM, 0); // Socket del server
+    server_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0); // Socket del server
     if (server_fd < 0) {
         perror("socket");
         return 1;
@@ -257,27 +180,55 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    printf("Servidor escuchando en el puerto %d...\n", SERVER_PORT);
+    // --- Cache de respuestas (compartido por los hilos de I/O) ---
+    if (cache_mb > 0) {
+        cfg.cache = result_cache_create((size_t)cache_mb << 20);
+        if (cfg.cache == NULL) {
+            close(server_fd);
+            return 1;
+        }
+    }
 
-    // --- 4. Bucle de Aceptación ---
-    while (1) {
-        client_fd = accept(server_fd, (struct sockaddr *)&client_addr, &client_len);
-        if (client_fd < 0) {
-            perror("accept");
-            continue; // Seguir intentando
+    // --- Pool de paginas (compartido por los hilos de I/O) ---
+    if (pool_index_mb > 0 || pool_records_mb > 0) {
+        if (cfg.use_mmap) {
+            fprintf(stderr, "Error: --pool-index y --pool-records no se combinan con --mmap\n");
+            result_cache_destroy(cfg.cache);
+            close(server_fd);
+            return 1;
+        }
+        cfg.pool = page_pool_create((size_t)pool_index_mb << 20, (size_t)pool_records_mb << 20);
+        if (cfg.pool == NULL) {
+            result_cache_destroy(cfg.cache);
+            close(server_fd);
+            return 1;
         }
+    }
 
-        // Manejar al cliente. 
-        // (Nota: Esto es iterativo. Para múltiples clientes simultáneos
-        // se necesitarían hilos, forks o I/O no bloqueante, 
-        // pero mantengámoslo simple por ahora).
-        handle_client(&index_h, csv_fp, client_fd);
+    // --- Abrir el Índice y el CSV (uno por hilo de I/O) ---
+    reactor_t *reactor = reactor_create(server_fd, num_workers, &cfg);
+    if (reactor == NULL) {
+        page_pool_destroy(cfg.pool);
+        result_cache_destroy(cfg.cache);
+        close(server_fd);
+        return 1;
+    }
+    printf("Índice%s y archivo CSV '%s' abiertos en %d hilos de I/O.\n",
+           cfg.use_mmap ? " (mmap)" : "", CSV_PATH, num_workers);
+    if (cfg.cache != NULL) printf("Cache de respuestas de %ld MiB.\n", cache_mb);
+    if (cfg.pool != NULL) {
+        printf("Pool de paginas O_DIRECT: %ld MiB para el indice y %ld MiB para los registros.\n", pool_index_mb,
+               pool_records_mb);
     }
+    printf("Servidor escuchando en el puerto %d...\n", SERVER_PORT);
+
+    // --- Bucle de eventos (solo retorna por un error fatal) ---
+    int status = reactor_run(reactor);
 
-    // --- 5. Cierre (nunca se alcanza en este bucle) ---
     printf("Cerrando servidor...\n");
+    reactor_destroy(reactor);
+    page_pool_destroy(cfg.pool);
+    result_cache_destroy(cfg.cache);
     close(server_fd);
-    fclose(csv_fp);
-    index_close(&index_h);
-    return 0;
-}
\ No newline at end of file
+    return status == 0 ? 0 : 1;
+}
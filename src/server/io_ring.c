@@ -0,0 +1,190 @@
+#define _GNU_SOURCE
+#include "io_ring.h"
+#include "common.h"
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+struct io_ring {
+    int fd;
+    int broken;               // El anillo fallo: el resto de las lecturas van con pread
+    unsigned sq_entries;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr;             // Mapeos de las colas (sq_ptr == cq_ptr con IORING_FEAT_SINGLE_MMAP)
+    size_t sq_len;
+    void *cq_ptr;
+    size_t cq_len;
+    size_t sqes_len;
+};
+
+static int unavailable_warned;
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static void ring_unavailable(const char *what) {
+    if (__atomic_exchange_n(&unavailable_warned, 1, __ATOMIC_ACQ_REL) == 0) {
+        fprintf(stderr, "Aviso: io_uring no disponible (%s: %s); las lecturas usan pread\n", what, strerror(errno));
+    }
+}
+
+io_ring_t *io_ring_create(unsigned entries) {
+    io_ring_t *r = calloc(1, sizeof(*r));
+    if (r == NULL) {
+        perror("calloc (io_uring)");
+        return NULL;
+    }
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    r->fd = sys_io_uring_setup(entries, &p);
+    if (r->fd < 0) {
+        ring_unavailable("io_uring_setup");
+        free(r);
+        return NULL;
+    }
+    r->sq_entries = p.sq_entries;
+    r->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) { // Las dos colas en un solo mapeo
+        if (r->cq_len > r->sq_len) r->sq_len = r->cq_len;
+        r->cq_len = r->sq_len;
+    }
+    r->sq_ptr = mmap(NULL, r->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ptr == MAP_FAILED) {
+        r->sq_ptr = NULL;
+        ring_unavailable("mmap");
+        io_ring_destroy(r);
+        return NULL;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ptr = r->sq_ptr;
+    } else {
+        r->cq_ptr = mmap(NULL, r->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_ptr == MAP_FAILED) {
+            r->cq_ptr = NULL;
+            ring_unavailable("mmap");
+            io_ring_destroy(r);
+            return NULL;
+        }
+    }
+    r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        r->sqes = NULL;
+        ring_unavailable("mmap");
+        io_ring_destroy(r);
+        return NULL;
+    }
+    unsigned char *sq = r->sq_ptr, *cq = r->cq_ptr;
+    r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return r;
+}
+
+void io_ring_destroy(io_ring_t *r) {
+    if (r == NULL) return;
+    if (r->sqes != NULL) munmap(r->sqes, r->sqes_len);
+    if (r->cq_ptr != NULL && r->cq_ptr != r->sq_ptr) munmap(r->cq_ptr, r->cq_len);
+    if (r->sq_ptr != NULL) munmap(r->sq_ptr, r->sq_len);
+    close(r->fd);
+    free(r);
+}
+
+// Lectura con pread (sin anillo, o para completar una lectura corta)
+static void read_sync(io_read_t *req, size_t done) {
+    ssize_t got = safe_pread(req->fd, (char *)req->buf + done, req->len - done, req->offset + (off_t)done);
+    req->result = got < 0 ? -1 : (ssize_t)done + got;
+}
+
+/* Envia n (<= sq_entries) lecturas y espera todas. Retorna cuantas quedaron en vuelo y
+ * terminaron; las demas (si io_uring_enter falla) las hace el llamador */
+static size_t ring_submit_wait(io_ring_t *r, io_read_t *reqs, size_t n) {
+    unsigned tail = *r->sq_tail; // Solo este hilo escribe la cola de envio
+    unsigned mask = *r->sq_mask;
+    for (size_t i = 0; i < n; i++) {
+        unsigned idx = tail & mask;
+        struct io_uring_sqe *sqe = &r->sqes[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = reqs[i].fd;
+        sqe->addr = (uint64_t)(uintptr_t)reqs[i].buf;
+        sqe->len = reqs[i].len;
+        sqe->off = (uint64_t)reqs[i].offset;
+        sqe->user_data = i;
+        r->sq_array[idx] = idx;
+        tail++;
+    }
+    __atomic_store_n(r->sq_tail, tail, __ATOMIC_RELEASE);
+
+    size_t submitted = 0, completed = 0;
+    while (submitted < n) {
+        int ret = sys_io_uring_enter(r->fd, (unsigned)(n - submitted), (unsigned)(n - submitted), IORING_ENTER_GETEVENTS);
+        if (ret < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY)) continue;
+        if (ret <= 0) { // Las que no entraron quedan en la cola: el anillo ya no se vuelve a usar
+            r->broken = 1;
+            break;
+        }
+        submitted += (size_t)ret;
+    }
+    while (completed < submitted) {
+        unsigned head = *r->cq_head;
+        unsigned cq_tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+        if (head == cq_tail) { // Esperar las que faltan (sin enviar nada nuevo)
+            int ret = sys_io_uring_enter(r->fd, 0, (unsigned)(submitted - completed), IORING_ENTER_GETEVENTS);
+            if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                // No se puede abandonar lecturas en vuelo sobre buffers del llamador: se sigue esperando
+                r->broken = 1;
+                sched_yield();
+            }
+            continue;
+        }
+        for (; head != cq_tail; head++) {
+            struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+            io_read_t *req = &reqs[cqe->user_data];
+            if (cqe->res < 0) {
+                errno = -cqe->res;
+                req->result = -1;
+            } else if ((uint32_t)cqe->res < req->len && cqe->res > 0) {
+                read_sync(req, (size_t)cqe->res); // Lectura corta: el resto (o el fin del archivo) con pread
+            } else {
+                req->result = cqe->res;
+            }
+            completed++;
+        }
+        __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+    }
+    // Como el kernel toma las lecturas en orden, las que no se enviaron son las ultimas
+    return submitted;
+}
+
+void io_read_batch(io_ring_t *r, io_read_t *reqs, size_t n) {
+    size_t i = 0;
+    while (r != NULL && !r->broken && i < n) {
+        size_t chunk = n - i < r->sq_entries ? n - i : r->sq_entries;
+        i += ring_submit_wait(r, reqs + i, chunk);
+    }
+    for (; i < n; i++) read_sync(&reqs[i], 0);
+}
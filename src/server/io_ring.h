@@ -0,0 +1,36 @@
+#ifndef IO_RING_H
+#define IO_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/* Lecturas en lote con io_uring (--io-uring), sin liburing: el anillo se arma con las syscalls
+ * io_uring_setup/io_uring_enter y los mmap de sus colas. Un lote de lecturas independientes (las
+ * lineas del csv de un resultado, las entradas de los buckets de un OP_MULTI_LOOKUP) se envia
+ * con una sola syscall y todas quedan en vuelo a la vez, en lugar de un pread bloqueante detras
+ * de otro. Si el kernel no tiene io_uring (o esta desactivado), io_ring_create retorna NULL y
+ * io_read_batch hace las mismas lecturas con pread. Un anillo por hilo: no se comparte */
+#define IO_RING_ENTRIES 64 // Lecturas en vuelo por envio (los lotes mas grandes se envian por partes)
+
+typedef struct io_ring io_ring_t;
+
+// Una lectura del lote
+typedef struct {
+    int fd;
+    void *buf;
+    uint32_t len;
+    off_t offset;
+    ssize_t result; // Salida: bytes leidos (menos de len solo al final del archivo) o -1
+} io_read_t;
+
+/* Anillo de entries lecturas. Retorna NULL si io_uring no esta disponible (avisa una vez) */
+io_ring_t *io_ring_create(unsigned entries);
+
+void io_ring_destroy(io_ring_t *r);
+
+/* Hace las n lecturas de reqs y deja el resultado de cada una en reqs[i].result. Con r las envia
+ * todas juntas; con r NULL (o si el anillo falla) usa safe_pread, una tras otra */
+void io_read_batch(io_ring_t *r, io_read_t *reqs, size_t n);
+
+#endif // IO_RING_H
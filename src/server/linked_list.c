@@ -1,5 +1,6 @@
 #include "linked_list.h"
 #include "common.h"
+#include "page_pool.h"
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -8,8 +9,8 @@
 #include <sys/stat.h>
 #include <errno.h>
 
-// Crea el archivo de nodos (Reserva el primer byte para representar null)
-int linked_list_nodes_create(const char *path) {
+// Crea el archivo de nodos (El encabezado ocupa el offset 0, que representa null)
+int linked_list_nodes_create(const char *path, uint64_t nodes_gen) {
     int fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0644);
     /* O_CREAT: Crea el archivo si no existe
      * O_TRUNC: Si existe el archivo, elimina sus contenidos
@@ -19,9 +20,12 @@ int linked_list_nodes_create(const char *path) {
         printf("open %s fallo al crear archivo de nodos %s\n", path, strerror(errno));
         return -1;
     }
-    // Escribir un byte nulo al inicio para poder representar NULL como el offset 0 en la lista enlazada
-    char null_byte = 0;
-    if (write(fd, &null_byte, 1) != 1) {
+    // Ningun nodo empieza en el offset 0: puede representar NULL en la lista enlazada
+    unsigned char hdr[LINKED_LIST_FILE_HEADER_SIZE];
+    uint64_t magic = LINKED_LIST_MAGIC;
+    memcpy(hdr, &magic, 8);
+    memcpy(hdr + 8, &nodes_gen, 8);
+    if (safe_write_full(fd, hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr)) {
         close(fd);
         return -1;
     }
@@ -30,6 +34,24 @@ int linked_list_nodes_create(const char *path) {
     return 0;
 }
 
+int linked_list_check_gen(int fd, uint64_t nodes_gen) {
+    unsigned char hdr[LINKED_LIST_FILE_HEADER_SIZE];
+    uint64_t magic, gen;
+    if (safe_pread(fd, hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr)) {
+        fprintf(stderr, "Error: el archivo de nodos no tiene encabezado (reconstruya el indice con --build)\n");
+        return -1;
+    }
+    memcpy(&magic, hdr, 8);
+    memcpy(&gen, hdr + 8, 8);
+    if (magic != LINKED_LIST_MAGIC || gen != nodes_gen) {
+        fprintf(stderr, "Error: el archivo de nodos no corresponde a la tabla de buckets (generacion %llu, "
+                        "la tabla espera %llu): una compactacion se interrumpio, reconstruya el indice con --build\n",
+                (unsigned long long)gen, (unsigned long long)nodes_gen);
+        return -1;
+    }
+    return 0;
+}
+
 // Abre el archivo de nodos, retorna el file descriptor
 int linked_list_open(const char *path) { // Revisar si es factible eliminar esta funcion
     int fd = open(path, O_RDWR);
@@ -37,9 +59,83 @@ int linked_list_open(const char *path) { // Revisar si es factible eliminar esta
 }
 
 // Retorna el tamaño en bytes de un nodo
-size_t linked_list_node_size(uint16_t key_len) {
-    // Tamaño de key_len + key + entry_offset + next_ptr
-    return sizeof(uint16_t) + (size_t)key_len + sizeof(off_t) + sizeof(off_t);
+size_t linked_list_node_size(uint16_t key_len, uint32_t cap) {
+    // Tamaño de hash + next_ptr + count + cap + key_len + key + postings
+    return LINKED_LIST_HEADER_SIZE + (size_t)key_len + (size_t)cap * LINKED_LIST_POSTING_SIZE;
+}
+
+int linked_list_posting_check(off_t offset, uint32_t record_len) {
+    if (offset < 0 || offset >= LINKED_LIST_MAX_OFFSET || record_len == 0 || record_len > LINKED_LIST_MAX_RECORD_LEN) {
+        fprintf(stderr, "Error: el registro en el offset %lld no cabe en una posting\n", (long long)offset);
+        return -1;
+    }
+    return 0;
+}
+
+void linked_list_posting_encode(off_t offset, uint32_t record_len, unsigned char *buf) {
+    uint64_t packed = ((uint64_t)offset << 24) | record_len;
+    memcpy(buf, &packed, sizeof(packed));
+}
+
+void linked_list_posting_get(const linked_list_node_t *node, uint32_t i, off_t *offset, uint32_t *record_len) {
+    uint64_t packed;
+    memcpy(&packed, node->postings + (size_t)i * LINKED_LIST_POSTING_SIZE, sizeof(packed));
+    *offset = (off_t)(packed >> 24);
+    *record_len = (uint32_t)(packed & LINKED_LIST_MAX_RECORD_LEN);
+}
+
+// Serializa un nodo en buf (de linked_list_node_size(node->key_len, node->cap) bytes), retorna los bytes escritos
+size_t linked_list_encode_node(const linked_list_node_t *node, unsigned char *buf) {
+    uint16_t key_len = node -> key_len; // Cantidad de caracteres de la key (titulo)
+    size_t pos = 0; 
+
+    memcpy(buf + pos, &node->hash, sizeof(node->hash)); // Escribe la huella (en el buffer)
+    pos += sizeof(node->hash);
+
+    memcpy(buf + pos, &node->next_ptr, sizeof node->next_ptr);
+    pos += sizeof(off_t);
+
+    memcpy(buf + pos, &node->count, sizeof(node->count));
+    pos += sizeof(node->count);
+
+    memcpy(buf + pos, &node->cap, sizeof(node->cap));
+    pos += sizeof(node->cap);
+
+    memcpy(buf + pos, &key_len, sizeof(key_len)); // Escribe key_len
+    pos += sizeof(key_len);
+
+    memcpy(buf + pos, node->key, key_len); // Escribe la key (titulo)
+    pos += key_len;
+
+    size_t used = (size_t)node->count * LINKED_LIST_POSTING_SIZE; // Postings y lugares libres
+    memcpy(buf + pos, node->postings, used);
+    memset(buf + pos + used, 0, (size_t)(node->cap - node->count) * LINKED_LIST_POSTING_SIZE);
+    pos += (size_t)node->cap * LINKED_LIST_POSTING_SIZE;
+    return pos;
+}
+
+// Lee un nodo de memoria; node->key y node->postings apuntan dentro de buf (la key sin '\0')
+size_t linked_list_decode_node(const unsigned char *buf, size_t avail, linked_list_node_t *node) {
+    if (avail < LINKED_LIST_HEADER_SIZE) return 0;
+
+    // Campos fijos
+    size_t pos = 0;
+    memcpy(&node->hash, buf + pos, sizeof(uint64_t));
+    pos += sizeof(uint64_t);
+    memcpy(&node->next_ptr, buf + pos, sizeof(off_t));
+    pos += sizeof(off_t);
+    memcpy(&node->count, buf + pos, sizeof(node->count));
+    pos += sizeof(node->count);
+    memcpy(&node->cap, buf + pos, sizeof(node->cap));
+    pos += sizeof(node->cap);
+    memcpy(&node->key_len, buf + pos, sizeof(uint16_t));
+    pos += sizeof(uint16_t);
+
+    size_t node_size = linked_list_node_size(node->key_len, node->cap);
+    if (avail < node_size || node->count > node->cap) return 0; // La key o las postings no estan completas en buf
+    node->key = (char *)buf + pos;
+    node->postings = buf + pos + node->key_len;
+    return node_size;
 }
 
 // Añade un nodo al archivo, retorna el offset del nodo retorna offset 0 si hay error
@@ -48,37 +144,16 @@ off_t linked_list_append_node(int fd, const linked_list_node_t *node) {
         fprintf(stderr, "Error: el nodo a insertar tiene una llave nula\n");
         return 0; 
     } 
-    uint16_t key_len = node -> key_len; // Cantidad de caracteres de la key (titulo)
-    size_t node_size = linked_list_node_size(key_len);
+    size_t node_size = linked_list_node_size(node->key_len, node->cap);
     unsigned char *buf = malloc(node_size); 
     if (buf == NULL) {
         fprintf(stderr, "Error de malloc\n");
         return 0;
     }
-    size_t pos = 0; 
-
-    memcpy(buf + pos, &key_len, sizeof(key_len)); // Escribe key_len (en el buffer)
-    pos += sizeof(key_len);
-
-    memcpy(buf + pos, node->key, key_len); // Escribe la key (titulo)
-    pos += key_len;
-
-    memcpy(buf + pos, &node->entry_offset, sizeof(node->entry_offset));
-    pos += sizeof(node->entry_offset);
-
-    memcpy(buf + pos, &node->next_ptr, sizeof node->next_ptr);
-    pos += sizeof(off_t);
+    linked_list_encode_node(node, buf);
 
     off_t new_node_off = lseek(fd, 0, SEEK_END); // Devuelve el offset del final del archivo
-    /*if (new_node_off == (off_t)0) { // No insertar al inicio del archivo, el primer byte esta reservado para representar NULL
-        char null_byte = 0;
-        if (write(fd, &null_byte, 1) != 1) {
-            free(buf);
-            return 0;
-        }
-        new_node_off = 1;  // Primer nodo va en offset 1
-    }*/
-    if (safe_pwrite(fd, buf, node_size, new_node_off) != (ssize_t)node_size) {
+    if (page_pool_pwrite(fd, buf, node_size, new_node_off) != (ssize_t)node_size) {
         free(buf);
         return 0;
     }
@@ -86,51 +161,237 @@ off_t linked_list_append_node(int fd, const linked_list_node_t *node) {
     return (off_t)new_node_off;
 }
 
+int linked_list_append_posting(int fd, off_t node_off, linked_list_node_t *node, off_t offset, uint32_t record_len) {
+    if (node->count >= node->cap) return -1;
+    unsigned char posting[LINKED_LIST_POSTING_SIZE];
+    linked_list_posting_encode(offset, record_len, posting);
+    off_t postings_off = node_off + (off_t)LINKED_LIST_HEADER_SIZE + node->key_len;
+    off_t count_off = node_off + (off_t)(sizeof(uint64_t) + sizeof(off_t));
+    uint16_t count = node->count + 1;
+    // La posting antes que el count: un lector que ve el count nuevo ya ve la posting
+    if (page_pool_pwrite(fd, posting, sizeof(posting), postings_off + (off_t)node->count * LINKED_LIST_POSTING_SIZE) != (ssize_t)sizeof(posting) ||
+        page_pool_pwrite(fd, &count, sizeof(count), count_off) != (ssize_t)sizeof(count)) {
+        return -1;
+    }
+    node->count = count;
+    return 0;
+}
+
 // Lee la informacion de un nodo (en el archivo de nodos) a un struct
-int linked_list_read_node(int fd, off_t node_off, linked_list_node_t *node) {
-    if (node == NULL) return -1; 
+int linked_list_read_node(int fd, off_t node_off, linked_list_node_t *node, unsigned char *buf, arena_t *arena) {
+    if (node == NULL || buf == NULL) return -1; 
 
-    // Leer el tamaño de la key
-    uint16_t key_len;
-    if (safe_pread(fd, &key_len, sizeof(uint16_t), node_off) != (ssize_t)sizeof(uint16_t)) {
+    // Un solo pread: la mayoria de los nodos caben completos en LINKED_LIST_READ_HINT bytes
+    ssize_t got = safe_pread(fd, buf, LINKED_LIST_READ_HINT, node_off);
+    if (got < (ssize_t)LINKED_LIST_HEADER_SIZE) {
         return -1;
     }
-    node->key_len = key_len;
 
-    // Reservar memoria para la key (+1 byte para '\0')
-    node->key = malloc(key_len + 1);
-    if (node->key == NULL) {
-        return -1;
+    size_t node_size = linked_list_decode_node(buf, (size_t)got, node);
+    if (node_size == 0) {
+        // Solo las llaves muy largas (o con muchas postings) necesitan un segundo pread para el resto del nodo
+        size_t full = linked_list_node_size(node->key_len, node->cap);
+        if (node->cap > LINKED_LIST_MAX_CAP || node->count > node->cap || full < (size_t)got) return -1;
+        size_t rest = full - (size_t)got;
+        if (safe_pread(fd, buf + got, rest, node_off + got) != (ssize_t)rest) {
+            return -1;
+        }
+        if (linked_list_decode_node(buf, full, node) == 0) return -1;
     }
-    // Leer la key
-    off_t key_off = node_off + sizeof(uint16_t);
-    if (safe_pread(fd, node->key, key_len, key_off) != key_len) {
-        free(node->key);
+
+    if (arena != NULL) { // La key se copia al arena de la peticion (+1 byte para '\0')
+        char *key = arena_alloc(arena, (size_t)node->key_len + 1);
+        if (key == NULL) return -1;
+        memcpy(key, node->key, node->key_len);
+        key[node->key_len] = '\0';  // asegurarse de que la cadena esté terminada en '\0'
+        node->key = key;
+    } // Si no, la key apunta al buffer (valida hasta la siguiente lectura), sin terminador
+    return 0;
+}
+
+int linked_list_writer_init(linked_list_writer_t *w, int fd, off_t tail, size_t cap) {
+    if (cap < LINKED_LIST_MAX_NODE_SIZE) cap = LINKED_LIST_MAX_NODE_SIZE; // Cualquier nodo cabe en el buffer
+    w->buf = malloc(cap);
+    if (w->buf == NULL) {
+        perror("malloc");
         return -1;
     }
-    node->key[key_len] = '\0';  // asegurarse de que la cadena esté terminada en '\0'
+    w->fd = fd;
+    w->len = 0;
+    w->cap = cap;
+    w->tail = tail;
+    return 0;
+}
 
-    // Leer entry_offset
-    off_t entry_offset_off = key_off + key_len;
-    if (safe_pread(fd, &node->entry_offset, sizeof(off_t), entry_offset_off) != (ssize_t)sizeof(off_t)) {
-        free(node->key);
-        return -1;
+off_t linked_list_writer_append(linked_list_writer_t *w, const linked_list_node_t *node) {
+    if (node == NULL || node->key == NULL) {
+        fprintf(stderr, "Error: el nodo a insertar tiene una llave nula\n");
+        return 0;
     }
+    size_t size = linked_list_node_size(node->key_len, node->cap);
+    if (w->len + size > w->cap && linked_list_writer_flush(w) != 0) return 0;
+    if (size > w->cap) { // Un nodo de extent con muchas postings: el buffer crece
+        unsigned char *tmp = realloc(w->buf, size);
+        if (tmp == NULL) {
+            perror("realloc");
+            return 0;
+        }
+        w->buf = tmp;
+        w->cap = size;
+    }
+    linked_list_encode_node(node, w->buf + w->len);
+    w->len += size;
+    off_t node_off = w->tail;
+    w->tail += (off_t)size;
+    return node_off;
+}
 
-    // Leer next_ptr
-    off_t next_ptr_off = entry_offset_off + sizeof(off_t);
-    if (safe_pread(fd, &node->next_ptr, sizeof(off_t), next_ptr_off) != (ssize_t)sizeof(off_t)) {
-        free(node->key);
+// Orden para agrupar las filas: por llave (hash, largo y bytes) y, dentro de la llave, por offset
+static int row_cmp(const void *a, const void *b) {
+    const linked_list_row_t *x = a, *y = b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    if (x->key_len != y->key_len) return x->key_len < y->key_len ? -1 : 1;
+    int c = memcmp(x->key, y->key, x->key_len);
+    if (c != 0) return c;
+    return (x->offset > y->offset) - (x->offset < y->offset);
+}
+
+// Grupo de filas de una llave (o tramo de LINKED_LIST_MAX_POSTINGS): [start, start + count) en rows, ya ordenado
+typedef struct {
+    size_t start;
+    uint32_t count;
+    off_t newest;
+} row_group_t;
+
+static int group_cmp(const void *a, const void *b) {
+    const row_group_t *x = a, *y = b;
+    return (x->newest < y->newest) - (x->newest > y->newest); // La fila mas reciente primero
+}
+
+int64_t linked_list_writer_append_rows(linked_list_writer_t *w, linked_list_row_t *rows, size_t n) {
+    if (n == 0) return 0;
+    qsort(rows, n, sizeof(linked_list_row_t), row_cmp);
+    row_group_t *groups = malloc(sizeof(row_group_t) * n); // Como mucho un grupo por fila
+    if (groups == NULL) {
+        perror("malloc");
         return -1;
     }
+    size_t ngroups = 0;
+    size_t max_count = 0;
+    for (size_t i = 0; i < n; ) {
+        size_t j = i + 1;
+        while (j < n && j - i < LINKED_LIST_MAX_POSTINGS && rows[j].hash == rows[i].hash && rows[j].key_len == rows[i].key_len && memcmp(rows[j].key, rows[i].key, rows[i].key_len) == 0) {
+            j++;
+        }
+        groups[ngroups].start = i;
+        groups[ngroups].count = (uint32_t)(j - i);
+        groups[ngroups].newest = rows[j - 1].offset;
+        ngroups++;
+        if (j - i > max_count) max_count = j - i;
+        i = j;
+    }
+    qsort(groups, ngroups, sizeof(row_group_t), group_cmp);
 
+    unsigned char *postings = malloc(max_count * LINKED_LIST_POSTING_SIZE);
+    int64_t written = -1;
+    if (postings == NULL) {
+        perror("malloc");
+        goto done;
+    }
+    for (size_t g = 0; g < ngroups; g++) {
+        const linked_list_row_t *first = &rows[groups[g].start];
+        for (uint32_t k = 0; k < groups[g].count; k++) {
+            if (linked_list_posting_check(first[k].offset, first[k].record_len) != 0) goto done;
+            linked_list_posting_encode(first[k].offset, first[k].record_len, postings + (size_t)k * LINKED_LIST_POSTING_SIZE);
+        }
+        linked_list_node_t node = {.hash = first->hash, .next_ptr = 0, .count = (uint16_t)groups[g].count, .cap = (uint16_t)groups[g].count,
+                                   .key_len = first->key_len, .key = (char *)first->key, .postings = postings};
+        if (linked_list_writer_append(w, &node) == 0) goto done;
+    }
+    written = (int64_t)ngroups;
+
+done:
+    free(postings);
+    free(groups);
+    return written;
+}
+
+void linked_list_rows_init(linked_list_rows_t *r, size_t key_block) {
+    r->rows = NULL;
+    r->count = 0;
+    r->cap = 0;
+    arena_init(&r->keys, key_block);
+}
+
+static int rows_push(linked_list_rows_t *r, const linked_list_row_t *row) {
+    if (r->count == r->cap) {
+        size_t new_cap = r->cap ? r->cap * 2 : 64;
+        linked_list_row_t *tmp = realloc(r->rows, new_cap * sizeof(linked_list_row_t));
+        if (tmp == NULL) {
+            perror("realloc");
+            return -1;
+        }
+        r->rows = tmp;
+        r->cap = new_cap;
+    }
+    r->rows[r->count++] = *row;
+    return 0;
+}
+
+int linked_list_rows_add(linked_list_rows_t *r, uint64_t hash, const char *key, uint16_t key_len, off_t offset,
+                         uint32_t record_len) {
+    linked_list_row_t row = {.hash = hash, .offset = offset, .record_len = record_len, .key_len = key_len, .key = NULL};
+    const linked_list_row_t *prev = r->count > 0 ? &r->rows[r->count - 1] : NULL;
+    if (prev != NULL && prev->hash == hash && prev->key_len == key_len && memcmp(prev->key, key, key_len) == 0) {
+        row.key = prev->key; // Misma llave que la fila anterior: no se copia de nuevo
+    } else {
+        char *copy = arena_alloc(&r->keys, key_len > 0 ? key_len : 1);
+        if (copy == NULL) return -1;
+        memcpy(copy, key, key_len);
+        row.key = copy;
+    }
+    return rows_push(r, &row);
+}
+
+int linked_list_rows_add_node(linked_list_rows_t *r, const linked_list_node_t *node) {
+    char *copy = arena_alloc(&r->keys, node->key_len > 0 ? node->key_len : 1);
+    if (copy == NULL) return -1;
+    memcpy(copy, node->key, node->key_len);
+    for (uint32_t i = 0; i < node->count; i++) {
+        linked_list_row_t row = {.hash = node->hash, .key_len = node->key_len, .key = copy};
+        linked_list_posting_get(node, i, &row.offset, &row.record_len);
+        if (rows_push(r, &row) != 0) return -1;
+    }
     return 0;
 }
 
+void linked_list_rows_reset(linked_list_rows_t *r) {
+    r->count = 0;
+    arena_reset(&r->keys);
+}
+
+void linked_list_rows_free(linked_list_rows_t *r) {
+    free(r->rows);
+    r->rows = NULL;
+    r->count = 0;
+    r->cap = 0;
+    arena_free(&r->keys);
+}
 
-void linked_list_free_node(linked_list_node_t *node) {
-    if (!node) return;
-    if (node->key) { free(node->key); node->key = NULL; }
-    node->key_len = 0;
-    node->next_ptr = 0;
-}
\ No newline at end of file
+int linked_list_writer_flush(linked_list_writer_t *w) {
+    if (w->len == 0) return 0;
+    off_t pos = w->tail - (off_t)w->len; // El buffer termina en la cola
+    if (page_pool_pwrite(w->fd, w->buf, w->len, pos) != (ssize_t)w->len) {
+        perror("pwrite");
+        return -1;
+    }
+    w->len = 0;
+    return 0;
+}
+
+void linked_list_writer_free(linked_list_writer_t *w) {
+    free(w->buf);
+    w->buf = NULL;
+    w->len = 0;
+    w->cap = 0;
+}
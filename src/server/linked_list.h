@@ -3,16 +3,70 @@
 
 #include <stdint.h>
 #include "common.h"
+#include "arena.h"
+
+// Bytes que se leen de una vez al leer un nodo (cubre la llave de casi cualquier titulo)
+#define LINKED_LIST_READ_HINT 512
+
+/* Formato de un nodo en el archivo (campos fijos primero, luego la key y las postings):
+ * [uint64 hash][off_t next_ptr][uint16 count][uint16 cap][uint16 key_len][key][cap x uint64 posting]
+ * Un nodo guarda una llave distinta una sola vez con la lista de sus filas en el csv. Cada
+ * posting es offset << 24 | record_len, de la fila mas antigua a la mas reciente; los cap - count
+ * lugares del final estan libres para filas nuevas (build_index_line las agrega sin mover el
+ * nodo). En un extent cap = count; una llave con mas de LINKED_LIST_MAX_POSTINGS filas ocupa
+ * varios nodos. Un nodo de una sola fila ocupa lo mismo que en el formato de un nodo por fila. */
+#define LINKED_LIST_HEADER_SIZE (sizeof(uint64_t) + sizeof(off_t) + 3 * sizeof(uint16_t))
+#define LINKED_LIST_POSTING_SIZE 8
+#define LINKED_LIST_MAX_OFFSET ((off_t)1 << 40)        // Offsets de fila de 40 bits
+#define LINKED_LIST_MAX_RECORD_LEN ((1u << 24) - 1)    // Filas de hasta 16 MiB
+#define LINKED_LIST_INITIAL_CAP 2                      // Postings de un nodo nuevo de la lista enlazada
+#define LINKED_LIST_MAX_CAP 1024                       // Postings maximas de un nodo de la lista enlazada
+#define LINKED_LIST_MAX_POSTINGS UINT16_MAX            // Postings maximas de cualquier nodo
+
+// Tamaño del nodo de lista enlazada mas grande posible: tamaño del buffer de lectura
+#define LINKED_LIST_MAX_NODE_SIZE (LINKED_LIST_HEADER_SIZE + UINT16_MAX + LINKED_LIST_MAX_CAP * LINKED_LIST_POSTING_SIZE)
 
 typedef struct {
+    uint64_t hash;       // hash de la key con la funcion del indice: huella para descartar nodos sin comparar la key
+    off_t next_ptr;      // siguiente puntero de la lista enlazada
+    uint16_t count;      // filas de la llave en este nodo
+    uint16_t cap;        // lugares para postings en el archivo (count <= cap)
     uint16_t key_len;    // tamaño de la key (titulo)  
     char *key;           // key (titulo)
-    off_t entry_offset;  // offset (en el csv) del libro 
-    off_t next_ptr;      // siguiente puntero de la lista enlazada
+    const unsigned char *postings; // count postings serializadas (ver linked_list_posting_get)
 } linked_list_node_t;
 
-// Crea el archivo de nodos
-int linked_list_nodes_create(const char *path);
+// Fila de un bucket antes de agruparla por llave (ver linked_list_writer_append_rows)
+typedef struct {
+    uint64_t hash;
+    off_t offset;        // offset (en el csv) del libro
+    uint32_t record_len; // bytes de la linea del libro en el csv (incluyendo '\n')
+    uint16_t key_len;
+    const char *key;
+} linked_list_row_t;
+
+// Verifica que la fila quepa en una posting. Retorna 0, o -1 (con mensaje) si no cabe
+int linked_list_posting_check(off_t offset, uint32_t record_len);
+
+// Serializa una posting en buf (LINKED_LIST_POSTING_SIZE bytes)
+void linked_list_posting_encode(off_t offset, uint32_t record_len, unsigned char *buf);
+
+// Posting i del nodo (0 = la fila mas antigua)
+void linked_list_posting_get(const linked_list_node_t *node, uint32_t i, off_t *offset, uint32_t *record_len);
+
+/* title_linked_list.dat empieza con [magic][uint64 nodes_gen] y los nodos van despues, asi que el
+ * offset 0 sigue representando NULL. nodes_gen debe ser el del encabezado de la tabla de buckets:
+ * la compactacion instala los dos archivos con dos rename, y si se interrumpe entre ellos la tabla
+ * vieja apuntaria a offsets del archivo de nodos nuevo. Con el numero distinto el par se rechaza */
+#define LINKED_LIST_FILE_HEADER_SIZE 16
+#define LINKED_LIST_MAGIC 0x31444f4e49444e49ULL // "INDINOD1"
+
+// Crea el archivo de nodos (solo el encabezado) con la generacion nodes_gen
+int linked_list_nodes_create(const char *path, uint64_t nodes_gen);
+
+/* Verifica que el archivo de nodos abierto en fd tenga la generacion nodes_gen de la tabla.
+ * Retorna 0, o -1 (con mensaje) si no corresponde */
+int linked_list_check_gen(int fd, uint64_t nodes_gen);
 
 // Abre el archivo de nodos, retorna el file descriptor
 int linked_list_open(const char *path);
@@ -20,13 +74,77 @@ int linked_list_open(const char *path);
 // Añade un nodo y retorna su offset (Retorna offset 0 en caso de error)
 off_t linked_list_append_node(int fd, const linked_list_node_t *node);
 
-// Lee los datos de un nodo
-int linked_list_read_node(int fd, off_t node_off, linked_list_node_t *node);
+/* Agrega una fila al final de las postings del nodo en node_off (node leido de ahi, con
+ * count < cap): escribe la posting y despues el nuevo count. Retorna 0, o -1 si falla */
+int linked_list_append_posting(int fd, off_t node_off, linked_list_node_t *node, off_t offset, uint32_t record_len);
 
-// Retorna el tamaño en bytes de un nodo
-size_t linked_list_node_size(uint16_t key_len);
+/* Lee los datos de un nodo con un solo pread en buf (de LINKED_LIST_MAX_NODE_SIZE bytes, reutilizable);
+ * solo las llaves de mas de ~480 bytes necesitan un segundo pread.
+ * Si arena no es NULL, la key se copia ahi terminada en '\0' (vive hasta arena_reset);
+ * si es NULL, node->key apunta dentro de buf, sin '\0', y es valida hasta la siguiente lectura.
+ * Ninguno de los dos casos hace malloc: la key no se libera. */
+int linked_list_read_node(int fd, off_t node_off, linked_list_node_t *node, unsigned char *buf, arena_t *arena);
+
+/* Serializa un nodo en buf (de linked_list_node_size(node->key_len, node->cap) bytes); los
+ * lugares libres de postings quedan en cero. Retorna los bytes escritos */
+size_t linked_list_encode_node(const linked_list_node_t *node, unsigned char *buf);
+
+/* Lee un nodo serializado al inicio de buf (avail bytes disponibles); node->key y node->postings
+ * apuntan dentro de buf (la key sin '\0'). Retorna el tamaño del nodo, o 0 si el nodo no esta
+ * completo en buf (si avail cubre los campos fijos, node->key_len y node->cap ya son validos) */
+size_t linked_list_decode_node(const unsigned char *buf, size_t avail, linked_list_node_t *node);
 
-// Libera los datos de un struct linked_list_node_t
-void linked_list_free_node(linked_list_node_t *node);
+/* Escritor secuencial de nodos: acumula nodos en un buffer grande y los escribe al final
+ * del archivo con un pwrite por bloque, llevando el offset de la cola sin lseek */
+typedef struct {
+    int fd;
+    unsigned char *buf;
+    size_t len;   // Bytes en el buffer (aun no escritos)
+    size_t cap;
+    off_t tail;   // Offset (en el archivo) que tendra el siguiente nodo
+} linked_list_writer_t;
+
+// Prepara el escritor para agregar nodos a partir de tail. Retorna 0, o -1 si falla malloc
+int linked_list_writer_init(linked_list_writer_t *w, int fd, off_t tail, size_t cap);
+
+// Agrega un nodo y retorna el offset que tendra en el archivo (0 si hay error)
+off_t linked_list_writer_append(linked_list_writer_t *w, const linked_list_node_t *node);
+
+/* Escribe las filas de un bucket como los nodos de un extent (next_ptr = 0, cap = count): un
+ * nodo por llave distinta (o por tramo de LINKED_LIST_MAX_POSTINGS filas), con sus postings de la mas antigua a la mas reciente, y los nodos
+ * ordenados por su fila mas reciente, de la mas nueva a la mas vieja. El resultado solo depende
+ * del conjunto de filas (rows se reordena), asi que todas las construcciones escriben los mismos
+ * bytes. Retorna el numero de nodos escritos, o -1 si falla */
+int64_t linked_list_writer_append_rows(linked_list_writer_t *w, linked_list_row_t *rows, size_t n);
+
+/* Filas de un bucket que se van a reagrupar (compactacion, split, construccion externa); las
+ * llaves se copian al arena y viven hasta linked_list_rows_reset */
+typedef struct {
+    linked_list_row_t *rows;
+    size_t count;
+    size_t cap;
+    arena_t keys;
+} linked_list_rows_t;
+
+void linked_list_rows_init(linked_list_rows_t *r, size_t key_block);
+
+// Agrega una fila (copia la llave si no es la de la fila anterior). Retorna 0, o -1 si falla malloc
+int linked_list_rows_add(linked_list_rows_t *r, uint64_t hash, const char *key, uint16_t key_len, off_t offset,
+                         uint32_t record_len);
+
+// Agrega las count filas de un nodo (la llave se copia una vez). Retorna 0, o -1 si falla malloc
+int linked_list_rows_add_node(linked_list_rows_t *r, const linked_list_node_t *node);
+
+void linked_list_rows_reset(linked_list_rows_t *r);
+void linked_list_rows_free(linked_list_rows_t *r);
+
+// Escribe lo que queda en el buffer. Retorna 0, o -1 si falla
+int linked_list_writer_flush(linked_list_writer_t *w);
+
+// Libera el buffer (no hace flush ni cierra el fd)
+void linked_list_writer_free(linked_list_writer_t *w);
+
+// Retorna el tamaño en bytes de un nodo
+size_t linked_list_node_size(uint16_t key_len, uint32_t cap);
 
 #endif // LINKED_LIST_H
@@ -0,0 +1,354 @@
+#define _GNU_SOURCE
+#include "page_pool.h"
+#include "common.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define POOL_NO_FRAME UINT32_MAX
+
+// Metadatos de un frame (los datos van aparte, en el bloque de la parte)
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t page;       // Numero de pagina en el archivo
+    uint32_t valid;      // Bytes validos de la pagina (0 = frame libre)
+    uint32_t chain;      // Siguiente frame del bucket
+    int referenced;      // Bit de uso de CLOCK
+} pool_frame_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pool_frame_t *frames;
+    unsigned char *data;   // nframes x POOL_PAGE_SIZE
+    uint32_t *buckets;     // Primer frame de cada bucket (POOL_NO_FRAME si esta vacio)
+    uint32_t nframes;
+    uint32_t nbuckets;     // Potencia de dos
+    uint32_t used;         // Frames que ya se usaron alguna vez (los demas estan libres)
+    uint32_t hand;         // Manecilla de CLOCK
+    uint64_t pages;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t invalidations;
+} pool_shard_t;
+
+// Presupuesto de una clase de paginas (POOL_INDEX o POOL_RECORDS)
+typedef struct {
+    uint32_t frames_per_shard; // 0: la clase se lee sin pool
+    pool_shard_t shards[POOL_SHARDS];
+} pool_part_t;
+
+struct page_pool {
+    uint64_t epoch; // Escrituras invalidadas (__atomic)
+    pool_part_t parts[POOL_KINDS];
+};
+
+static page_pool_t *process_pool; // El que invalida page_pool_pwrite (__atomic)
+static int direct_warned;
+
+// La parte sale de los bits altos del hash y el bucket de los bajos
+static uint64_t page_hash(uint64_t dev, uint64_t ino, uint64_t page) {
+    uint64_t x = ino * 0x9e3779b97f4a7c15ULL ^ dev * 0xc2b2ae3d27d4eb4fULL ^ page;
+    x ^= x >> 31;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 29;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 32);
+}
+
+static pool_shard_t *shard_of(pool_part_t *part, uint64_t hash) {
+    return &part->shards[hash >> 60 & (POOL_SHARDS - 1)];
+}
+
+static void part_free(pool_part_t *part) {
+    for (int i = 0; i < POOL_SHARDS && part->frames_per_shard > 0; i++) {
+        pool_shard_t *s = &part->shards[i];
+        free(s->frames);
+        free(s->data);
+        free(s->buckets);
+        pthread_mutex_destroy(&s->lock);
+    }
+    part->frames_per_shard = 0;
+}
+
+static int part_init(pool_part_t *part, size_t bytes) {
+    size_t per_shard = bytes / POOL_PAGE_SIZE / POOL_SHARDS;
+    if (per_shard > UINT32_MAX / 2) per_shard = UINT32_MAX / 2;
+    part->frames_per_shard = (uint32_t)per_shard;
+    if (per_shard == 0) return 0;
+    uint32_t nbuckets = 1;
+    while (nbuckets < per_shard) nbuckets <<= 1;
+    for (int i = 0; i < POOL_SHARDS; i++) {
+        pool_shard_t *s = &part->shards[i];
+        pthread_mutex_init(&s->lock, NULL);
+        s->nframes = (uint32_t)per_shard;
+        s->nbuckets = nbuckets;
+        s->frames = calloc(per_shard, sizeof(pool_frame_t));
+        s->data = malloc(per_shard * POOL_PAGE_SIZE);
+        s->buckets = malloc(nbuckets * sizeof(uint32_t));
+    }
+    for (int i = 0; i < POOL_SHARDS; i++) {
+        pool_shard_t *s = &part->shards[i];
+        if (s->frames == NULL || s->data == NULL || s->buckets == NULL) {
+            perror("malloc (pool de paginas)");
+            part_free(part);
+            return -1;
+        }
+        for (uint32_t b = 0; b < nbuckets; b++) s->buckets[b] = POOL_NO_FRAME;
+    }
+    return 0;
+}
+
+page_pool_t *page_pool_create(size_t index_bytes, size_t record_bytes) {
+    page_pool_t *p = calloc(1, sizeof(*p));
+    if (p == NULL) {
+        perror("calloc (pool de paginas)");
+        return NULL;
+    }
+    if (part_init(&p->parts[POOL_INDEX], index_bytes) != 0 || part_init(&p->parts[POOL_RECORDS], record_bytes) != 0) {
+        page_pool_destroy(p);
+        return NULL;
+    }
+    __atomic_store_n(&process_pool, p, __ATOMIC_RELEASE);
+    return p;
+}
+
+void page_pool_destroy(page_pool_t *p) {
+    if (p == NULL) return;
+    __atomic_compare_exchange_n(&process_pool, &p, NULL, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    for (int k = 0; k < POOL_KINDS; k++) part_free(&p->parts[k]);
+    free(p);
+}
+
+// Puntero al enlace que apunta al frame de la pagina (o al POOL_NO_FRAME final de su bucket)
+static uint32_t *shard_find(pool_shard_t *s, uint64_t hash, uint64_t dev, uint64_t ino, uint64_t page) {
+    uint32_t *link = &s->buckets[hash & (s->nbuckets - 1)];
+    while (*link != POOL_NO_FRAME) {
+        pool_frame_t *fr = &s->frames[*link];
+        if (fr->page == page && fr->ino == ino && fr->dev == dev) break;
+        link = &fr->chain;
+    }
+    return link;
+}
+
+// Saca de su bucket el frame de *link y lo deja libre
+static void shard_unlink(pool_shard_t *s, uint32_t *link) {
+    pool_frame_t *fr = &s->frames[*link];
+    *link = fr->chain;
+    fr->valid = 0;
+    fr->referenced = 0;
+    s->pages--;
+}
+
+// Frame para una pagina nueva: uno sin usar, o el que elija CLOCK (sacandolo de su bucket)
+static uint32_t shard_victim(pool_shard_t *s) {
+    if (s->used < s->nframes) return s->used++;
+    for (;;) {
+        uint32_t idx = s->hand;
+        pool_frame_t *fr = &s->frames[idx];
+        s->hand = s->hand + 1 == s->nframes ? 0 : s->hand + 1;
+        if (fr->valid == 0) return idx; // Invalidado
+        if (fr->referenced) { // Segunda oportunidad
+            fr->referenced = 0;
+            continue;
+        }
+        shard_unlink(s, shard_find(s, page_hash(fr->dev, fr->ino, fr->page), fr->dev, fr->ino, fr->page));
+        s->evictions++;
+        return idx;
+    }
+}
+
+/* Copia [in_page, in_page + want) de la pagina si esta en el pool con esos bytes.
+ * Retorna 1 si la copio, 0 si hay que leerla */
+static int part_copy(pool_part_t *part, const pool_file_t *f, uint64_t page, size_t in_page, size_t want,
+                     unsigned char *out) {
+    uint64_t hash = page_hash(f->dev, f->ino, page);
+    pool_shard_t *s = shard_of(part, hash);
+    pthread_mutex_lock(&s->lock);
+    uint32_t idx = *shard_find(s, hash, f->dev, f->ino, page);
+    int hit = idx != POOL_NO_FRAME && s->frames[idx].valid >= in_page + want;
+    if (hit) {
+        s->frames[idx].referenced = 1;
+        s->hits++;
+        memcpy(out, s->data + (size_t)idx * POOL_PAGE_SIZE + in_page, want);
+    }
+    pthread_mutex_unlock(&s->lock);
+    return hit;
+}
+
+/* Guarda (o reemplaza) una pagina leida del disco. Se descarta si hubo una escritura desde epoch:
+ * la lectura pudo ver los bytes de antes */
+static void part_insert(page_pool_t *p, pool_part_t *part, const pool_file_t *f, uint64_t page,
+                        const unsigned char *data, uint32_t valid, uint64_t epoch) {
+    uint64_t hash = page_hash(f->dev, f->ino, page);
+    pool_shard_t *s = shard_of(part, hash);
+    pthread_mutex_lock(&s->lock);
+    s->misses++;
+    if (__atomic_load_n(&p->epoch, __ATOMIC_ACQUIRE) == epoch) {
+        uint32_t idx = *shard_find(s, hash, f->dev, f->ino, page);
+        if (idx == POOL_NO_FRAME) { // La ultima pagina de un archivo que crecio ya esta: se reemplaza
+            idx = shard_victim(s);
+            pool_frame_t *fr = &s->frames[idx];
+            fr->dev = f->dev;
+            fr->ino = f->ino;
+            fr->page = page;
+            fr->referenced = 0; // Hasta que se vuelva a pedir: las leidas una sola vez salen primero
+            uint32_t *link = &s->buckets[hash & (s->nbuckets - 1)];
+            fr->chain = *link;
+            *link = idx;
+            s->pages++;
+        }
+        s->frames[idx].valid = valid;
+        memcpy(s->data + (size_t)idx * POOL_PAGE_SIZE, data, valid);
+    }
+    pthread_mutex_unlock(&s->lock);
+}
+
+int pool_file_open(pool_file_t *f, page_pool_t *pool, int kind, int fd) {
+    f->pool = NULL;
+    f->kind = kind;
+    f->fd = fd;
+    f->own_fd = 0;
+    f->dev = 0;
+    f->ino = 0;
+    f->scratch = NULL;
+    if (pool == NULL || pool->parts[kind].frames_per_shard == 0) return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror("fstat (pool de paginas)");
+        return -1;
+    }
+    if (posix_memalign((void **)&f->scratch, POOL_PAGE_SIZE, POOL_READ_PAGES * POOL_PAGE_SIZE) != 0) {
+        f->scratch = NULL;
+        fprintf(stderr, "Error: sin memoria para el buffer del pool de paginas\n");
+        return -1;
+    }
+    // Un segundo descriptor del mismo archivo con O_DIRECT: cambiar los flags de fd afectaria al llamador
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    int dfd = open(path, O_RDONLY | O_DIRECT | O_CLOEXEC);
+    if (dfd >= 0 && pread(dfd, f->scratch, POOL_PAGE_SIZE, 0) < 0) { // El sistema de archivos no admite O_DIRECT
+        close(dfd);
+        dfd = -1;
+    }
+    if (dfd >= 0) {
+        f->fd = dfd;
+        f->own_fd = 1;
+    } else if (__atomic_exchange_n(&direct_warned, 1, __ATOMIC_ACQ_REL) == 0) {
+        fprintf(stderr, "Aviso: O_DIRECT no disponible; el pool de paginas lee con pread normal\n");
+    }
+    f->dev = (uint64_t)st.st_dev;
+    f->ino = (uint64_t)st.st_ino;
+    f->pool = pool;
+    return 0;
+}
+
+void pool_file_close(pool_file_t *f) {
+    if (f->own_fd) close(f->fd);
+    free(f->scratch);
+    f->scratch = NULL;
+    f->own_fd = 0;
+    f->fd = -1;
+    f->pool = NULL;
+}
+
+/* Lee del disco run paginas desde page, las guarda en el pool y copia want bytes desde in_page.
+ * Retorna los bytes copiados (menos al final del archivo) o -1 */
+static ssize_t read_run(pool_file_t *f, uint64_t page, size_t run, size_t in_page, size_t want, unsigned char *out) {
+    pool_part_t *part = &f->pool->parts[f->kind];
+    uint64_t epoch = __atomic_load_n(&f->pool->epoch, __ATOMIC_ACQUIRE); // Antes de leer el disco
+    ssize_t got = safe_pread(f->fd, f->scratch, run * POOL_PAGE_SIZE, (off_t)page * POOL_PAGE_SIZE);
+    if (got < 0) return -1;
+    for (size_t i = 0; i * POOL_PAGE_SIZE < (size_t)got; i++) {
+        size_t valid = (size_t)got - i * POOL_PAGE_SIZE;
+        if (valid > POOL_PAGE_SIZE) valid = POOL_PAGE_SIZE;
+        part_insert(f->pool, part, f, page + i, f->scratch + i * POOL_PAGE_SIZE, (uint32_t)valid, epoch);
+    }
+    if ((size_t)got <= in_page) return 0;
+    size_t n = (size_t)got - in_page < want ? (size_t)got - in_page : want;
+    memcpy(out, f->scratch + in_page, n);
+    return (ssize_t)n;
+}
+
+ssize_t pool_file_pread(pool_file_t *f, void *buf, size_t count, off_t offset) {
+    if (f->pool == NULL) return safe_pread(f->fd, buf, count, offset);
+    if (offset < 0) return -1;
+    pool_part_t *part = &f->pool->parts[f->kind];
+    unsigned char *out = buf;
+    size_t done = 0;
+    while (done < count) {
+        uint64_t pos = (uint64_t)offset + done;
+        uint64_t page = pos / POOL_PAGE_SIZE;
+        size_t in_page = (size_t)(pos % POOL_PAGE_SIZE);
+        size_t want = count - done < POOL_PAGE_SIZE - in_page ? count - done : POOL_PAGE_SIZE - in_page;
+        if (part_copy(part, f, page, in_page, want, out + done)) {
+            done += want;
+            continue;
+        }
+        // Falta: se lee con esta pagina el resto de lo pedido, hasta POOL_READ_PAGES paginas
+        size_t run = (in_page + (count - done) + POOL_PAGE_SIZE - 1) / POOL_PAGE_SIZE;
+        if (run > POOL_READ_PAGES) run = POOL_READ_PAGES;
+        size_t run_want = run * POOL_PAGE_SIZE - in_page < count - done ? run * POOL_PAGE_SIZE - in_page : count - done;
+        ssize_t n = read_run(f, page, run, in_page, run_want, out + done);
+        if (n < 0) return -1;
+        done += (size_t)n;
+        if ((size_t)n < run_want) break; // Fin del archivo
+    }
+    return (ssize_t)done;
+}
+
+// Borra del pool las paginas de [offset, offset + count) del archivo
+static void pool_invalidate(page_pool_t *p, uint64_t dev, uint64_t ino, off_t offset, size_t count) {
+    __atomic_add_fetch(&p->epoch, 1, __ATOMIC_ACQ_REL); // Las lecturas en curso no guardan lo que leyeron
+    uint64_t first = (uint64_t)offset / POOL_PAGE_SIZE;
+    uint64_t last = ((uint64_t)offset + count + POOL_PAGE_SIZE - 1) / POOL_PAGE_SIZE;
+    for (int k = 0; k < POOL_KINDS; k++) {
+        pool_part_t *part = &p->parts[k];
+        if (part->frames_per_shard == 0) continue;
+        for (uint64_t page = first; page < last; page++) {
+            uint64_t hash = page_hash(dev, ino, page);
+            pool_shard_t *s = shard_of(part, hash);
+            pthread_mutex_lock(&s->lock);
+            uint32_t *link = shard_find(s, hash, dev, ino, page);
+            if (*link != POOL_NO_FRAME) {
+                shard_unlink(s, link);
+                s->invalidations++;
+            }
+            pthread_mutex_unlock(&s->lock);
+        }
+    }
+}
+
+ssize_t page_pool_pwrite(int fd, const void *buf, size_t count, off_t offset) {
+    ssize_t w = safe_pwrite(fd, buf, count, offset);
+    page_pool_t *p = __atomic_load_n(&process_pool, __ATOMIC_ACQUIRE);
+    struct stat st;
+    // Aunque la escritura falle pudo cambiar parte del rango
+    if (p != NULL && offset >= 0 && count > 0 && fstat(fd, &st) == 0) {
+        pool_invalidate(p, (uint64_t)st.st_dev, (uint64_t)st.st_ino, offset, count);
+    }
+    return w;
+}
+
+void page_pool_stats(page_pool_t *p, int kind, page_pool_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+    pool_part_t *part = &p->parts[kind];
+    out->max_pages = (uint64_t)part->frames_per_shard * POOL_SHARDS;
+    for (int i = 0; i < POOL_SHARDS && part->frames_per_shard > 0; i++) {
+        pool_shard_t *s = &part->shards[i];
+        pthread_mutex_lock(&s->lock);
+        out->hits += s->hits;
+        out->misses += s->misses;
+        out->evictions += s->evictions;
+        out->invalidations += s->invalidations;
+        out->pages += s->pages;
+        pthread_mutex_unlock(&s->lock);
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef PAGE_POOL_H
+#define PAGE_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/* Pool de paginas en espacio de usuario para las lecturas con pread del indice y del csv
+ * (--pool-index MB, --pool-records MB). Las paginas se leen con O_DIRECT, sin pasar por el page
+ * cache del kernel, y se guardan en frames de POOL_PAGE_SIZE bytes reservados al crear el pool:
+ * la memoria de las lecturas queda fija. Las paginas del indice (buckets, slots y nodos) y las de
+ * registros del csv tienen presupuestos separados, asi que leer muchos registros una sola vez no
+ * desaloja las paginas del indice que usan todas las busquedas. Cada presupuesto esta dividido en
+ * POOL_SHARDS partes, cada una con su mutex, y desaloja con CLOCK; una pagina nueva entra sin el
+ * bit de uso, de modo que las leidas una sola vez son las primeras en salir.
+ * Coherencia: una pagina guardada recuerda cuantos bytes validos tenia (la ultima de un archivo
+ * que crece se vuelve a leer si se piden bytes mas alla), y las escrituras en el indice pasan por
+ * page_pool_pwrite, que invalida las paginas que tocan. El csv solo crece con OP_ADD_BOOK. */
+#define POOL_PAGE_SIZE 4096 // Multiplo del tamaño de bloque que exige O_DIRECT
+#define POOL_SHARDS 16
+#define POOL_READ_PAGES 16  // Paginas seguidas que faltan y se leen con un solo pread
+
+enum { POOL_INDEX = 0, POOL_RECORDS = 1, POOL_KINDS = 2 };
+
+typedef struct page_pool page_pool_t;
+
+typedef struct {
+    uint64_t hits;          // Paginas copiadas desde el pool
+    uint64_t misses;        // Paginas leidas del disco
+    uint64_t evictions;
+    uint64_t invalidations; // Paginas borradas por page_pool_pwrite
+    uint64_t pages;         // Paginas guardadas
+    uint64_t max_pages;
+} page_pool_stats_t;
+
+/* Pool con index_bytes para paginas del indice y record_bytes para las del csv (una clase con
+ * menos de POOL_SHARDS paginas se lee sin pool). El ultimo creado es el pool del proceso, el que
+ * invalida page_pool_pwrite. Retorna NULL si falla malloc */
+page_pool_t *page_pool_create(size_t index_bytes, size_t record_bytes);
+
+void page_pool_destroy(page_pool_t *p);
+
+/* Archivo leido a traves del pool. Uno por hilo: el buffer alineado de lectura no se comparte */
+typedef struct {
+    page_pool_t *pool;      // NULL: pool_file_pread es safe_pread sobre fd
+    int kind;               // POOL_INDEX o POOL_RECORDS
+    int fd;                 // Descriptor del que se lee (O_DIRECT si el sistema de archivos lo admite)
+    int own_fd;             // 1 si fd se abrio en pool_file_open y se cierra en pool_file_close
+    uint64_t dev;           // Identidad del archivo en el pool
+    uint64_t ino;
+    unsigned char *scratch; // POOL_READ_PAGES paginas alineadas a POOL_PAGE_SIZE
+} pool_file_t;
+
+/* Prepara las lecturas de fd (que sigue siendo del llamador) a traves del pool. Con pool NULL, o
+ * si la clase no tiene presupuesto, las lecturas van directo a fd. Retorna 0, o -1 si falla */
+int pool_file_open(pool_file_t *f, page_pool_t *pool, int kind, int fd);
+
+void pool_file_close(pool_file_t *f);
+
+/* Como safe_pread: retorna los bytes leidos (menos de count solo al final del archivo) o -1 */
+ssize_t pool_file_pread(pool_file_t *f, void *buf, size_t count, off_t offset);
+
+/* safe_pwrite que ademas invalida en el pool del proceso las paginas de [offset, offset + count) */
+ssize_t page_pool_pwrite(int fd, const void *buf, size_t count, off_t offset);
+
+// Suma los contadores de las partes de una clase
+void page_pool_stats(page_pool_t *p, int kind, page_pool_stats_t *out);
+
+#endif // PAGE_POOL_H
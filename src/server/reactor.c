@@ -0,0 +1,508 @@
+#define _GNU_SOURCE
+#include "reactor.h"
+#include "handlers.h"
+#include "worker_pool.h"
+#include "response.h"
+#include "protocol.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define MAX_EVENTS 256
+#define READ_CHUNK 16384              // Bytes que se piden en cada recv
+#define RBUF_SOFT_LIMIT (64 * 1024)   // Bytes que se leen por adelantado de una conexion
+#define IO_QUEUE_PER_WORKER 256       // Peticiones en espera por cada hilo de I/O
+#define FLUSH_MAX_IOV 64              // Segmentos de memoria por llamada a writev
+
+typedef struct request request_t;
+
+typedef struct conn {
+    int fd;
+    char *rbuf;         // Bytes recibidos que aun no forman una trama completa
+    size_t rlen;
+    size_t rcap;
+    response_t out;     // Respuesta pendiente de enviar
+    size_t out_seg;     // Segmento de 'out' que se esta enviando
+    size_t out_seg_sent; // Bytes ya enviados de ese segmento
+    int corked;         // TCP_CORK activo mientras se envia una respuesta con sendfile
+    int busy;           // Hay una peticion de esta conexion en el pool de I/O
+    int readable;       // El socket puede tener datos sin leer (edge-triggered: no llegara otro aviso)
+    int peer_closed;    // El cliente cerro su lado de la conexion
+    int closed;         // fd cerrado; la memoria se libera al final de la ronda de eventos
+    struct conn *next_closed;
+    request_t *pending; // Peticion esperando espacio en la cola del pool
+    struct conn *next_pending;
+} conn_t;
+
+struct request {
+    reactor_t *reactor;
+    conn_t *conn;
+    proto_op_t op;
+    char *body;
+    uint32_t body_len;
+    response_t resp;
+    int status;         // Resultado de handle_request
+    request_t *next;    // Lista de peticiones terminadas
+};
+
+struct reactor {
+    int epfd;
+    int listen_fd;
+    int event_fd;       // Los hilos de I/O avisan por aqui que terminaron una peticion
+    worker_pool_t *pool;
+
+    pthread_mutex_t done_lock;
+    request_t *done;    // Peticiones terminadas por los hilos de I/O (protegida por done_lock)
+
+    conn_t *pending_head; // Conexiones con una peticion que no cupo en la cola del pool
+    conn_t *pending_tail;
+    conn_t *closed;       // Conexiones cerradas en la ronda actual de epoll_wait
+    size_t num_conns;
+};
+
+// Trabajo del pool de I/O: ejecuta la peticion y la devuelve al reactor
+static void reactor_io_job(void *ctx, void *job) {
+    request_t *req = job;
+    reactor_t *r = req->reactor;
+    req->status = handle_request(ctx, req->op, req->body, req->body_len, &req->resp);
+
+    pthread_mutex_lock(&r->done_lock);
+    req->next = r->done;
+    r->done = req;
+    pthread_mutex_unlock(&r->done_lock);
+
+    uint64_t one = 1;
+    if (write(r->event_fd, &one, sizeof(one)) != sizeof(one)) {
+        perror("write (eventfd)");
+    }
+}
+
+static void request_free(request_t *req) {
+    free(req->body);
+    response_free(&req->resp);
+    free(req);
+}
+
+/* Cierra la conexion. La memoria no se libera aqui porque la misma ronda de epoll_wait
+ * puede traer todavia un evento que apunta a ella (ver reactor_free_closed) */
+static void conn_close(reactor_t *r, conn_t *c) {
+    if (c->closed) return;
+    close(c->fd); // close() tambien lo saca del epoll
+    c->fd = -1;
+    c->closed = 1;
+    free(c->rbuf);
+    c->rbuf = NULL;
+    response_free(&c->out);
+    c->next_closed = r->closed;
+    r->closed = c;
+    r->num_conns--;
+}
+
+static void reactor_free_closed(reactor_t *r) {
+    while (r->closed) {
+        conn_t *c = r->closed;
+        r->closed = c->next_closed;
+        free(c);
+    }
+}
+
+/* Longitud total de la trama al inicio de rbuf, o 0 si aun no se conoce.
+ * Retorna -1 si la cabecera es invalida */
+static ssize_t frame_total_len(const conn_t *c) {
+    uint32_t op_len, body_len;
+    if (c->rlen < sizeof(uint32_t)) return 0;
+    memcpy(&op_len, c->rbuf, sizeof(op_len));
+    if (op_len == 0 || op_len > PROTO_MAX_OP_LEN) return -1;
+
+    size_t body_len_pos = sizeof(uint32_t) + op_len;
+    if (c->rlen < body_len_pos + sizeof(uint32_t)) return 0;
+    memcpy(&body_len, c->rbuf + body_len_pos, sizeof(body_len));
+    if (body_len > PROTO_MAX_BODY_LEN) return -1;
+
+    return (ssize_t)(body_len_pos + sizeof(uint32_t) + body_len);
+}
+
+/* Lee del socket todo lo disponible (hasta el limite del buffer).
+ * Retorna 0, o -1 si hubo un error en el socket o una trama invalida */
+static int conn_read(conn_t *c) {
+    while (c->readable) {
+        ssize_t frame_len = frame_total_len(c);
+        if (frame_len < 0) return -1;
+        size_t limit = (size_t)frame_len > RBUF_SOFT_LIMIT ? (size_t)frame_len : RBUF_SOFT_LIMIT;
+        if (c->rlen >= limit) break; // Buffer lleno: se sigue leyendo cuando se consuman tramas
+
+        if (c->rcap - c->rlen < READ_CHUNK && c->rcap < limit) {
+            size_t new_cap = c->rcap ? c->rcap * 2 : READ_CHUNK;
+            while (new_cap < c->rlen + READ_CHUNK && new_cap < limit) new_cap *= 2;
+            if (new_cap > limit) new_cap = limit;
+            char *tmp = realloc(c->rbuf, new_cap);
+            if (tmp == NULL) {
+                perror("realloc");
+                return -1;
+            }
+            c->rbuf = tmp;
+            c->rcap = new_cap;
+        }
+
+        ssize_t n = recv(c->fd, c->rbuf + c->rlen, c->rcap - c->rlen, 0);
+        if (n > 0) {
+            c->rlen += (size_t)n;
+        } else if (n == 0) {
+            c->peer_closed = 1;
+            c->readable = 0;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            c->readable = 0;
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int conn_has_output(const conn_t *c) {
+    return c->out_seg < c->out.nsegs;
+}
+
+// Activa/desactiva TCP_CORK: las cabeceras (writev) y las lineas (sendfile) salen en paquetes llenos
+static void conn_set_cork(conn_t *c, int on) {
+    if (c->corked == on) return;
+    if (setsockopt(c->fd, IPPROTO_TCP, TCP_CORK, &on, sizeof(on)) == 0) c->corked = on;
+}
+
+// Avanza n bytes sobre los segmentos de la respuesta pendiente
+static void conn_advance(conn_t *c, size_t n) {
+    while (n > 0 && c->out_seg < c->out.nsegs) {
+        size_t left = c->out.segs[c->out_seg].len - c->out_seg_sent;
+        if (n < left) {
+            c->out_seg_sent += n;
+            return;
+        }
+        n -= left;
+        c->out_seg++;
+        c->out_seg_sent = 0;
+    }
+}
+
+/* Envia lo que se pueda de la respuesta pendiente: los segmentos de memoria consecutivos
+ * con un solo writev y los rangos de archivo con sendfile (sin copiarlos al proceso).
+ * Retorna 0 (enviada completa o el socket esta lleno), -1 si hubo error */
+static int conn_flush(conn_t *c) {
+    while (conn_has_output(c)) {
+        response_seg_t *seg = &c->out.segs[c->out_seg];
+        ssize_t n;
+        if (seg->kind == RESP_SEG_MEM) {
+            struct iovec iov[FLUSH_MAX_IOV];
+            int iovcnt = 0;
+            for (size_t i = c->out_seg; i < c->out.nsegs && iovcnt < FLUSH_MAX_IOV; i++) {
+                const response_seg_t *s = &c->out.segs[i];
+                if (s->kind != RESP_SEG_MEM) break;
+                size_t skip = i == c->out_seg ? c->out_seg_sent : 0;
+                iov[iovcnt].iov_base = c->out.data + s->offset + skip;
+                iov[iovcnt].iov_len = s->len - skip;
+                iovcnt++;
+            }
+            n = writev(c->fd, iov, iovcnt);
+        } else {
+            if (!c->corked) conn_set_cork(c, 1);
+            off_t off = seg->offset + (off_t)c->out_seg_sent;
+            n = sendfile(c->fd, seg->fd, &off, seg->len - c->out_seg_sent);
+            if (n == 0) return -1; // El archivo es mas corto de lo esperado
+        }
+
+        if (n > 0) {
+            conn_advance(c, (size_t)n);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 0; // Se continua con EPOLLOUT
+        } else {
+            return -1;
+        }
+    }
+    conn_set_cork(c, 0); // Envia lo que quede en el ultimo paquete
+    response_free(&c->out); // No retener memoria en conexiones inactivas
+    c->out_seg = 0;
+    c->out_seg_sent = 0;
+    return 0;
+}
+
+static void pending_push(reactor_t *r, conn_t *c) {
+    c->next_pending = NULL;
+    if (r->pending_tail) r->pending_tail->next_pending = c;
+    else r->pending_head = c;
+    r->pending_tail = c;
+}
+
+// Reintenta encolar las peticiones que no cupieron en el pool, en orden de llegada
+static void pending_retry(reactor_t *r) {
+    while (r->pending_head) {
+        conn_t *c = r->pending_head;
+        if (worker_pool_try_submit(r->pool, c->pending) != 0) break;
+        c->pending = NULL;
+        r->pending_head = c->next_pending;
+        if (r->pending_head == NULL) r->pending_tail = NULL;
+    }
+}
+
+/* Saca la trama completa del inicio de rbuf y la entrega al pool.
+ * Retorna 0, o -1 si la trama es invalida o falta memoria */
+static int conn_dispatch(reactor_t *r, conn_t *c, size_t frame_len) {
+    uint32_t op_len, body_len;
+    memcpy(&op_len, c->rbuf, sizeof(op_len));
+    memcpy(&body_len, c->rbuf + sizeof(uint32_t) + op_len, sizeof(body_len));
+
+    proto_op_t op = proto_op_from_name(c->rbuf + sizeof(uint32_t), op_len);
+    if (op == OP_UNKNOWN) {
+        fprintf(stderr, "Operación desconocida: %.*s\n", (int)op_len, c->rbuf + sizeof(uint32_t));
+        return -1;
+    }
+
+    request_t *req = calloc(1, sizeof(*req));
+    if (req == NULL) {
+        perror("calloc");
+        return -1;
+    }
+    req->body = malloc(body_len ? body_len : 1);
+    if (req->body == NULL) {
+        perror("malloc");
+        free(req);
+        return -1;
+    }
+    memcpy(req->body, c->rbuf + frame_len - body_len, body_len);
+    req->body_len = body_len;
+    req->op = op;
+    req->conn = c;
+    req->reactor = r;
+    response_init(&req->resp);
+
+    // Consumir la trama del buffer de lectura
+    c->rlen -= frame_len;
+    if (c->rlen > 0) {
+        memmove(c->rbuf, c->rbuf + frame_len, c->rlen);
+    } else {
+        free(c->rbuf);
+        c->rbuf = NULL;
+        c->rcap = 0;
+    }
+
+    c->busy = 1; // Una peticion en curso por conexion: las respuestas salen en orden
+    int status = r->pending_head ? 1 : worker_pool_try_submit(r->pool, req);
+    if (status < 0) {
+        c->busy = 0;
+        request_free(req);
+        return -1;
+    }
+    if (status == 1) { // Cola del pool llena
+        c->pending = req;
+        pending_push(r, c);
+    }
+    return 0;
+}
+
+/* Avanza la maquina de estados de una conexion: enviar lo pendiente, leer, despachar tramas.
+ * Puede cerrar la conexion. */
+static void conn_process(reactor_t *r, conn_t *c) {
+    if (c->closed) return;
+    if (c->busy) return; // Se retoma cuando vuelva la respuesta del pool
+
+    if (conn_has_output(c)) {
+        if (conn_flush(c) < 0) {
+            conn_close(r, c);
+            return;
+        }
+        if (conn_has_output(c)) return; // Esperar EPOLLOUT
+    }
+
+    // Conexion persistente: las tramas siguientes (pipelining) ya pueden estar en rbuf o en el socket
+    if (conn_read(c) < 0) {
+        conn_close(r, c);
+        return;
+    }
+
+    ssize_t frame_len = frame_total_len(c);
+    if (frame_len < 0) {
+        conn_close(r, c);
+        return;
+    }
+    if (frame_len > 0 && c->rlen >= (size_t)frame_len) {
+        if (conn_dispatch(r, c, (size_t)frame_len) < 0) {
+            conn_close(r, c);
+        }
+        return;
+    }
+
+    if (c->peer_closed) { // Trama incompleta y el cliente ya no enviara mas
+        conn_close(r, c);
+    }
+}
+
+// Acepta todas las conexiones pendientes del socket de escucha
+static void reactor_accept(reactor_t *r) {
+    while (1) {
+        int fd = accept4(r->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("accept4");
+            return; // EMFILE/ENFILE: el socket de escucha es level-triggered, se reintenta luego
+        }
+
+        conn_t *c = calloc(1, sizeof(*c));
+        if (c == NULL) {
+            perror("calloc");
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->readable = 1; // Puede haber datos desde antes de registrarlo en epoll
+        response_init(&c->out);
+
+        // Las respuestas ya salen agrupadas (writev/TCP_CORK): no esperar ACKs para enviar el final
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        struct epoll_event ev = {.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, .data.ptr = c};
+        if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            perror("epoll_ctl (cliente)");
+            close(fd);
+            free(c);
+            continue;
+        }
+        r->num_conns++;
+        conn_process(r, c);
+    }
+}
+
+// Recoge las respuestas de los hilos de I/O y las envia
+static void reactor_drain_done(reactor_t *r) {
+    uint64_t counter;
+    if (read(r->event_fd, &counter, sizeof(counter)) < 0 && errno != EAGAIN) {
+        perror("read (eventfd)");
+    }
+
+    pthread_mutex_lock(&r->done_lock);
+    request_t *done = r->done;
+    r->done = NULL;
+    pthread_mutex_unlock(&r->done_lock);
+
+    pending_retry(r); // Los hilos ya liberaron espacio en la cola
+
+    while (done) {
+        request_t *req = done;
+        done = req->next;
+        conn_t *c = req->conn;
+        c->busy = 0;
+        if (req->status != 0) {
+            request_free(req);
+            conn_close(r, c);
+            continue;
+        }
+        response_free(&c->out);
+        c->out = req->resp; // La conexion toma la respuesta
+        c->out_seg = 0;
+        c->out_seg_sent = 0;
+        response_init(&req->resp);
+        request_free(req);
+        conn_process(r, c);
+    }
+}
+
+reactor_t *reactor_create(int listen_fd, int num_io_workers, const handler_config_t *cfg) {
+    reactor_t *r = calloc(1, sizeof(*r));
+    if (r == NULL) {
+        perror("calloc");
+        return NULL;
+    }
+    r->listen_fd = listen_fd;
+    r->epfd = -1;
+    r->event_fd = -1;
+    pthread_mutex_init(&r->done_lock, NULL);
+
+    r->epfd = epoll_create1(EPOLL_CLOEXEC);
+    r->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (r->epfd < 0 || r->event_fd < 0) {
+        perror("epoll_create1/eventfd");
+        reactor_destroy(r);
+        return NULL;
+    }
+
+    int flags = fcntl(listen_fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(listen_fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        perror("fcntl (O_NONBLOCK)");
+        reactor_destroy(r);
+        return NULL;
+    }
+
+    // El socket de escucha es level-triggered para no perder conexiones si se agotan los fds
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = &r->listen_fd};
+    struct epoll_event wake = {.events = EPOLLIN | EPOLLET, .data.ptr = &r->event_fd};
+    if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, listen_fd, &ev) < 0 ||
+        epoll_ctl(r->epfd, EPOLL_CTL_ADD, r->event_fd, &wake) < 0) {
+        perror("epoll_ctl");
+        reactor_destroy(r);
+        return NULL;
+    }
+
+    r->pool = worker_pool_create(num_io_workers, (size_t)num_io_workers * IO_QUEUE_PER_WORKER,
+                                 handler_ctx_init, handler_ctx_free, reactor_io_job, (void *)cfg);
+    if (r->pool == NULL) {
+        reactor_destroy(r);
+        return NULL;
+    }
+    return r;
+}
+
+int reactor_run(reactor_t *r) {
+    struct epoll_event events[MAX_EVENTS];
+    while (1) {
+        int n = epoll_wait(r->epfd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            return -1;
+        }
+        for (int i = 0; i < n; i++) {
+            void *tag = events[i].data.ptr;
+            if (tag == &r->listen_fd) {
+                reactor_accept(r);
+            } else if (tag == &r->event_fd) {
+                reactor_drain_done(r);
+            } else {
+                conn_t *c = tag;
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                    c->readable = 1;
+                }
+                conn_process(r, c);
+            }
+        }
+        reactor_free_closed(r);
+    }
+}
+
+void reactor_destroy(reactor_t *r) {
+    if (r == NULL) return;
+    worker_pool_destroy(r->pool); // Termina las peticiones en curso antes de liberar sus conexiones
+    request_t *done = r->done;
+    while (done) {
+        request_t *next = done->next;
+        request_free(done);
+        done = next;
+    }
+    reactor_free_closed(r);
+    if (r->epfd >= 0) close(r->epfd);
+    if (r->event_fd >= 0) close(r->event_fd);
+    pthread_mutex_destroy(&r->done_lock);
+    free(r);
+}
@@ -0,0 +1,24 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+/* Bucle de eventos (epoll, edge-triggered) que atiende todas las conexiones desde un solo hilo.
+ * Las tramas del protocolo se leen y se escriben de forma incremental con sockets no bloqueantes;
+ * cuando una peticion esta completa se entrega a un pool pequeño de hilos de I/O (ver handlers.h)
+ * que hace el trabajo de disco y devuelve la respuesta al reactor para que la envie.
+ */
+
+#include "handlers.h"
+
+typedef struct reactor reactor_t;
+
+/* Crea el reactor sobre un socket que ya esta en listen(). Abre num_io_workers hilos de I/O
+ * configurados con cfg (debe seguir valido mientras se crea el reactor; NULL = por defecto) */
+reactor_t *reactor_create(int listen_fd, int num_io_workers, const handler_config_t *cfg);
+
+/* Ejecuta el bucle de eventos. Solo retorna si ocurre un error fatal (-1) */
+int reactor_run(reactor_t *r);
+
+/* Detiene el pool de I/O (terminando las peticiones en curso) y libera el reactor */
+void reactor_destroy(reactor_t *r);
+
+#endif // REACTOR_H
@@ -1,13 +1,32 @@
+#define _GNU_SOURCE
 #include "reader.h"
 #include "buckets.h"
 #include "linked_list.h"
 #include "common.h"
 #include "hash.h"
 #include "util.h"
+#include "slots.h"
+#include "csv_scan.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define INDEX_ARENA_BLOCK_SIZE (64 * 1024) // Bloques del arena de cada busqueda
+#define SLOTS_LOOKUP_WINDOW 256            // Slots por pread en una busqueda (4 KiB)
+#define LOOKUP_ABSENT UINT64_MAX           // "Bucket" de una llave que el filtro de Bloom descarta
+#define RING_LOOKUP_BUCKETS 256            // Buckets por lote de lecturas con io_uring
+
+// Fin de las tablas del indice en title_buckets.dat (entradas de bucket, slots o tablas del motor static)
+static size_t table_end(const index_handle_t *h, const buckets_header_t *hdr) {
+    if (hdr->engine == BUCKETS_ENGINE_SLOTS) return BUCKETS_HEADER_SIZE + (size_t)hdr->num_buckets * SLOT_SIZE;
+    if (hdr->engine == BUCKETS_ENGINE_STATIC) return (size_t)h->mphf.postings_off + (size_t)h->mphf.postings_words * 8;
+    return (size_t)buckets_entry_offset(hdr->num_buckets);
+}
 
 // inserta en el handle (struct) la informacion del indice
 int index_open(index_handle_t *h, const char *buckets_path, const char *linked_list_path) {
@@ -15,97 +34,769 @@ int index_open(index_handle_t *h, const char *buckets_path, const char *linked_l
     if (bfd < 0) return -1;
     int afd = linked_list_open(linked_list_path);
     if (afd < 0) { close(bfd); return -1; }
+    h->node_buf = malloc(LINKED_LIST_MAX_NODE_SIZE);
+    if (h->node_buf == NULL) {
+        close(bfd);
+        close(afd);
+        return -1;
+    }
+    h->extent_buf = NULL;
+    h->extent_cap = 0;
+    h->csv_fd = -1;
+    h->record_buf = NULL;
+    h->record_cap = 0;
+    memset(&h->mphf, 0, sizeof(h->mphf));
+    h->bloom.words = NULL;
+    h->bloom.map = NULL;
+    h->pool = NULL;
+    h->ring = NULL;
+    pool_file_open(&h->buckets_pf, NULL, POOL_INDEX, bfd); // Sin pool no falla: lee directo del fd
+    pool_file_open(&h->nodes_pf, NULL, POOL_INDEX, afd);
+    pool_file_open(&h->csv_pf, NULL, POOL_RECORDS, -1);
+    snprintf(h->buckets_path, sizeof(h->buckets_path), "%s", buckets_path);
     h->buckets_fd = bfd; // Buckets file descriptor
     h->linked_list_fd = afd;  // Nodes file descriptor (linked_list)
+    h->buckets_map = NULL;
+    h->buckets_map_len = 0;
+    h->nodes_map = NULL;
+    h->nodes_map_len = 0;
+    arena_init(&h->arena, INDEX_ARENA_BLOCK_SIZE);
+    h->generation = buckets_generation();
+    if (buckets_read_header(bfd, &h->hdr) != 0 || linked_list_check_gen(afd, h->hdr.nodes_gen) != 0) {
+        index_close(h);
+        return -1;
+    }
+    if (h->hdr.engine == BUCKETS_ENGINE_STATIC && static_mphf_load(&h->mphf, bfd, &h->hdr) != 0) {
+        index_close(h);
+        return -1;
+    }
+    // Sin filtro (indice sin title_bloom.dat o de otra semilla) todas las busquedas leen el indice
+    bloom_map(&h->bloom, BLOOM_PATH, h->hdr.seed);
+    if (h->hdr.engine != BUCKETS_ENGINE_CHAIN) { // Slots y static no guardan las llaves
+        h->csv_fd = open(CSV_PATH, O_RDONLY | O_CLOEXEC);
+        if (h->csv_fd < 0) {
+            perror("open (CSV_PATH)");
+            index_close(h);
+            return -1;
+        }
+        pool_file_open(&h->csv_pf, NULL, POOL_RECORDS, h->csv_fd);
+    }
+    return 0;
+}
+
+int index_use_pool(index_handle_t *h, page_pool_t *pool) {
+    if (h->buckets_map != NULL || pool == NULL) return 0; // En modo mmap no hay pread
+    h->pool = pool;
+    if (pool_file_open(&h->buckets_pf, pool, POOL_INDEX, h->buckets_fd) != 0 ||
+        pool_file_open(&h->nodes_pf, pool, POOL_INDEX, h->linked_list_fd) != 0 ||
+        (h->csv_fd >= 0 && pool_file_open(&h->csv_pf, pool, POOL_RECORDS, h->csv_fd) != 0)) {
+        return -1;
+    }
+    return 0;
+}
+
+void index_use_ring(index_handle_t *h, io_ring_t *ring) {
+    if (h->buckets_map != NULL || h->buckets_pf.pool != NULL) return; // Sin pread propios del indice
+    h->ring = ring;
+}
+
+// Mapea un archivo completo en solo lectura. Retorna NULL si falla
+static const unsigned char *map_file(int fd, size_t *out_len) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) return NULL;
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+    // Los accesos son saltos aleatorios (buckets y nodos): el readahead solo traeria paginas que no se usan
+    posix_madvise(p, (size_t)st.st_size, POSIX_MADV_RANDOM);
+    *out_len = (size_t)st.st_size;
+    return p;
+}
+
+int index_open_mmap(index_handle_t *h, const char *buckets_path, const char *linked_list_path) {
+    if (index_open(h, buckets_path, linked_list_path) != 0) return -1;
+    h->buckets_map = map_file(h->buckets_fd, &h->buckets_map_len);
+    h->nodes_map = map_file(h->linked_list_fd, &h->nodes_map_len);
+    if (h->buckets_map == NULL || h->nodes_map == NULL ||
+        h->buckets_map_len < table_end(h, &h->hdr)) {
+        fprintf(stderr, "Error: no se pudo mapear el indice en memoria\n");
+        index_close(h);
+        return -1;
+    }
+    return 0;
+}
+
+/* Rehace el mapeo de nodos si el archivo crecio (build_index_line agrega nodos al final).
+ * Retorna 0 si el mapeo cambio, -1 si el archivo no crecio o falla mmap */
+static int nodes_remap(index_handle_t *h) {
+    struct stat st;
+    if (fstat(h->linked_list_fd, &st) != 0 || (size_t)st.st_size <= h->nodes_map_len) return -1;
+    size_t len = 0;
+    const unsigned char *p = map_file(h->linked_list_fd, &len);
+    if (p == NULL) return -1;
+    munmap((void *)h->nodes_map, h->nodes_map_len);
+    h->nodes_map = p;
+    h->nodes_map_len = len;
+    return 0;
+}
+
+/* Con el motor slots, una insercion que duplica la tabla la reemplaza con rename: si el archivo
+ * en buckets_path ya no es el abierto, se abre (y se mapea) el nuevo */
+static int reopen_if_replaced(index_handle_t *h) {
+    struct stat cur, path;
+    if (fstat(h->buckets_fd, &cur) != 0 || stat(h->buckets_path, &path) != 0) return -1;
+    if (cur.st_ino == path.st_ino && cur.st_dev == path.st_dev) return 0;
+    int fd = buckets_open_readwrite(h->buckets_path);
+    if (fd < 0) return -1;
+    if (h->buckets_map != NULL) {
+        size_t len = 0;
+        const unsigned char *p = map_file(fd, &len);
+        if (p == NULL) {
+            fprintf(stderr, "Error: no se pudo mapear la tabla de slots\n");
+            close(fd);
+            return -1;
+        }
+        munmap((void *)h->buckets_map, h->buckets_map_len);
+        h->buckets_map = p;
+        h->buckets_map_len = len;
+    }
+    close(h->buckets_fd);
+    h->buckets_fd = fd;
+    pool_file_close(&h->buckets_pf);
+    pool_file_open(&h->buckets_pf, h->pool, POOL_INDEX, fd); // Si falla, la tabla nueva se lee sin pool
+    return 0;
+}
+
+/* Relee el encabezado de la tabla (despues de un split). En modo mmap se lee del mapeo y, si la
+ * tabla crecio mas alla de el, se vuelve a mapear el archivo de buckets */
+static int refresh_header(index_handle_t *h, uint64_t generation) {
+    buckets_header_t hdr;
+    if (h->hdr.engine == BUCKETS_ENGINE_SLOTS && reopen_if_replaced(h) != 0) return -1;
+    if (h->buckets_map == NULL) {
+        if (buckets_read_header(h->buckets_fd, &hdr) != 0) return -1;
+    } else {
+        if (buckets_decode_header(h->buckets_map, &hdr) != 0) return -1;
+        size_t need = table_end(h, &hdr);
+        if (need > h->buckets_map_len) {
+            size_t len = 0;
+            const unsigned char *p = map_file(h->buckets_fd, &len);
+            if (p == NULL || len < need) {
+                if (p != NULL) munmap((void *)p, len);
+                fprintf(stderr, "Error: no se pudo mapear la tabla de buckets\n");
+                return -1;
+            }
+            munmap((void *)h->buckets_map, h->buckets_map_len);
+            h->buckets_map = p;
+            h->buckets_map_len = len;
+        }
+    }
+    h->hdr = hdr;
+    h->generation = generation;
+    return 0;
+}
+
+// Puntero a [off, off + len) dentro del mapeo de nodos, o NULL si el rango no existe en el archivo
+static const unsigned char *nodes_range(index_handle_t *h, off_t off, size_t len) {
+    if (off < 0) return NULL;
+    while ((size_t)off + len > h->nodes_map_len) {
+        if (nodes_remap(h) != 0) return NULL;
+    }
+    return h->nodes_map + off;
+}
+
+/* Lee un nodo por el pool de paginas en h->node_buf, como linked_list_read_node: una lectura de
+ * LINKED_LIST_READ_HINT bytes y otra por el resto si el nodo es mas largo */
+static int read_node_pooled(index_handle_t *h, off_t off, linked_list_node_t *node) {
+    ssize_t got = pool_file_pread(&h->nodes_pf, h->node_buf, LINKED_LIST_READ_HINT, off);
+    if (got < (ssize_t)LINKED_LIST_HEADER_SIZE) return -1;
+    if (linked_list_decode_node(h->node_buf, (size_t)got, node) != 0) return 0;
+    size_t full = linked_list_node_size(node->key_len, node->cap);
+    if (node->cap > LINKED_LIST_MAX_CAP || node->count > node->cap || full < (size_t)got) return -1;
+    size_t rest = full - (size_t)got;
+    if (pool_file_pread(&h->nodes_pf, h->node_buf + got, rest, off + got) != (ssize_t)rest) return -1;
+    return linked_list_decode_node(h->node_buf, full, node) != 0 ? 0 : -1;
+}
+
+// Lee un nodo del archivo de nodos (desde el mapeo, por el pool o con pread); la key no se copia
+static int read_node(index_handle_t *h, off_t off, linked_list_node_t *node) {
+    if (h->nodes_map == NULL && h->nodes_pf.pool != NULL) return read_node_pooled(h, off, node);
+    if (h->nodes_map == NULL) return linked_list_read_node(h->linked_list_fd, off, node, h->node_buf, NULL);
+
+    const unsigned char *p = nodes_range(h, off, LINKED_LIST_HEADER_SIZE);
+    if (p == NULL) return -1;
+    if (linked_list_decode_node(p, h->nodes_map_len - (size_t)off, node) != 0) return 0;
+    // El nodo termina fuera del mapeo actual: el archivo crecio desde que se mapeo
+    if (node->cap > LINKED_LIST_MAX_CAP) return -1;
+    p = nodes_range(h, off, linked_list_node_size(node->key_len, node->cap));
+    if (p == NULL) return -1;
+    return linked_list_decode_node(p, h->nodes_map_len - (size_t)off, node) != 0 ? 0 : -1;
+}
+
+// Lee la entrada de un bucket (desde el mapeo, por el pool o con pread)
+static int read_bucket_entry(index_handle_t *h, uint64_t bucket, bucket_entry_t *entry) {
+    if (h->buckets_map != NULL) {
+        buckets_decode_entry(h->buckets_map + buckets_entry_offset(bucket), entry);
+        return 0;
+    }
+    if (h->buckets_pf.pool == NULL) return buckets_read_entry(h->buckets_fd, bucket, entry);
+    unsigned char buf[BUCKET_ENTRY_SIZE];
+    if (pool_file_pread(&h->buckets_pf, buf, sizeof(buf), buckets_entry_offset(bucket)) != (ssize_t)sizeof(buf)) {
+        fprintf(stderr, "Error, no se pudo leer la entrada del bucket\n");
+        return -1;
+    }
+    buckets_decode_entry(buf, entry);
     return 0;
 }
 
 void index_close(index_handle_t *h) {
     if (h == NULL) return;
+    pool_file_close(&h->buckets_pf); // Antes de cerrar los fd que leen
+    pool_file_close(&h->nodes_pf);
+    pool_file_close(&h->csv_pf);
     close(h->buckets_fd);
     close(h->linked_list_fd);
     h->buckets_fd = -1;
     h -> linked_list_fd = -1;
+    free(h->node_buf);
+    h->node_buf = NULL;
+    free(h->extent_buf);
+    h->extent_buf = NULL;
+    h->extent_cap = 0;
+    if (h->csv_fd >= 0) close(h->csv_fd);
+    h->csv_fd = -1;
+    free(h->record_buf);
+    h->record_buf = NULL;
+    h->record_cap = 0;
+    static_mphf_free(&h->mphf);
+    bloom_free(&h->bloom);
+    if (h->buckets_map) munmap((void *)h->buckets_map, h->buckets_map_len);
+    if (h->nodes_map) munmap((void *)h->nodes_map, h->nodes_map_len);
+    h->buckets_map = NULL;
+    h->nodes_map = NULL;
+    arena_free(&h->arena);
 }
 
-int index_lookup(index_handle_t *h, const char *key, off_t **out_offsets, uint32_t *out_count) {
-    if (!h || !key || !out_offsets || !out_count) {
-        return -1;
-    }
-    *out_offsets = NULL;
-    *out_count = 0;
-
-    printf("Buscando: %s\n", key);
+// Clave de busqueda ya normalizada, con su bucket
+typedef struct {
+    char *nkey;        // Llave normalizada
+    size_t nkey_len;
+    uint64_t hash;
+    uint64_t bucket;
+    uint32_t idx;      // Posicion de la llave en la peticion original
+} lookup_key_t;
 
-    // Halla el bucket a partir del hash
-    uint64_t hval = hash_key_prefix(key, strlen(key), DEFAULT_HASH_SEED);
-    uint64_t mask = NUM_BUCKETS - 1;
-    uint64_t bucket = bucket_id_from_hash(hval, mask);
+// Agrega una entrada al array dinamico de resultados
+static int result_push(index_result_t *res, uint32_t *cap, off_t offset, uint32_t length) {
+    if (res->count >= *cap) { // Si se excede el tamaño del array dinamico, realocar con doble de tamaño
+        uint32_t new_cap = *cap ? *cap * 2 : 16;
+        index_entry_t *tmp = realloc(res->entries, sizeof(index_entry_t) * new_cap);
+        if (tmp == NULL) return -1;
+        res->entries = tmp;
+        *cap = new_cap;
+    }
+    res->entries[res->count].offset = offset;
+    res->entries[res->count].length = length;
+    res->count++;
+    return 0;
+}
 
-    // Obtiene el offset de la cabeza de la lista enlazada
-    off_t head = buckets_read_head(h->buckets_fd, bucket); 
-    
-    if (head == 0) { // offset 0 representa null
-        fprintf(stderr, "Error: No se pudo leer el bucket\n");
-        return 0;
+// Compara un nodo contra las llaves del bucket y agrega sus filas (la mas reciente primero) a las que coinciden
+// Con un hash de prefijo la consulta coincide con las llaves que empiezan con ella; si no, con la misma llave
+static int match_node(const linked_list_node_t *node, const lookup_key_t *keys, size_t nkeys, int prefix,
+                      index_result_t *results, uint32_t *caps) {
+    for (size_t k = 0; k < nkeys; k++) {
+        // Primero la huella: casi todos los nodos de una cadena con colisiones se descartan aqui
+        if (node->hash != keys[k].hash) continue;
+        // nota: node->key ya es una llave normalizada (sin '\0' en el buffer)
+        if ((prefix ? node->key_len >= keys[k].nkey_len : node->key_len == keys[k].nkey_len) &&
+            memcmp(node->key, keys[k].nkey, keys[k].nkey_len) == 0) {
+            uint32_t idx = keys[k].idx;
+            for (uint32_t i = node->count; i > 0; i--) {
+                off_t offset;
+                uint32_t record_len;
+                linked_list_posting_get(node, i - 1, &offset, &record_len);
+                if (result_push(&results[idx], &caps[idx], offset, record_len) != 0) return -1;
+            }
+        }
     }
+    return 0;
+}
 
-    // Array dinamico de resultados
-    uint32_t cap = 16; // Capacidad del array de resultados
-    uint32_t cnt = 0;  // Numero de resultados
+static int entry_newest_cmp(const void *a, const void *b) {
+    const index_entry_t *x = a, *y = b;
+    return (x->offset < y->offset) - (x->offset > y->offset);
+}
 
-    off_t *results = malloc(sizeof(off_t) * cap);
-    if (results == NULL) return -1;
-    
-    off_t cur = head; 
-    char *normalized_key = normalize_string(key); // Solo usamos la llave normalizada
-    if (!normalized_key){
-        free(normalized_key);
-        return -1;
+/* Una llave de busqueda puede coincidir con varios nodos (prefijos, o varios nodos de la misma
+ * llave en la lista enlazada): sus filas se ordenan de la mas reciente a la mas antigua, el orden
+ * que tendria una lista con un nodo por fila */
+static void sort_newest_first(index_result_t *res) {
+    for (uint32_t i = 1; i < res->count; i++) {
+        if (res->entries[i].offset > res->entries[i - 1].offset) {
+            qsort(res->entries, res->count, sizeof(index_entry_t), entry_newest_cmp);
+            return;
+        }
     }
-    size_t nkey_len = strlen(normalized_key);
+}
+
+/* Recorre una vez los nodos de un bucket comparando cada nodo contra todas las
+ * llaves (distintas) que caen en ese bucket: primero la lista enlazada (nodos agregados
+ * despues de compactar) y luego el extent, que se lee completo con un solo pread (salvo que
+ * ya venga leido en extent_data). Las entradas de cada llave se agregan a results[key.idx].
+ * Retorna 0, o -1 si falla malloc */
+static int walk_nodes(index_handle_t *h, const bucket_entry_t *entry, const unsigned char *extent_data,
+                      const lookup_key_t *keys, size_t nkeys, index_result_t *results, uint32_t *caps) {
+    off_t cur = entry->head;
     while (cur != 0) { // Recorre la lista enlazada
-        linked_list_node_t node = {.key_len = 0, .key = NULL, .entry_offset = 0, .next_ptr = 0};
-        if (linked_list_read_node(h->linked_list_fd, cur, &node) != 0) { // Lee los datos del nodo
+        linked_list_node_t node = {.hash = 0, .next_ptr = 0, .count = 0, .cap = 0, .key_len = 0, .key = NULL, .postings = NULL};
+        // Lee el nodo (un pread, o directo del mapeo); la key no se copia ni se hace malloc
+        if (read_node(h, cur, &node) != 0) {
             fprintf(stderr, "Error, no se pudo leer los datos del nodo\n");
             break;
         }
+        if (match_node(&node, keys, nkeys, hash_is_prefix(h->hdr.hash), results, caps) != 0) return -1;
+        cur = node.next_ptr;
+    }
+
+    if (entry->extent_len == 0) return 0;
+    const unsigned char *extent = extent_data; // Leido junto con los de otros buckets (walk_buckets_ring)
+    if (extent == NULL && h->nodes_map != NULL) { // El extent se recorre directo en el mapeo
+        extent = nodes_range(h, entry->extent_off, entry->extent_len);
+        if (extent == NULL) {
+            fprintf(stderr, "Error, el extent del bucket esta fuera del archivo de nodos\n");
+            return 0;
+        }
+    } else if (extent == NULL) {
+        if (entry->extent_len > h->extent_cap) { // El buffer del extent crece segun el bucket mas grande leido
+            unsigned char *tmp = realloc(h->extent_buf, entry->extent_len);
+            if (tmp == NULL) return -1;
+            h->extent_buf = tmp;
+            h->extent_cap = entry->extent_len;
+        }
+        if (pool_file_pread(&h->nodes_pf, h->extent_buf, entry->extent_len, entry->extent_off) != (ssize_t)entry->extent_len) {
+            fprintf(stderr, "Error, no se pudo leer el extent del bucket\n");
+            return 0;
+        }
+        extent = h->extent_buf;
+    }
+    size_t pos = 0;
+    for (uint32_t i = 0; i < entry->extent_count; i++) { // Los nodos del extent estan seguidos
+        linked_list_node_t node;
+        size_t size = linked_list_decode_node(extent + pos, entry->extent_len - pos, &node);
+        if (size == 0) {
+            fprintf(stderr, "Error, extent corrupto\n");
+            break;
+        }
+        if (match_node(&node, keys, nkeys, hash_is_prefix(h->hdr.hash), results, caps) != 0) return -1;
+        pos += size;
+    }
+    return 0;
+}
+
+// walk_nodes y, para cada llave, sus filas de la mas reciente a la mas antigua
+static int walk_bucket(index_handle_t *h, const bucket_entry_t *entry, const unsigned char *extent_data,
+                       const lookup_key_t *keys, size_t nkeys, index_result_t *results, uint32_t *caps) {
+    if (walk_nodes(h, entry, extent_data, keys, nkeys, results, caps) != 0) return -1;
+    for (size_t k = 0; k < nkeys; k++) sort_newest_first(&results[keys[k].idx]);
+    return 0;
+}
+
+/* ---- Motor slots ---- */
+
+// Ventana de slots leida con pread (en h->extent_buf)
+typedef struct {
+    uint64_t first;
+    uint64_t count;
+} slot_window_t;
+
+// Lee el slot pos (desde el mapeo, o de la ventana, que se vuelve a leer si pos queda fuera)
+static int read_slot(index_handle_t *h, uint64_t pos, slot_window_t *w, slot_t *slot) {
+    if (h->buckets_map != NULL) {
+        slots_decode(h->buckets_map + BUCKETS_HEADER_SIZE + pos * SLOT_SIZE, slot);
+        return 0;
+    }
+    if (pos < w->first || pos >= w->first + w->count) {
+        size_t cap = SLOTS_LOOKUP_WINDOW * SLOT_SIZE;
+        if (h->extent_cap < cap) {
+            unsigned char *tmp = realloc(h->extent_buf, cap);
+            if (tmp == NULL) return -1;
+            h->extent_buf = tmp;
+            h->extent_cap = cap;
+        }
+        // Desde el inicio del grupo de 64 bytes del slot, sin pasar del final de la tabla
+        w->first = pos & ~(uint64_t)(SLOTS_PER_GROUP - 1);
+        w->count = h->hdr.num_buckets - w->first < SLOTS_LOOKUP_WINDOW ? h->hdr.num_buckets - w->first : SLOTS_LOOKUP_WINDOW;
+        size_t len = (size_t)w->count * SLOT_SIZE;
+        if (pool_file_pread(&h->buckets_pf, h->extent_buf, len, BUCKETS_HEADER_SIZE + (off_t)w->first * SLOT_SIZE) != (ssize_t)len) {
+            w->count = 0;
+            return -1;
+        }
+    }
+    slots_decode(h->extent_buf + (pos - w->first) * SLOT_SIZE, slot);
+    return 0;
+}
+
+/* Slots y static solo guardan el hash. Si cubre solo los primeros KEY_PREFIX_LEN bytes, una llave
+ * mas larga se confirma leyendo el titulo del registro en el csv (con un hash de la llave completa
+ * alcanza con el hash, como con las llaves cortas). Retorna 1 si coincide, 0 si no */
+static int csv_confirms(index_handle_t *h, off_t offset, uint32_t record_len, const lookup_key_t *key) {
+    if (key->nkey_len <= KEY_PREFIX_LEN || !hash_is_prefix(h->hdr.hash)) return 1;
+    if (record_len > h->record_cap) {
+        unsigned char *tmp = realloc(h->record_buf, record_len);
+        if (tmp == NULL) return 0;
+        h->record_buf = tmp;
+        h->record_cap = record_len;
+    }
+    if (pool_file_pread(&h->csv_pf, h->record_buf, record_len, offset) != (ssize_t)record_len) return 0;
+    csv_field_t title;
+    int found;
+    csv_scan_record((const char *)h->record_buf, record_len, 0, TITLE_FIELD, &title, &found);
+    if (!found) return 0;
+    char *normalized = csv_field_normalized(&title);
+    if (normalized == NULL) return 0;
+    int match = strlen(normalized) >= key->nkey_len && memcmp(normalized, key->nkey, key->nkey_len) == 0;
+    free(normalized);
+    return match;
+}
+
+/* Recorre los slots desde home (el bucket de las llaves) hasta un slot vacio o con una entrada
+ * mas cerca de su home que la distancia recorrida: ahi ya no puede estar ninguna de las llaves */
+static int walk_slots(index_handle_t *h, uint64_t home, const lookup_key_t *keys, size_t nkeys,
+                      index_result_t *results, uint32_t *caps) {
+    uint64_t n = h->hdr.num_buckets;
+    slot_window_t w = {.first = 0, .count = 0};
+    for (uint64_t dist = 0; dist < n; dist++) {
+        uint64_t pos = (home + dist) & (n - 1);
+        slot_t slot;
+        if (read_slot(h, pos, &w, &slot) != 0) {
+            fprintf(stderr, "Error, no se pudo leer la tabla de slots\n");
+            return 0;
+        }
+        if (slot.record_len == 0 || slots_distance(slot.hash, pos, n) < dist) break;
+        for (size_t k = 0; k < nkeys; k++) {
+            if (slot.hash != keys[k].hash || !csv_confirms(h, slot.offset, slot.record_len, &keys[k])) continue;
+            uint32_t idx = keys[k].idx;
+            if (result_push(&results[idx], &caps[idx], slot.offset, slot.record_len) != 0) return -1;
+        }
+    }
+    return 0;
+}
+
+/* ---- Motor static ---- */
+
+// Agrega a las llaves con ese hash una fila (confirmada en el csv si hace falta)
+static int push_static(index_handle_t *h, uint64_t hash, off_t offset, uint32_t record_len, const lookup_key_t *keys,
+                       size_t nkeys, index_result_t *results, uint32_t *caps) {
+    for (size_t k = 0; k < nkeys; k++) {
+        if (keys[k].hash != hash || !csv_confirms(h, offset, record_len, &keys[k])) continue;
+        uint32_t idx = keys[k].idx;
+        if (result_push(&results[idx], &caps[idx], offset, record_len) != 0) return -1;
+    }
+    return 0;
+}
+
+/* Lee la entrada idx de la tabla de llaves (el bucket de las llaves segun el hash perfecto):
+ * con una sola fila es la unica lectura; si no, se lee su lista del area de postings */
+static int walk_static(index_handle_t *h, uint64_t idx, const lookup_key_t *keys, size_t nkeys,
+                       index_result_t *results, uint32_t *caps) {
+    if (idx >= h->mphf.nkeys) return 0; // Ninguna llave del indice
+    unsigned char buf[STATIC_KEY_SIZE];
+    const unsigned char *raw = buf;
+    if (h->buckets_map != NULL) {
+        raw = h->buckets_map + static_key_offset(&h->mphf, idx);
+    } else if (pool_file_pread(&h->buckets_pf, buf, sizeof(buf), static_key_offset(&h->mphf, idx)) != (ssize_t)sizeof(buf)) {
+        fprintf(stderr, "Error, no se pudo leer la tabla de llaves\n");
+        return 0;
+    }
+    static_key_t key;
+    static_key_decode(raw, &key);
+    size_t k = 0;
+    while (k < nkeys && keys[k].hash != key.hash) k++;
+    if (k == nkeys) return 0; // El hash perfecto dio el indice de otra llave
+    if (key.record_len != 0) return push_static(h, key.hash, key.offset, key.record_len, keys, nkeys, results, caps);
+
+    // Varias filas: [count][filas...] en el area de postings
+    off_t list_off = h->mphf.postings_off + (off_t)key.postings * 8;
+    uint64_t count = 0;
+    const unsigned char *list;
+    if (key.postings < h->mphf.postings_words) {
+        if (h->buckets_map != NULL) {
+            memcpy(&count, h->buckets_map + list_off, 8);
+        } else if (pool_file_pread(&h->buckets_pf, &count, 8, list_off) != 8) {
+            fprintf(stderr, "Error, no se pudo leer la lista de la llave\n");
+            return 0;
+        }
+    }
+    if (count == 0 || count > h->mphf.postings_words - key.postings - 1) {
+        fprintf(stderr, "Error, lista de la llave corrupta\n");
+        return 0;
+    }
+    if (h->buckets_map != NULL) {
+        list = h->buckets_map + list_off + 8;
+    } else {
+        size_t len = (size_t)count * 8;
+        if (len > h->extent_cap) {
+            unsigned char *tmp = realloc(h->extent_buf, len);
+            if (tmp == NULL) return -1;
+            h->extent_buf = tmp;
+            h->extent_cap = len;
+        }
+        if (pool_file_pread(&h->buckets_pf, h->extent_buf, len, list_off + 8) != (ssize_t)len) {
+            fprintf(stderr, "Error, no se pudo leer la lista de la llave\n");
+            return 0;
+        }
+        list = h->extent_buf;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        off_t offset;
+        uint32_t record_len;
+        static_posting_decode(list + i * 8, &offset, &record_len);
+        if (push_static(h, key.hash, offset, record_len, keys, nkeys, results, caps) != 0) return -1;
+    }
+    return 0;
+}
+
+// Llaves distintas de lk[i, j) (todas del mismo bucket) en group; retorna cuantas son
+static size_t bucket_group(const lookup_key_t *lk, size_t i, size_t j, lookup_key_t *group) {
+    size_t ngroup = 0;
+    for (size_t k = i; k < j; k++) {
+        if (k > i && lk[k].hash == lk[k - 1].hash && strcmp(lk[k].nkey, lk[k - 1].nkey) == 0) {
+            continue; // Llave repetida
+        }
+        group[ngroup++] = lk[k];
+    }
+    return ngroup;
+}
+
+/* Motor chain con io_uring: recorre los buckets de lk[0, nkeys) (ordenadas por bucket) por lotes
+ * de RING_LOOKUP_BUCKETS. En cada lote se leen juntas las entradas de todos sus buckets y despues
+ * juntos sus extents (seguidos en h->extent_buf); los nodos de las listas enlazadas (agregados
+ * despues de compactar) se siguen leyendo uno por uno. Retorna 0, o -1 si falla malloc */
+static int walk_buckets_ring(index_handle_t *h, const lookup_key_t *lk, size_t nkeys, lookup_key_t *group,
+                             index_result_t *results, uint32_t *caps) {
+    size_t max = nkeys < RING_LOOKUP_BUCKETS ? nkeys : RING_LOOKUP_BUCKETS;
+    size_t *starts = arena_alloc(&h->arena, sizeof(size_t) * (max + 1));
+    unsigned char *raw = arena_alloc(&h->arena, max * BUCKET_ENTRY_SIZE);
+    bucket_entry_t *entries = arena_alloc(&h->arena, sizeof(bucket_entry_t) * max);
+    io_read_t *entry_reads = arena_alloc(&h->arena, sizeof(io_read_t) * max);
+    io_read_t *extent_reads = arena_alloc(&h->arena, sizeof(io_read_t) * max);
+    if (starts == NULL || raw == NULL || entries == NULL || entry_reads == NULL || extent_reads == NULL) return -1;
+
+    size_t i = 0;
+    while (i < nkeys && lk[i].bucket != LOOKUP_ABSENT) {
+        size_t nb = 0, j = i;
+        while (j < nkeys && lk[j].bucket != LOOKUP_ABSENT && nb < max) {
+            starts[nb++] = j;
+            uint64_t bucket = lk[j].bucket;
+            while (j < nkeys && lk[j].bucket == bucket) j++;
+        }
+        starts[nb] = j;
+
+        // Primer viaje: las entradas de los buckets del lote
+        for (size_t b = 0; b < nb; b++) {
+            entry_reads[b] = (io_read_t){.fd = h->buckets_fd, .buf = raw + b * BUCKET_ENTRY_SIZE,
+                                         .len = BUCKET_ENTRY_SIZE, .offset = buckets_entry_offset(lk[starts[b]].bucket)};
+        }
+        io_read_batch(h->ring, entry_reads, nb);
+
+        // Segundo viaje: sus extents
+        size_t total = 0;
+        for (size_t b = 0; b < nb; b++) {
+            if (entry_reads[b].result != BUCKET_ENTRY_SIZE) continue;
+            buckets_decode_entry(raw + b * BUCKET_ENTRY_SIZE, &entries[b]);
+            total += entries[b].extent_len;
+        }
+        if (total > h->extent_cap) {
+            unsigned char *tmp = realloc(h->extent_buf, total);
+            if (tmp == NULL) return -1;
+            h->extent_buf = tmp;
+            h->extent_cap = total;
+        }
+        size_t nx = 0, pos = 0;
+        for (size_t b = 0; b < nb; b++) {
+            if (entry_reads[b].result != BUCKET_ENTRY_SIZE || entries[b].extent_len == 0) continue;
+            extent_reads[nx++] = (io_read_t){.fd = h->linked_list_fd, .buf = h->extent_buf + pos,
+                                             .len = entries[b].extent_len, .offset = entries[b].extent_off};
+            pos += entries[b].extent_len;
+        }
+        io_read_batch(h->ring, extent_reads, nx);
 
-        off_t next = node.next_ptr; 
-        printf("Leyendo nodo con key %s\n", node.key); //.
-
-        if (node.key) { 
-            printf("Read: %s\n", node.key); //
-            if (strncmp(node.key, normalized_key,nkey_len) == 0) { // nota: node.key ya es una llave normalizada
-                if (cnt >= cap) { // Si se excede el tamaño del array dinamico, realocar con doble de tamaño
-                    uint32_t new_cap = cap * 2;
-                    off_t *tmp = realloc(results, sizeof(off_t) * new_cap); // Copia del array con doble de tamaño
-                    if (tmp == NULL) {
-                        linked_list_free_node(&node);
-                        free(results);
-                        return -1;
-                    }
-                    results = tmp;
-                    cap = new_cap;
+        // Recorrer cada bucket con su extent ya leido
+        size_t x = 0;
+        for (size_t b = 0; b < nb; b++) {
+            if (entry_reads[b].result != BUCKET_ENTRY_SIZE) {
+                fprintf(stderr, "Error, no se pudo leer la entrada del bucket\n");
+                continue;
+            }
+            const unsigned char *extent = NULL;
+            if (entries[b].extent_len > 0) {
+                const io_read_t *rd = &extent_reads[x++];
+                if (rd->result == (ssize_t)rd->len) {
+                    extent = rd->buf;
+                } else { // Como con pread: se recorre solo la lista enlazada
+                    fprintf(stderr, "Error, no se pudo leer el extent del bucket\n");
+                    entries[b].extent_len = 0;
                 }
-                results[cnt] = node.entry_offset;
-                cnt++;
             }
+            size_t ngroup = bucket_group(lk, starts[b], starts[b + 1], group);
+            if (walk_bucket(h, &entries[b], extent, group, ngroup, results, caps) != 0) return -1;
         }
+        i = j;
+    }
+    return 0;
+}
+
+// Orden de las llaves: por bucket (lecturas en orden en el disco), luego por llave
+static int lookup_key_cmp(const void *a, const void *b) {
+    const lookup_key_t *ka = a, *kb = b;
+    if (ka->bucket != kb->bucket) return ka->bucket < kb->bucket ? -1 : 1;
+    if (ka->hash != kb->hash) return ka->hash < kb->hash ? -1 : 1;
+    int c = strcmp(ka->nkey, kb->nkey);
+    if (c != 0) return c;
+    return ka->idx < kb->idx ? -1 : (ka->idx > kb->idx);
+}
 
-        /* free node buffers */
-        linked_list_free_node(&node);
-        cur = next;
+// Una pasada de index_lookup_many con el encabezado actual del handle
+static int lookup_many_once(index_handle_t *h, const char *const *keys, uint32_t nkeys, index_result_t *results) {
+    for (uint32_t i = 0; i < nkeys; i++) {
+        results[i].entries = NULL;
+        results[i].count = 0;
     }
+    if (nkeys == 0) return 0;
+    arena_reset(&h->arena); // Los arrays de la busqueda anterior ya no se usan
 
-    free(normalized_key);
-    if (cnt == 0) {
-        free(results);
-        *out_offsets = NULL;
-        *out_count = 0;
-    } else {
-        *out_offsets = results;
-        *out_count = cnt;
+    // Arrays de trabajo de la busqueda: viven en el arena del handle (sin malloc por busqueda)
+    lookup_key_t *lk = arena_alloc(&h->arena, sizeof(lookup_key_t) * nkeys);
+    uint32_t *caps = arena_alloc(&h->arena, sizeof(uint32_t) * nkeys); // Capacidad del array de resultados de cada llave
+    lookup_key_t *group = arena_alloc(&h->arena, sizeof(lookup_key_t) * nkeys);
+    if (lk == NULL || caps == NULL || group == NULL) {
+        return -1;
+    }
+    memset(lk, 0, sizeof(lookup_key_t) * nkeys);
+    memset(caps, 0, sizeof(uint32_t) * nkeys);
+
+    int status = 0;
+    for (uint32_t i = 0; i < nkeys; i++) {
+        lk[i].idx = i;
+        // Solo usamos la llave normalizada: se escribe en el arena, sin malloc por llave
+        size_t key_len = keys[i] ? strlen(keys[i]) : 0;
+        lk[i].nkey = arena_alloc(&h->arena, key_len + 1);
+        if (lk[i].nkey == NULL) {
+            status = -1;
+            goto cleanup;
+        }
+        lk[i].nkey_len = normalize_into(keys[i] ? keys[i] : "", key_len, lk[i].nkey);
+        // Halla el bucket a partir del hash
+        lk[i].hash = buckets_hash_key(&h->hdr, lk[i].nkey, lk[i].nkey_len);
+        if (!bloom_may_contain(&h->bloom, lk[i].hash)) {
+            lk[i].bucket = LOOKUP_ABSENT; // Seguro no esta: no se lee nada del indice
+        } else {
+            lk[i].bucket = h->hdr.engine == BUCKETS_ENGINE_STATIC ? static_mphf_lookup(&h->mphf, lk[i].hash)
+                                                                  : buckets_bucket_of(&h->hdr, lk[i].hash);
+        }
+    }
+
+    // Ordenar por bucket: las cabezas se leen en orden creciente y cada cadena se recorre una sola vez
+    qsort(lk, nkeys, sizeof(lookup_key_t), lookup_key_cmp);
+
+    // group: llaves distintas de un mismo bucket (las repetidas se resuelven despues copiando resultados)
+    size_t i = 0;
+    if (h->hdr.engine == BUCKETS_ENGINE_CHAIN && h->ring != NULL) { // Todos los buckets, por lotes de lecturas juntas
+        if (walk_buckets_ring(h, lk, nkeys, group, results, caps) != 0) {
+            status = -1;
+            goto cleanup;
+        }
+        i = nkeys;
+    }
+    while (i < nkeys) {
+        uint64_t bucket = lk[i].bucket;
+        size_t j = i;
+        if (bucket == LOOKUP_ABSENT) break; // Ordenadas al final: el resto tampoco esta
+        while (j < nkeys && lk[j].bucket == bucket) j++;
+        size_t ngroup = bucket_group(lk, i, j, group);
+
+        if (h->hdr.engine != BUCKETS_ENGINE_CHAIN) { // Slot home, o entrada de la tabla de llaves del motor static
+            int walked = h->hdr.engine == BUCKETS_ENGINE_SLOTS ? walk_slots(h, bucket, group, ngroup, results, caps)
+                                                               : walk_static(h, bucket, group, ngroup, results, caps);
+            if (walked != 0) {
+                status = -1;
+                goto cleanup;
+            }
+            i = j;
+            continue;
+        }
+        // Lee la entrada del bucket: cabeza de la lista enlazada (offset 0 representa null) y extent
+        bucket_entry_t entry;
+        if (read_bucket_entry(h, bucket, &entry) == 0 &&
+            walk_bucket(h, &entry, NULL, group, ngroup, results, caps) != 0) {
+            status = -1;
+            goto cleanup;
+        }
+        i = j;
+    }
+
+    // Las llaves repetidas reciben una copia de los resultados de la primera aparicion
+    for (size_t k = 1; k < nkeys; k++) {
+        if (lk[k].bucket == lk[k - 1].bucket && lk[k].hash == lk[k - 1].hash &&
+            strcmp(lk[k].nkey, lk[k - 1].nkey) == 0) {
+            index_result_t *src = &results[lk[k - 1].idx]; // Ya resuelta (orden estable por idx)
+            index_result_t *dst = &results[lk[k].idx];
+            if (src->count == 0) continue;
+            dst->entries = malloc(sizeof(index_entry_t) * src->count);
+            if (dst->entries == NULL) {
+                status = -1;
+                goto cleanup;
+            }
+            memcpy(dst->entries, src->entries, sizeof(index_entry_t) * src->count);
+            dst->count = src->count;
+        }
+    }
+
+cleanup:
+    if (status != 0) index_results_free(results, nkeys);
+    return status;
+}
+
+int index_lookup_many(index_handle_t *h, const char *const *keys, uint32_t nkeys, index_result_t *results) {
+    if (!h || (!keys && nkeys > 0) || (!results && nkeys > 0)) {
+        return -1;
+    }
+    for (;;) {
+        uint64_t generation = buckets_generation();
+        if (generation & 1) { // Un split esta a medias
+            sched_yield();
+            continue;
+        }
+        if (generation != h->generation && refresh_header(h, generation) != 0) return -1;
+        int status = lookup_many_once(h, keys, nkeys, results);
+        if (status != 0 || buckets_generation() == generation) return status;
+        index_results_free(results, nkeys); // La tabla cambio durante la busqueda
     }
+}
+
+void index_results_free(index_result_t *results, uint32_t nkeys) {
+    if (results == NULL) return;
+    for (uint32_t i = 0; i < nkeys; i++) {
+        free(results[i].entries);
+        results[i].entries = NULL;
+        results[i].count = 0;
+    }
+}
+
+int index_lookup(index_handle_t *h, const char *key, index_entry_t **out_entries, uint32_t *out_count) {
+    if (!h || !key || !out_entries || !out_count) {
+        return -1;
+    }
+    *out_entries = NULL;
+    *out_count = 0;
+
+    printf("Buscando: %s\n", key);
+
+    index_result_t result;
+    if (index_lookup_many(h, &key, 1, &result) != 0) return -1;
+    *out_entries = result.entries;
+    *out_count = result.count;
     return 0;
 }
@@ -2,20 +2,88 @@
 #define READER_H
 
 #include "common.h"
+#include "arena.h"
+#include "buckets.h"
+#include "static_index.h"
+#include "bloom.h"
+#include "page_pool.h"
+#include "io_ring.h"
 
-// index_handle_t
+// index_handle_t (uno por hilo: el buffer de nodos y el arena no se comparten)
 typedef struct {
     int buckets_fd;
     int linked_list_fd;
+    unsigned char *node_buf; // Buffer reutilizable para leer nodos (LINKED_LIST_MAX_NODE_SIZE bytes)
+    unsigned char *extent_buf; // Buffer para leer el extent de un bucket (crece segun haga falta)
+    size_t extent_cap;
+    arena_t arena;           // Memoria de trabajo de la busqueda en curso (se reinicia en cada busqueda)
+    // Modo mmap (index_open_mmap): si buckets_map != NULL las lecturas no hacen syscalls
+    const unsigned char *buckets_map;
+    size_t buckets_map_len;
+    const unsigned char *nodes_map;
+    size_t nodes_map_len;    // Bytes mapeados de title_linked_list.dat (crece si el archivo crece)
+    buckets_header_t hdr;    // Numero de buckets y semilla (se relee si un split cambia la tabla)
+    uint64_t generation;     // buckets_generation() cuando se leyo hdr
+    // Motor slots: la tabla se vuelve a abrir si se reemplaza al duplicarse (ver slots.h)
+    char buckets_path[1024];
+    int csv_fd;              // Para confirmar llaves mas largas que KEY_PREFIX_LEN (-1 con el motor chain)
+    unsigned char *record_buf; // Registro del csv que se esta confirmando
+    size_t record_cap;
+    static_mphf_t mphf;      // Motor static: hash perfecto (en memoria) y ubicacion de las tablas
+    bloom_t bloom;           // Filtro de Bloom mapeado (words = NULL si el indice no tiene uno)
+    // Lecturas con pread del indice y del csv: por el pool de paginas si hay uno (index_use_pool)
+    page_pool_t *pool;
+    pool_file_t buckets_pf;
+    pool_file_t nodes_pf;
+    pool_file_t csv_pf;
+    io_ring_t *ring;         // io_uring del hilo (index_use_ring); NULL = un pread tras otro
 } index_handle_t;
 
 /* Open an index given paths to buckets and linked_list files */
 int index_open(index_handle_t *h, const char *buckets_path, const char *linked_list_path);
 
+/* Igual que index_open, pero mapea los dos archivos en memoria (solo lectura, MAP_SHARED).
+ * Las busquedas leen directo del page cache sin pread. Los nodos que build_index_line agrega
+ * despues de abrir se ven porque el mapeo de nodos se rehace cuando un offset cae fuera de el */
+int index_open_mmap(index_handle_t *h, const char *buckets_path, const char *linked_list_path);
+
+/* Hace que las lecturas con pread del handle (buckets, slots, nodos y registros del csv que se
+ * confirman) pasen por el pool de paginas. Llamar una vez, despues de index_open; en modo mmap no
+ * cambia nada. Retorna 0, o -1 si falla (el handle sigue leyendo sin pool) */
+int index_use_pool(index_handle_t *h, page_pool_t *pool);
+
+/* Con el motor chain y lecturas con pread, index_lookup_many lee con el anillo (que sigue siendo
+ * del llamador) en dos viajes por lote de buckets: las entradas de todos los buckets del lote en
+ * vuelo a la vez, y despues todos sus extents. En modo mmap o con el pool de paginas del indice
+ * no cambia nada */
+void index_use_ring(index_handle_t *h, io_ring_t *ring);
+
 /* Close index */
 void index_close(index_handle_t *h);
 
-/* Lookup key: returns array of offsets (malloc'd) and count via out_count. Caller frees *out_offsets. */
-int index_lookup(index_handle_t *h, const char *key, off_t **out_offsets, uint32_t *out_count);
+/* Linea del CSV que coincide con una llave: se puede leer con un solo pread exacto */
+typedef struct {
+    off_t offset;    // Offset de la linea en el CSV
+    uint32_t length; // Bytes de la linea (incluyendo '\n')
+} index_entry_t;
+
+/* Resultado de una llave: entradas (malloc'd) de las lineas del CSV */
+typedef struct {
+    index_entry_t *entries;
+    uint32_t count;
+} index_result_t;
+
+/* Lookup key: returns array of entries (malloc'd) and count via out_count. Caller frees *out_entries. */
+int index_lookup(index_handle_t *h, const char *key, index_entry_t **out_entries, uint32_t *out_count);
+
+/* Lookup de nkeys llaves a la vez: results[i] recibe las entradas de keys[i].
+ * Las llaves que el filtro de Bloom descarta se responden sin leer el indice.
+ * Las cabezas de los buckets se leen ordenadas por bucket_id y cada cadena se recorre una sola vez,
+ * aunque varias llaves (o llaves repetidas) caigan en ella. Si build_index_line divide un bucket
+ * durante la busqueda, se repite con el encabezado nuevo. Liberar con index_results_free. */
+int index_lookup_many(index_handle_t *h, const char *const *keys, uint32_t nkeys, index_result_t *results);
+
+/* Libera las entradas de nkeys resultados */
+void index_results_free(index_result_t *results, uint32_t nkeys);
 
 #endif // READER_H
@@ -0,0 +1,88 @@
+#include "response.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define RESPONSE_MIN_CAP 256
+#define RESPONSE_MIN_SEGS 8
+
+void response_init(response_t *r) {
+    r->data = NULL;
+    r->len = 0;
+    r->cap = 0;
+    r->segs = NULL;
+    r->nsegs = 0;
+    r->segs_cap = 0;
+    r->total = 0;
+}
+
+// Reserva espacio para un segmento mas
+static response_seg_t *response_new_seg(response_t *r) {
+    if (r->nsegs == r->segs_cap) {
+        size_t new_cap = r->segs_cap ? r->segs_cap * 2 : RESPONSE_MIN_SEGS;
+        response_seg_t *tmp = realloc(r->segs, sizeof(response_seg_t) * new_cap);
+        if (tmp == NULL) return NULL;
+        r->segs = tmp;
+        r->segs_cap = new_cap;
+    }
+    return &r->segs[r->nsegs++];
+}
+
+int response_append(response_t *r, const void *data, size_t len) {
+    if (len == 0) return 0;
+    if (r->len + len > r->cap) { // Crecer al doble (o a lo necesario)
+        size_t new_cap = r->cap ? r->cap : RESPONSE_MIN_CAP;
+        while (new_cap < r->len + len) new_cap *= 2;
+        char *tmp = realloc(r->data, new_cap);
+        if (tmp == NULL) return -1;
+        r->data = tmp;
+        r->cap = new_cap;
+    }
+
+    // Si el ultimo segmento es de memoria, los bytes nuevos lo extienden
+    response_seg_t *last = r->nsegs ? &r->segs[r->nsegs - 1] : NULL;
+    if (last && last->kind == RESP_SEG_MEM) {
+        last->len += len;
+    } else {
+        response_seg_t *seg = response_new_seg(r);
+        if (seg == NULL) return -1;
+        seg->kind = RESP_SEG_MEM;
+        seg->fd = -1;
+        seg->offset = (off_t)r->len;
+        seg->len = len;
+    }
+    memcpy(r->data + r->len, data, len);
+    r->len += len;
+    r->total += len;
+    return 0;
+}
+
+int response_append_u32(response_t *r, uint32_t v) {
+    return response_append(r, &v, sizeof(v));
+}
+
+int response_append_i32(response_t *r, int32_t v) {
+    return response_append(r, &v, sizeof(v));
+}
+
+int response_append_file(response_t *r, int fd, off_t offset, size_t len) {
+    if (len == 0) return 0;
+    response_seg_t *last = r->nsegs ? &r->segs[r->nsegs - 1] : NULL;
+    if (last && last->kind == RESP_SEG_FILE && last->fd == fd && last->offset + (off_t)last->len == offset) {
+        last->len += len; // Rango contiguo al anterior (p. ej. lineas consecutivas del CSV)
+    } else {
+        response_seg_t *seg = response_new_seg(r);
+        if (seg == NULL) return -1;
+        seg->kind = RESP_SEG_FILE;
+        seg->fd = fd;
+        seg->offset = offset;
+        seg->len = len;
+    }
+    r->total += len;
+    return 0;
+}
+
+void response_free(response_t *r) {
+    free(r->data);
+    free(r->segs);
+    response_init(r);
+}
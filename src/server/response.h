@@ -0,0 +1,48 @@
+#ifndef RESPONSE_H
+#define RESPONSE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/* Respuesta de una peticion, armada por los hilos del pool y enviada despues por el reactor.
+ * Es una lista de segmentos: bytes en memoria (cabeceras, lineas cortas) o rangos de un
+ * archivo que se envian con sendfile sin pasar por memoria del proceso. Los segmentos de
+ * memoria consecutivos se envian juntos con writev. */
+
+typedef enum {
+    RESP_SEG_MEM,   // Rango [offset, offset+len) de 'data'
+    RESP_SEG_FILE   // Rango [offset, offset+len) del archivo 'fd'
+} response_seg_kind_t;
+
+typedef struct {
+    response_seg_kind_t kind;
+    int fd;
+    off_t offset;
+    size_t len;
+} response_seg_t;
+
+typedef struct {
+    char *data;     // Bytes de todos los segmentos de memoria
+    size_t len;
+    size_t cap;
+    response_seg_t *segs;
+    size_t nsegs;
+    size_t segs_cap;
+    size_t total;   // Bytes totales de la respuesta (memoria + archivos)
+} response_t;
+
+void response_init(response_t *r);
+
+/* Agrega bytes al final de la respuesta. Retorna 0 o -1 si falla malloc */
+int response_append(response_t *r, const void *data, size_t len);
+int response_append_u32(response_t *r, uint32_t v);
+int response_append_i32(response_t *r, int32_t v);
+
+/* Agrega len bytes del archivo fd desde offset (se envian con sendfile; fd debe seguir
+ * abierto hasta que la respuesta se envie). Retorna 0 o -1 si falla malloc */
+int response_append_file(response_t *r, int fd, off_t offset, size_t len);
+
+void response_free(response_t *r);
+
+#endif // RESPONSE_H
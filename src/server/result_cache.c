@@ -0,0 +1,276 @@
+#include "result_cache.h"
+#include "hash.h"
+#include "common.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SHARD_MIN_BUCKETS 64 // Potencia de dos; la tabla se duplica cuando hay mas entradas que buckets
+#define CACHE_HASH_SEED 0x9e3779b97f4a7c15ULL
+
+/* Entrada: la llave y el valor van en la misma asignacion, despues del encabezado.
+ * Las entradas de una parte forman un anillo (prev/next) que recorre la manecilla de CLOCK */
+typedef struct cache_entry {
+    struct cache_entry *chain;  // Siguiente en el bucket de la tabla hash
+    struct cache_entry *prev;   // Anillo de CLOCK
+    struct cache_entry *next;
+    uint64_t hash;
+    uint32_t key_len;
+    uint32_t value_len;
+    int referenced;             // Bit de uso de CLOCK
+    char data[];                // key_len bytes de llave y value_len de valor
+} cache_entry_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    cache_entry_t **buckets;
+    size_t nbuckets;            // Potencia de dos
+    cache_entry_t *hand;        // Manecilla de CLOCK (NULL si no hay entradas)
+    size_t bytes;
+    size_t max_bytes;
+    uint64_t entries;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t inserts;
+    uint64_t evictions;
+    uint64_t invalidations;
+} cache_shard_t;
+
+struct result_cache {
+    uint64_t epoch;             // Invalidaciones hechas (__atomic)
+    size_t max_bytes;
+    cache_shard_t shards[RESULT_CACHE_SHARDS];
+};
+
+static size_t entry_size(const cache_entry_t *e) {
+    return sizeof(cache_entry_t) + e->key_len + e->value_len;
+}
+
+// La parte sale de los bits altos del hash y el bucket de los bajos
+static cache_shard_t *shard_of(result_cache_t *c, uint64_t hash) {
+    return &c->shards[hash >> 60 & (RESULT_CACHE_SHARDS - 1)];
+}
+
+static uint64_t key_hash(const char *nkey, size_t len) {
+    return hash_wyhash_key(nkey, len, CACHE_HASH_SEED);
+}
+
+result_cache_t *result_cache_create(size_t max_bytes) {
+    result_cache_t *c = calloc(1, sizeof(*c));
+    if (c == NULL) {
+        perror("calloc (cache)");
+        return NULL;
+    }
+    c->max_bytes = max_bytes;
+    for (int i = 0; i < RESULT_CACHE_SHARDS; i++) {
+        cache_shard_t *s = &c->shards[i];
+        s->nbuckets = SHARD_MIN_BUCKETS;
+        s->buckets = calloc(s->nbuckets, sizeof(cache_entry_t *));
+        s->max_bytes = max_bytes / RESULT_CACHE_SHARDS;
+        pthread_mutex_init(&s->lock, NULL);
+        if (s->buckets == NULL) {
+            perror("calloc (cache)");
+            result_cache_destroy(c);
+            return NULL;
+        }
+    }
+    return c;
+}
+
+void result_cache_destroy(result_cache_t *c) {
+    if (c == NULL) return;
+    for (int i = 0; i < RESULT_CACHE_SHARDS; i++) {
+        cache_shard_t *s = &c->shards[i];
+        if (s->buckets != NULL) {
+            for (size_t b = 0; b < s->nbuckets; b++) {
+                cache_entry_t *e = s->buckets[b];
+                while (e != NULL) {
+                    cache_entry_t *next = e->chain;
+                    free(e);
+                    e = next;
+                }
+            }
+            free(s->buckets);
+        }
+        pthread_mutex_destroy(&s->lock);
+    }
+    free(c);
+}
+
+// Puntero al enlace que apunta a la entrada de la llave (o al NULL final de su bucket)
+static cache_entry_t **shard_find(cache_shard_t *s, uint64_t hash, const char *nkey, size_t len) {
+    cache_entry_t **link = &s->buckets[hash & (s->nbuckets - 1)];
+    while (*link != NULL) {
+        cache_entry_t *e = *link;
+        if (e->hash == hash && e->key_len == len && memcmp(e->data, nkey, len) == 0) break;
+        link = &e->chain;
+    }
+    return link;
+}
+
+// Saca la entrada de *link de la tabla y del anillo, y la libera
+static void shard_unlink(cache_shard_t *s, cache_entry_t **link) {
+    cache_entry_t *e = *link;
+    *link = e->chain;
+    if (e->next == e) {
+        s->hand = NULL;
+    } else {
+        e->prev->next = e->next;
+        e->next->prev = e->prev;
+        if (s->hand == e) s->hand = e->next;
+    }
+    s->bytes -= entry_size(e);
+    s->entries--;
+    free(e);
+}
+
+// Desaloja con CLOCK hasta que entren need bytes mas
+static void shard_evict(cache_shard_t *s, size_t need) {
+    while (s->hand != NULL && s->bytes + need > s->max_bytes) {
+        cache_entry_t *e = s->hand;
+        if (e->referenced) { // Segunda oportunidad
+            e->referenced = 0;
+            s->hand = e->next;
+            continue;
+        }
+        shard_unlink(s, shard_find(s, e->hash, e->data, e->key_len));
+        s->evictions++;
+    }
+}
+
+// Duplica la tabla hash (si falla malloc se sigue con la actual: solo se alargan las cadenas)
+static void shard_grow(cache_shard_t *s) {
+    size_t n = s->nbuckets * 2;
+    cache_entry_t **buckets = calloc(n, sizeof(cache_entry_t *));
+    if (buckets == NULL) return;
+    for (size_t b = 0; b < s->nbuckets; b++) {
+        cache_entry_t *e = s->buckets[b];
+        while (e != NULL) {
+            cache_entry_t *next = e->chain;
+            e->chain = buckets[e->hash & (n - 1)];
+            buckets[e->hash & (n - 1)] = e;
+            e = next;
+        }
+    }
+    free(s->buckets);
+    s->buckets = buckets;
+    s->nbuckets = n;
+}
+
+int result_cache_get(result_cache_t *c, const char *nkey, size_t len, response_t *resp) {
+    uint64_t hash = key_hash(nkey, len);
+    cache_shard_t *s = shard_of(c, hash);
+    pthread_mutex_lock(&s->lock);
+    cache_entry_t *e = *shard_find(s, hash, nkey, len);
+    int status = 0;
+    if (e == NULL) {
+        s->misses++;
+    } else {
+        s->hits++;
+        e->referenced = 1;
+        // Se copia con el lock tomado: la entrada puede desalojarse apenas se suelte
+        status = response_append(resp, e->data + e->key_len, e->value_len) == 0 ? 1 : -1;
+    }
+    pthread_mutex_unlock(&s->lock);
+    return status;
+}
+
+uint64_t result_cache_epoch(result_cache_t *c) {
+    return __atomic_load_n(&c->epoch, __ATOMIC_ACQUIRE);
+}
+
+void result_cache_put(result_cache_t *c, const char *nkey, size_t len, const void *value, size_t value_len,
+                      uint64_t epoch) {
+    uint64_t hash = key_hash(nkey, len);
+    cache_shard_t *s = shard_of(c, hash);
+    size_t size = sizeof(cache_entry_t) + len + value_len;
+    if (value_len > RESULT_CACHE_MAX_VALUE || len > UINT32_MAX || size > s->max_bytes) return;
+    cache_entry_t *e = malloc(size);
+    if (e == NULL) return; // Sin memoria: simplemente no se guarda
+    e->hash = hash;
+    e->key_len = (uint32_t)len;
+    e->value_len = (uint32_t)value_len;
+    e->referenced = 0;
+    memcpy(e->data, nkey, len);
+    memcpy(e->data + len, value, value_len);
+
+    pthread_mutex_lock(&s->lock);
+    // La invalidacion sube el epoch antes de tomar los locks: con el lock tomado, un epoch igual
+    // garantiza que ninguna fila nueva se indexo despues de que la busqueda empezo
+    cache_entry_t **link = shard_find(s, hash, nkey, len);
+    if (result_cache_epoch(c) != epoch || *link != NULL) { // Vieja, o ya la guardo otro hilo
+        pthread_mutex_unlock(&s->lock);
+        free(e);
+        return;
+    }
+    shard_evict(s, size);
+    link = shard_find(s, hash, nkey, len); // El desalojo pudo cambiar la cadena
+    e->chain = NULL;
+    *link = e;
+    if (s->hand == NULL) {
+        e->prev = e->next = e;
+        s->hand = e;
+    } else { // Justo detras de la manecilla: es la ultima que la manecilla vuelve a ver
+        e->next = s->hand;
+        e->prev = s->hand->prev;
+        e->prev->next = e;
+        s->hand->prev = e;
+    }
+    s->bytes += size;
+    s->entries++;
+    s->inserts++;
+    if (s->entries > s->nbuckets) shard_grow(s);
+    pthread_mutex_unlock(&s->lock);
+}
+
+// Borra la entrada de una llave si esta
+static void invalidate_key(result_cache_t *c, const char *nkey, size_t len) {
+    uint64_t hash = key_hash(nkey, len);
+    cache_shard_t *s = shard_of(c, hash);
+    pthread_mutex_lock(&s->lock);
+    cache_entry_t **link = shard_find(s, hash, nkey, len);
+    if (*link != NULL) {
+        shard_unlink(s, link);
+        s->invalidations++;
+    }
+    pthread_mutex_unlock(&s->lock);
+}
+
+void result_cache_invalidate_title(result_cache_t *c, const char *nkey, size_t len) {
+    __atomic_add_fetch(&c->epoch, 1, __ATOMIC_ACQ_REL);
+    invalidate_key(c, nkey, len);
+    for (size_t n = KEY_PREFIX_LEN; n < len; n++) invalidate_key(c, nkey, n);
+}
+
+void result_cache_clear(result_cache_t *c) {
+    __atomic_add_fetch(&c->epoch, 1, __ATOMIC_ACQ_REL);
+    for (int i = 0; i < RESULT_CACHE_SHARDS; i++) {
+        cache_shard_t *s = &c->shards[i];
+        pthread_mutex_lock(&s->lock);
+        for (size_t b = 0; b < s->nbuckets; b++) {
+            while (s->buckets[b] != NULL) {
+                shard_unlink(s, &s->buckets[b]);
+                s->invalidations++;
+            }
+        }
+        pthread_mutex_unlock(&s->lock);
+    }
+}
+
+void result_cache_stats(result_cache_t *c, result_cache_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+    out->max_bytes = c->max_bytes;
+    for (int i = 0; i < RESULT_CACHE_SHARDS; i++) {
+        cache_shard_t *s = &c->shards[i];
+        pthread_mutex_lock(&s->lock);
+        out->hits += s->hits;
+        out->misses += s->misses;
+        out->inserts += s->inserts;
+        out->evictions += s->evictions;
+        out->invalidations += s->invalidations;
+        out->entries += s->entries;
+        out->bytes += s->bytes;
+        pthread_mutex_unlock(&s->lock);
+    }
+}
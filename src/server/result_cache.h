@@ -0,0 +1,62 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "response.h"
+
+/* Cache de respuestas de busqueda compartido por los hilos de I/O (--cache MB, 0 = sin cache).
+ * Guarda, por llave normalizada, el grupo de resultados ya serializado ([int32_t count] seguido de
+ * count x [uint32_t len][linea]) cuando todas sus lineas caben en memoria. Esta dividido en
+ * RESULT_CACHE_SHARDS partes, cada una con su mutex y su tabla hash encadenada: una busqueda que
+ * acierta es un probe en la tabla de su parte y una copia a la respuesta, sin tocar el indice ni
+ * el csv. Cada parte usa hasta max_bytes / RESULT_CACHE_SHARDS bytes (contando llave, valor y
+ * encabezado de cada entrada) y desaloja con CLOCK: un acierto marca el bit de uso de la entrada
+ * y la manecilla da una segunda oportunidad a las marcadas antes de desalojar.
+ * OP_ADD_BOOK invalida las llaves que la fila nueva puede cambiar (result_cache_invalidate_title). */
+#define RESULT_CACHE_SHARDS 16
+#define RESULT_CACHE_DEFAULT_MB 64
+#define RESULT_CACHE_MAX_VALUE (64 * 1024) // Grupos mas grandes no se guardan
+
+typedef struct result_cache result_cache_t;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t inserts;
+    uint64_t evictions;
+    uint64_t invalidations; // Entradas borradas por OP_ADD_BOOK
+    uint64_t entries;
+    uint64_t bytes;
+    uint64_t max_bytes;
+} result_cache_stats_t;
+
+/* Cache vacio de hasta max_bytes. Retorna NULL si falla malloc */
+result_cache_t *result_cache_create(size_t max_bytes);
+
+void result_cache_destroy(result_cache_t *c);
+
+/* Si la llave esta, agrega su grupo a resp y retorna 1. Retorna 0 si no esta, o -1 si falla malloc */
+int result_cache_get(result_cache_t *c, const char *nkey, size_t len, response_t *resp);
+
+/* Epoch de invalidaciones: se lee antes de buscar en el indice y se pasa a result_cache_put */
+uint64_t result_cache_epoch(result_cache_t *c);
+
+/* Guarda el grupo value[0, value_len) de la llave. Se descarta si no cabe o si hubo una
+ * invalidacion desde epoch (la busqueda pudo leer el indice antes de la fila nueva) */
+void result_cache_put(result_cache_t *c, const char *nkey, size_t len, const void *value, size_t value_len,
+                      uint64_t epoch);
+
+/* Invalida las respuestas que puede cambiar una fila nueva con titulo normalizado nkey: la de la
+ * misma llave y, como con el hash de prefijo una consulta de KEY_PREFIX_LEN caracteres o mas
+ * tambien encuentra los titulos que empiezan con ella, las de sus prefijos de ese largo o mas.
+ * Llamar despues de que la fila quedo en el indice */
+void result_cache_invalidate_title(result_cache_t *c, const char *nkey, size_t len);
+
+/* Invalida todas las entradas (cuando no se puede saber que llaves cambio una fila nueva) */
+void result_cache_clear(result_cache_t *c);
+
+// Suma los contadores de todas las partes
+void result_cache_stats(result_cache_t *c, result_cache_stats_t *out);
+
+#endif // RESULT_CACHE_H
@@ -0,0 +1,265 @@
+#include "slots.h"
+#include "common.h"
+#include "page_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define SLOTS_MIN_COUNT 1024       // Potencia de dos
+#define SLOTS_READ_WINDOW 256      // Slots por pread al insertar en el archivo (4 KiB)
+
+void slots_encode(const slot_t *slot, unsigned char *buf) {
+    uint64_t packed = slot->record_len == 0 ? 0 : ((uint64_t)slot->offset << 24) | slot->record_len;
+    memcpy(buf, &slot->hash, 8);
+    memcpy(buf + 8, &packed, 8);
+}
+
+void slots_decode(const unsigned char *buf, slot_t *slot) {
+    uint64_t packed;
+    memcpy(&slot->hash, buf, 8);
+    memcpy(&packed, buf + 8, 8);
+    slot->offset = (off_t)(packed >> 24);
+    slot->record_len = (uint32_t)(packed & SLOTS_MAX_RECORD_LEN);
+}
+
+/* Robin Hood sobre slots[0..n) (n potencia de dos, con al menos un slot vacio).
+ * La entrada nueva toma el lugar de la primera que esta igual o mas cerca de su home: asi las
+ * entradas de un mismo home quedan de la mas reciente a la mas antigua */
+static void table_place(unsigned char *slots, uint64_t n, slot_t cur) {
+    uint64_t mask = n - 1;
+    uint64_t pos = cur.hash & mask;
+    for (uint64_t dist = 0;; dist++, pos = (pos + 1) & mask) {
+        unsigned char *raw = slots + pos * SLOT_SIZE;
+        slot_t occ;
+        slots_decode(raw, &occ);
+        if (occ.record_len == 0) {
+            slots_encode(&cur, raw);
+            return;
+        }
+        if (slots_distance(occ.hash, pos, n) <= dist) {
+            slots_encode(&cur, raw);
+            cur = occ;
+            dist = slots_distance(cur.hash, pos, n);
+        }
+    }
+}
+
+static int check_slot(off_t offset, uint32_t record_len) {
+    if (offset < 0 || offset >= SLOTS_MAX_OFFSET || record_len == 0 || record_len > SLOTS_MAX_RECORD_LEN) {
+        fprintf(stderr, "Error: el registro en el offset %lld no cabe en un slot (use --engine chain)\n",
+                (long long)offset);
+        return -1;
+    }
+    return 0;
+}
+
+int slots_table_init(slots_table_t *t, uint64_t expected_entries, uint64_t seed, uint32_t hash) {
+    uint64_t n = SLOTS_MIN_COUNT;
+    while (n * SLOTS_TARGET_LOAD_PCT < expected_entries * 100) n *= 2;
+    buckets_header_init(&t->hdr, 0);
+    t->hdr.engine = BUCKETS_ENGINE_SLOTS;
+    t->hdr.max_load_pct = SLOTS_MAX_LOAD_PCT;
+    t->hdr.seed = seed;
+    t->hdr.hash = hash;
+    t->hdr.level_size = n;
+    t->hdr.num_buckets = n;
+    t->slots = calloc(n, SLOT_SIZE);
+    if (t->slots == NULL) {
+        perror("calloc (slots)");
+        return -1;
+    }
+    return 0;
+}
+
+/* Duplica la tabla. Las entradas se reinsertan en orden inverso al de busqueda (empezando antes
+ * de un slot vacio, para no partir un grupo que da la vuelta al final): con la regla de
+ * table_place, las entradas de una misma llave conservan su orden */
+static int table_grow(slots_table_t *t) {
+    uint64_t n = t->hdr.num_buckets;
+    uint64_t new_n = n * 2;
+    unsigned char *slots = calloc(new_n, SLOT_SIZE);
+    if (slots == NULL) {
+        perror("calloc (slots)");
+        return -1;
+    }
+    uint64_t empty = 0;
+    slot_t s;
+    for (; empty < n; empty++) {
+        slots_decode(t->slots + empty * SLOT_SIZE, &s);
+        if (s.record_len == 0) break;
+    }
+    for (uint64_t k = 1; k <= n; k++) {
+        slots_decode(t->slots + ((empty - k) & (n - 1)) * SLOT_SIZE, &s);
+        if (s.record_len != 0) table_place(slots, new_n, s);
+    }
+    free(t->slots);
+    t->slots = slots;
+    t->hdr.level_size = new_n;
+    t->hdr.num_buckets = new_n;
+    return 0;
+}
+
+int slots_table_insert(slots_table_t *t, uint64_t hash, off_t offset, uint32_t record_len) {
+    if (check_slot(offset, record_len) != 0) return -1;
+    if ((t->hdr.entry_count + 1) * 100 > t->hdr.num_buckets * t->hdr.max_load_pct && table_grow(t) != 0) return -1;
+    slot_t s = {.hash = hash, .offset = offset, .record_len = record_len};
+    table_place(t->slots, t->hdr.num_buckets, s);
+    t->hdr.entry_count++;
+    return 0;
+}
+
+int slots_table_load(slots_table_t *t, int fd) {
+    t->slots = NULL;
+    if (buckets_read_header(fd, &t->hdr) != 0) return -1;
+    if (t->hdr.engine != BUCKETS_ENGINE_SLOTS) {
+        fprintf(stderr, "Error: el indice no usa el motor slots\n");
+        return -1;
+    }
+    size_t size = (size_t)t->hdr.num_buckets * SLOT_SIZE;
+    t->slots = malloc(size);
+    if (t->slots == NULL) {
+        perror("malloc (slots)");
+        return -1;
+    }
+    if (safe_pread(fd, t->slots, size, BUCKETS_HEADER_SIZE) != (ssize_t)size) {
+        fprintf(stderr, "Error, no se pudo leer la tabla de slots\n");
+        free(t->slots);
+        t->slots = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int slots_table_write(const slots_table_t *t, const char *path) {
+    char tmp_path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    int fd = open(tmp_path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "open %s fallo: %s\n", tmp_path, strerror(errno));
+        return -1;
+    }
+    size_t size = (size_t)t->hdr.num_buckets * SLOT_SIZE;
+    if (buckets_write_header(fd, &t->hdr) != 0 ||
+        safe_pwrite(fd, t->slots, size, BUCKETS_HEADER_SIZE) != (ssize_t)size || fsync(fd) != 0) {
+        fprintf(stderr, "Error, no se pudo escribir la tabla de slots\n");
+        close(fd);
+        unlink(tmp_path);
+        return -1;
+    }
+    close(fd);
+    if (rename(tmp_path, path) != 0) {
+        perror("rename (slots)");
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+void slots_table_free(slots_table_t *t) {
+    free(t->slots);
+    t->slots = NULL;
+}
+
+// Lee/escribe count slots desde first, dando la vuelta al final de la tabla de n slots
+static int slots_io(int fd, uint64_t first, uint64_t count, uint64_t n, unsigned char *buf, int write) {
+    while (count > 0) {
+        uint64_t chunk = n - first < count ? n - first : count;
+        size_t len = (size_t)chunk * SLOT_SIZE;
+        off_t pos = BUCKETS_HEADER_SIZE + (off_t)first * SLOT_SIZE;
+        ssize_t done = write ? page_pool_pwrite(fd, buf, len, pos) : safe_pread(fd, buf, len, pos);
+        if (done != (ssize_t)len) return -1;
+        buf += len;
+        count -= chunk;
+        first = (first + chunk) & (n - 1);
+    }
+    return 0;
+}
+
+int slots_insert_file(int fd, const char *path, buckets_header_t *hdr, uint64_t hash, off_t offset, uint32_t record_len) {
+    if (check_slot(offset, record_len) != 0) return -1;
+    uint64_t n = hdr->num_buckets;
+
+    if ((hdr->entry_count + 1) * 100 > n * hdr->max_load_pct) { // Hay que duplicar: tabla completa en memoria
+        slots_table_t t;
+        if (slots_table_load(&t, fd) != 0) return -1;
+        int status = slots_table_insert(&t, hash, offset, record_len);
+        if (status == 0) {
+            buckets_generation_bump();
+            status = slots_table_write(&t, path);
+            buckets_generation_bump();
+        }
+        if (status == 0) *hdr = t.hdr;
+        slots_table_free(&t);
+        return status;
+    }
+
+    // Slots desde el home hasta el primer vacio (por ventanas de SLOTS_READ_WINDOW)
+    uint64_t home = hash & (n - 1);
+    unsigned char *buf = NULL;
+    uint64_t len = 0;
+    int found_empty = 0;
+    while (!found_empty && len < n) {
+        uint64_t want = n - len < SLOTS_READ_WINDOW ? n - len : SLOTS_READ_WINDOW;
+        unsigned char *tmp = realloc(buf, (size_t)(len + want) * SLOT_SIZE);
+        if (tmp == NULL) {
+            free(buf);
+            return -1;
+        }
+        buf = tmp;
+        if (slots_io(fd, (home + len) & (n - 1), want, n, buf + len * SLOT_SIZE, 0) != 0) {
+            fprintf(stderr, "Error, no se pudo leer la tabla de slots\n");
+            free(buf);
+            return -1;
+        }
+        for (uint64_t i = len; i < len + want; i++) {
+            slot_t s;
+            slots_decode(buf + i * SLOT_SIZE, &s);
+            if (s.record_len == 0) {
+                found_empty = 1;
+                want = i - len + 1; // El rango termina en el slot vacio
+                break;
+            }
+        }
+        len += want;
+    }
+    if (!found_empty) {
+        fprintf(stderr, "Error: la tabla de slots esta llena\n");
+        free(buf);
+        return -1;
+    }
+
+    // Robin Hood dentro del rango (mismo criterio que table_place)
+    slot_t cur = {.hash = hash, .offset = offset, .record_len = record_len};
+    uint64_t dist = 0;
+    for (uint64_t i = 0; i < len; i++, dist++) {
+        unsigned char *raw = buf + i * SLOT_SIZE;
+        slot_t occ;
+        slots_decode(raw, &occ);
+        if (occ.record_len == 0) {
+            slots_encode(&cur, raw);
+            break;
+        }
+        uint64_t pos = (home + i) & (n - 1);
+        if (slots_distance(occ.hash, pos, n) <= dist) {
+            slots_encode(&cur, raw);
+            cur = occ;
+            dist = slots_distance(cur.hash, pos, n);
+        }
+    }
+
+    buckets_header_t next = *hdr;
+    next.entry_count++;
+    buckets_generation_bump(); // Impar: los lectores repiten la busqueda
+    int status = slots_io(fd, home, len, n, buf, 1) == 0 && buckets_write_header(fd, &next) == 0 ? 0 : -1;
+    buckets_generation_bump();
+    free(buf);
+    if (status != 0) {
+        fprintf(stderr, "Error, no se pudo escribir la tabla de slots\n");
+        return -1;
+    }
+    *hdr = next;
+    return 0;
+}
@@ -0,0 +1,71 @@
+#ifndef SLOTS_H
+#define SLOTS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "buckets.h"
+
+/* Motor de indice "slots" (--build --engine slots): tabla hash de direccionamiento abierto con
+ * Robin Hood en title_buckets.dat (mismo encabezado, con engine = BUCKETS_ENGINE_SLOTS y
+ * num_buckets = numero de slots). No usa title_linked_list.dat.
+ *
+ * Cada slot ocupa SLOT_SIZE bytes: [uint64 hash][uint64 offset << 24 | record_len]. Cuatro slots
+ * forman un grupo de 64 bytes (una linea de cache) y los grupos quedan alineados en el archivo.
+ * El slot "home" de una llave es hash & (num_buckets - 1); con Robin Hood las entradas de un
+ * mismo home quedan seguidas y una busqueda termina en el primer slot vacio o con una entrada
+ * mas cerca de su home que la llave buscada, asi que casi siempre se resuelve con una lectura.
+ * Las entradas de una misma llave quedan de la mas reciente a la mas antigua, como en las listas
+ * enlazadas. El slot no guarda la llave: si la consulta es mas larga que KEY_PREFIX_LEN, el
+ * lector confirma el prefijo leyendo el titulo en el csv (ver reader.c). */
+
+#define SLOT_SIZE 16
+#define SLOTS_PER_GROUP 4            // 64 bytes
+#define SLOTS_TARGET_LOAD_PCT 70     // --build: el menor numero de slots con load factor <= 0.7
+#define SLOTS_MAX_LOAD_PCT 85        // Al pasarlo, la tabla se duplica
+#define SLOTS_MAX_OFFSET ((off_t)1 << 40)
+#define SLOTS_MAX_RECORD_LEN ((1u << 24) - 1)
+
+typedef struct {
+    uint64_t hash;
+    off_t offset;        // Offset del registro en el csv
+    uint32_t record_len; // 0 = slot vacio
+} slot_t;
+
+void slots_encode(const slot_t *slot, unsigned char *buf);
+void slots_decode(const unsigned char *buf, slot_t *slot);
+
+// Distancia de un slot en pos a su home (con num_buckets potencia de dos)
+static inline uint64_t slots_distance(uint64_t hash, uint64_t pos, uint64_t num_slots) {
+    return (pos - (hash & (num_slots - 1))) & (num_slots - 1);
+}
+
+// Tabla completa en memoria (construccion, --incremental y cuando la tabla se duplica)
+typedef struct {
+    buckets_header_t hdr;
+    unsigned char *slots; // num_buckets * SLOT_SIZE bytes
+} slots_table_t;
+
+/* Tabla vacia para unas expected_entries entradas, con la semilla y la funcion de hash (HASH_*)
+ * de las llaves. Retorna 0, o -1 si falla malloc */
+int slots_table_init(slots_table_t *t, uint64_t expected_entries, uint64_t seed, uint32_t hash);
+
+/* Inserta una entrada (la tabla se duplica si pasa de max_load_pct).
+ * Retorna 0, o -1 si falla malloc o el offset/longitud no caben en el slot */
+int slots_table_insert(slots_table_t *t, uint64_t hash, off_t offset, uint32_t record_len);
+
+/* Lee la tabla de un archivo abierto. Retorna 0, o -1 si falla */
+int slots_table_load(slots_table_t *t, int fd);
+
+/* Escribe la tabla en path (archivo temporal + rename). Retorna 0, o -1 si falla */
+int slots_table_write(const slots_table_t *t, const char *path);
+
+void slots_table_free(slots_table_t *t);
+
+/* Inserta una entrada en el archivo abierto en fd (OP_ADD_BOOK). Lee los slots desde el home
+ * hasta el primer vacio, hace el desplazamiento de Robin Hood en memoria y escribe solo ese
+ * rango y el encabezado, dentro de una generacion impar (ver buckets_generation). Si la tabla
+ * pasa de max_load_pct, la carga completa, la duplica y la reemplaza en path (rename): los
+ * lectores la vuelven a abrir al ver la generacion nueva. Actualiza hdr. Retorna 0, o -1 si falla */
+int slots_insert_file(int fd, const char *path, buckets_header_t *hdr, uint64_t hash, off_t offset, uint32_t record_len);
+
+#endif // SLOTS_H
@@ -0,0 +1,326 @@
+#include "static_index.h"
+#include "common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define STATIC_WRITE_BUF_SIZE (4 << 20)
+
+// Posicion de un hash en un nivel de nbits bits (mezcla de splitmix64 con el numero de nivel)
+static uint64_t level_pos(uint64_t hash, uint32_t level, uint64_t nbits) {
+    uint64_t x = hash + (uint64_t)(level + 1) * 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return (uint64_t)(((__uint128_t)x * nbits) >> 64); // x mod nbits sin division
+}
+
+static inline int bit_get(const uint64_t *words, uint64_t pos) {
+    return (int)((words[pos >> 6] >> (pos & 63)) & 1);
+}
+
+static inline void bit_set(uint64_t *words, uint64_t pos) {
+    words[pos >> 6] |= 1ULL << (pos & 63);
+}
+
+static inline void bit_clear(uint64_t *words, uint64_t pos) {
+    words[pos >> 6] &= ~(1ULL << (pos & 63));
+}
+
+static int compute_ranks(static_mphf_t *m) {
+    uint64_t nblocks = m->nwords / STATIC_RANK_WORDS + 1;
+    m->ranks = malloc(sizeof(uint64_t) * nblocks);
+    if (m->ranks == NULL) return -1;
+    uint64_t total = 0;
+    for (uint64_t w = 0; w < m->nwords; w++) {
+        if (w % STATIC_RANK_WORDS == 0) m->ranks[w / STATIC_RANK_WORDS] = total;
+        total += (uint64_t)__builtin_popcountll(m->bits[w]);
+    }
+    if (m->nwords % STATIC_RANK_WORDS == 0) m->ranks[m->nwords / STATIC_RANK_WORDS] = total;
+    return 0;
+}
+
+// Bits en 1 antes de pos
+static uint64_t rank_of(const static_mphf_t *m, uint64_t pos) {
+    uint64_t word = pos >> 6;
+    uint64_t r = m->ranks[word / STATIC_RANK_WORDS];
+    for (uint64_t w = word - word % STATIC_RANK_WORDS; w < word; w++) r += (uint64_t)__builtin_popcountll(m->bits[w]);
+    return r + (uint64_t)__builtin_popcountll(m->bits[word] & ((1ULL << (pos & 63)) - 1));
+}
+
+static int u64_cmp(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Construye el hash perfecto sobre n hashes distintos (el arreglo keys se reordena).
+ * En cada nivel hay tantos bits como llaves pendientes: una llave queda en el nivel si nadie
+ * mas cae en su posicion; las que chocan pasan al siguiente */
+static int mphf_build(static_mphf_t *m, uint64_t *keys, uint64_t n) {
+    memset(m, 0, sizeof(*m));
+    m->nkeys = n;
+    uint64_t *collide = NULL;
+    uint64_t remaining = n;
+    while (remaining > 0 && m->nlevels < STATIC_MAX_LEVELS) {
+        uint64_t nbits = (remaining + 63) / 64 * 64;
+        uint64_t nw = nbits / 64;
+        uint64_t *bits = realloc(m->bits, sizeof(uint64_t) * (m->nwords + nw));
+        uint64_t *tmp = realloc(collide, sizeof(uint64_t) * nw);
+        if (bits != NULL) m->bits = bits;
+        if (tmp != NULL) collide = tmp;
+        if (bits == NULL || tmp == NULL) {
+            free(collide);
+            static_mphf_free(m);
+            return -1;
+        }
+        uint64_t *level = m->bits + m->nwords;
+        memset(level, 0, sizeof(uint64_t) * nw);
+        memset(collide, 0, sizeof(uint64_t) * nw);
+        for (uint64_t i = 0; i < remaining; i++) {
+            uint64_t pos = level_pos(keys[i], m->nlevels, nbits);
+            if (bit_get(collide, pos)) continue;
+            if (bit_get(level, pos)) {
+                bit_clear(level, pos);
+                bit_set(collide, pos);
+            } else {
+                bit_set(level, pos);
+            }
+        }
+        uint64_t kept = 0; // Las que chocaron quedan al inicio del arreglo para el siguiente nivel
+        for (uint64_t i = 0; i < remaining; i++) {
+            if (!bit_get(level, level_pos(keys[i], m->nlevels, nbits))) keys[kept++] = keys[i];
+        }
+        m->level_bits[m->nlevels++] = nbits;
+        m->nwords += nw;
+        remaining = kept;
+    }
+    free(collide);
+    if (remaining > 0) {
+        m->fallback = malloc(sizeof(uint64_t) * remaining);
+        if (m->fallback == NULL) {
+            static_mphf_free(m);
+            return -1;
+        }
+        memcpy(m->fallback, keys, sizeof(uint64_t) * remaining);
+        qsort(m->fallback, remaining, sizeof(uint64_t), u64_cmp);
+        m->nfallback = remaining;
+    }
+    if (compute_ranks(m) != 0) {
+        static_mphf_free(m);
+        return -1;
+    }
+    return 0;
+}
+
+uint64_t static_mphf_lookup(const static_mphf_t *m, uint64_t hash) {
+    uint64_t base = 0;
+    for (uint32_t l = 0; l < m->nlevels; l++) {
+        uint64_t pos = base + level_pos(hash, l, m->level_bits[l]);
+        if (bit_get(m->bits, pos)) return rank_of(m, pos);
+        base += m->level_bits[l];
+    }
+    if (m->nfallback == 0) return m->nkeys;
+    const uint64_t *found = bsearch(&hash, m->fallback, m->nfallback, sizeof(uint64_t), u64_cmp);
+    if (found == NULL) return m->nkeys;
+    return m->nkeys - m->nfallback + (uint64_t)(found - m->fallback);
+}
+
+void static_mphf_free(static_mphf_t *m) {
+    free(m->bits);
+    free(m->ranks);
+    free(m->fallback);
+    m->bits = NULL;
+    m->ranks = NULL;
+    m->fallback = NULL;
+}
+
+void static_key_decode(const unsigned char *buf, static_key_t *key) {
+    uint64_t packed;
+    memcpy(&key->hash, buf, 8);
+    memcpy(&packed, buf + 8, 8);
+    key->record_len = (uint32_t)(packed & SLOTS_MAX_RECORD_LEN);
+    key->offset = key->record_len != 0 ? (off_t)(packed >> 24) : 0;
+    key->postings = key->record_len == 0 ? packed >> 24 : 0;
+}
+
+void static_posting_decode(const unsigned char *buf, off_t *offset, uint32_t *record_len) {
+    uint64_t packed;
+    memcpy(&packed, buf, 8);
+    *offset = (off_t)(packed >> 24);
+    *record_len = (uint32_t)(packed & SLOTS_MAX_RECORD_LEN);
+}
+
+// Orden de las filas: por hash y, dentro de una llave, de la mas reciente a la mas antigua
+static int row_cmp(const void *a, const void *b) {
+    const slot_t *x = a, *y = b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    return (x->offset < y->offset) - (x->offset > y->offset);
+}
+
+static uint64_t row_packed(const slot_t *row) {
+    return ((uint64_t)row->offset << 24) | row->record_len;
+}
+
+// Tamaños y offsets de las secciones segun el meta (igual al escribir y al cargar)
+static void layout(static_mphf_t *m) {
+    off_t fallback_off = BUCKETS_HEADER_SIZE + STATIC_META_SIZE + (off_t)m->nwords * 8;
+    off_t end = fallback_off + (off_t)m->nfallback * 8;
+    m->table_off = (end + 63) / 64 * 64; // Cuatro entradas por linea de cache
+    m->postings_off = m->table_off + (off_t)m->nkeys * STATIC_KEY_SIZE;
+}
+
+static void encode_meta(const static_mphf_t *m, unsigned char *buf) {
+    memset(buf, 0, STATIC_META_SIZE);
+    memcpy(buf, &m->nlevels, 4);
+    memcpy(buf + 8, &m->nwords, 8);
+    memcpy(buf + 16, &m->nfallback, 8);
+    memcpy(buf + 24, &m->postings_words, 8);
+    memcpy(buf + 64, m->level_bits, sizeof(m->level_bits));
+}
+
+static int write_all(int fd, const void *buf, size_t len, off_t off) {
+    return safe_pwrite(fd, buf, len, off) == (ssize_t)len ? 0 : -1;
+}
+
+int static_index_write(const char *path, uint64_t seed, uint32_t hash, slot_t *rows, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (rows[i].offset >= SLOTS_MAX_OFFSET || rows[i].record_len == 0 || rows[i].record_len > SLOTS_MAX_RECORD_LEN) {
+            fprintf(stderr, "Error: el registro en el offset %lld no cabe en el indice estatico\n",
+                    (long long)rows[i].offset);
+            return -1;
+        }
+    }
+    qsort(rows, count, sizeof(slot_t), row_cmp);
+
+    // Hashes distintos y palabras del area de postings (solo llaves con varias filas)
+    uint64_t *keys = malloc(sizeof(uint64_t) * (count ? count : 1));
+    if (keys == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    uint64_t nkeys = 0;
+    uint64_t postings_words = 0;
+    for (size_t i = 0; i < count; ) {
+        size_t j = i + 1;
+        while (j < count && rows[j].hash == rows[i].hash) j++;
+        keys[nkeys++] = rows[i].hash;
+        if (j - i > 1) postings_words += 1 + (j - i);
+        i = j;
+    }
+
+    static_mphf_t m;
+    if (mphf_build(&m, keys, nkeys) != 0) {
+        perror("malloc");
+        free(keys);
+        return -1;
+    }
+    free(keys);
+    m.postings_words = postings_words;
+    layout(&m);
+
+    unsigned char *table = calloc(nkeys ? nkeys : 1, STATIC_KEY_SIZE);
+    uint64_t *postings = malloc(sizeof(uint64_t) * (postings_words ? postings_words : 1));
+    int status = -1;
+    int fd = -1;
+    char tmp_path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    if (table == NULL || postings == NULL) {
+        perror("malloc");
+        goto cleanup;
+    }
+    uint64_t next = 0;
+    for (size_t i = 0; i < count; ) {
+        size_t j = i + 1;
+        while (j < count && rows[j].hash == rows[i].hash) j++;
+        unsigned char *entry = table + static_mphf_lookup(&m, rows[i].hash) * STATIC_KEY_SIZE;
+        uint64_t packed = row_packed(&rows[i]);
+        if (j - i > 1) { // Lista en el area de postings
+            packed = next << 24;
+            postings[next++] = j - i;
+            for (size_t k = i; k < j; k++) postings[next++] = row_packed(&rows[k]);
+        }
+        memcpy(entry, &rows[i].hash, 8);
+        memcpy(entry + 8, &packed, 8);
+        i = j;
+    }
+
+    buckets_header_t hdr;
+    buckets_header_init(&hdr, 0);
+    hdr.engine = BUCKETS_ENGINE_STATIC;
+    hdr.seed = seed;
+    hdr.hash = hash;
+    hdr.level_size = nkeys;
+    hdr.num_buckets = nkeys;
+    hdr.entry_count = count;
+    unsigned char meta[STATIC_META_SIZE];
+    encode_meta(&m, meta);
+    fd = open(tmp_path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "open %s fallo: %s\n", tmp_path, strerror(errno));
+        goto cleanup;
+    }
+    if (buckets_write_header(fd, &hdr) != 0 || write_all(fd, meta, sizeof(meta), BUCKETS_HEADER_SIZE) != 0 ||
+        write_all(fd, m.bits, m.nwords * 8, BUCKETS_HEADER_SIZE + STATIC_META_SIZE) != 0 ||
+        write_all(fd, m.fallback, m.nfallback * 8, BUCKETS_HEADER_SIZE + STATIC_META_SIZE + (off_t)m.nwords * 8) != 0 ||
+        write_all(fd, table, nkeys * STATIC_KEY_SIZE, m.table_off) != 0 ||
+        write_all(fd, postings, postings_words * 8, m.postings_off) != 0 ||
+        ftruncate(fd, m.postings_off + (off_t)postings_words * 8) != 0 || fsync(fd) != 0) {
+        fprintf(stderr, "Error, no se pudo escribir el indice estatico\n");
+        goto cleanup;
+    }
+    close(fd);
+    fd = -1;
+    if (rename(tmp_path, path) != 0) {
+        perror("rename (static)");
+        goto cleanup;
+    }
+    status = 0;
+
+cleanup:
+    if (fd >= 0) close(fd);
+    if (status != 0) unlink(tmp_path);
+    free(table);
+    free(postings);
+    static_mphf_free(&m);
+    return status;
+}
+
+int static_mphf_load(static_mphf_t *m, int fd, const buckets_header_t *hdr) {
+    memset(m, 0, sizeof(*m));
+    unsigned char meta[STATIC_META_SIZE];
+    if (safe_pread(fd, meta, sizeof(meta), BUCKETS_HEADER_SIZE) != (ssize_t)sizeof(meta)) goto bad;
+    memcpy(&m->nlevels, meta, 4);
+    memcpy(&m->nwords, meta + 8, 8);
+    memcpy(&m->nfallback, meta + 16, 8);
+    memcpy(&m->postings_words, meta + 24, 8);
+    memcpy(m->level_bits, meta + 64, sizeof(m->level_bits));
+    m->nkeys = hdr->num_buckets;
+    uint64_t total_bits = 0;
+    for (uint32_t l = 0; l < m->nlevels && l < STATIC_MAX_LEVELS; l++) total_bits += m->level_bits[l];
+    if (m->nlevels > STATIC_MAX_LEVELS || total_bits != m->nwords * 64 || m->nfallback > m->nkeys) goto bad;
+    layout(m);
+
+    m->bits = malloc(sizeof(uint64_t) * (m->nwords ? m->nwords : 1));
+    m->fallback = malloc(sizeof(uint64_t) * (m->nfallback ? m->nfallback : 1));
+    if (m->bits == NULL || m->fallback == NULL) {
+        perror("malloc (static)");
+        static_mphf_free(m);
+        return -1;
+    }
+    size_t bits_len = (size_t)m->nwords * 8;
+    size_t fallback_len = (size_t)m->nfallback * 8;
+    if (safe_pread(fd, m->bits, bits_len, BUCKETS_HEADER_SIZE + STATIC_META_SIZE) != (ssize_t)bits_len ||
+        safe_pread(fd, m->fallback, fallback_len, BUCKETS_HEADER_SIZE + STATIC_META_SIZE + (off_t)bits_len) != (ssize_t)fallback_len ||
+        compute_ranks(m) != 0) {
+        static_mphf_free(m);
+        goto bad;
+    }
+    return 0;
+
+bad:
+    fprintf(stderr, "Error: el indice estatico esta corrupto (reconstruya con --build --static)\n");
+    return -1;
+}
@@ -0,0 +1,77 @@
+#ifndef STATIC_INDEX_H
+#define STATIC_INDEX_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "buckets.h"
+#include "slots.h"
+
+/* Motor de indice "static" (--build --static): para un csv que no cambia. title_buckets.dat
+ * guarda, despues del encabezado (engine = BUCKETS_ENGINE_STATIC, num_buckets = llaves distintas):
+ *  - un hash perfecto minimo (estilo BBHash) sobre los hashes distintos de las llaves: niveles de
+ *    bits, uno por ronda; una llave queda en el primer nivel donde su posicion no choca con otra,
+ *    y su indice es el numero de bits en 1 antes de esa posicion (~3 bits por llave). Las pocas
+ *    llaves que quedan despues de STATIC_MAX_LEVELS niveles van a un arreglo ordenado;
+ *  - una tabla de llaves de STATIC_KEY_SIZE bytes en el orden del hash perfecto:
+ *    [uint64 hash][uint64 offset << 24 | record_len]. El hash se guarda para descartar llaves que
+ *    no estan en el indice (el hash perfecto da un indice para cualquier llave). Si la llave tiene
+ *    una sola fila va directo en la entrada (una lectura por busqueda); si tiene varias,
+ *    record_len es 0 y el campo de offset indica su lista en el area de postings;
+ *  - el area de postings: por llave [uint64 count][uint64 offset << 24 | record_len]...
+ *    con las filas de la mas reciente a la mas antigua.
+ * Los bits del hash perfecto se cargan en memoria al abrir el indice. Como en el motor slots, no
+ * se guardan las llaves: una consulta mas larga que KEY_PREFIX_LEN se confirma en el csv.
+ * El indice es de solo lectura (OP_ADD_BOOK lo rechaza). */
+
+#define STATIC_MAX_LEVELS 32
+#define STATIC_META_SIZE 320  // [nlevels u32][pad u32][nwords][nfallback][postings_words][pad..64][level_bits x 32]
+#define STATIC_KEY_SIZE 16
+#define STATIC_RANK_WORDS 8   // Un conteo acumulado por cada 512 bits
+
+// Hash perfecto cargado en memoria y ubicacion de las tablas en el archivo
+typedef struct {
+    uint64_t nkeys;
+    uint32_t nlevels;
+    uint64_t level_bits[STATIC_MAX_LEVELS]; // Bits de cada nivel (multiplo de 64)
+    uint64_t *bits;                         // Niveles seguidos
+    uint64_t nwords;
+    uint64_t *ranks;                        // Bits en 1 antes de cada bloque de STATIC_RANK_WORDS palabras
+    uint64_t *fallback;                     // Hashes ordenados de las llaves que no quedaron en un nivel
+    uint64_t nfallback;
+    off_t table_off;                        // Tabla de llaves
+    off_t postings_off;                     // Area de postings
+    uint64_t postings_words;
+} static_mphf_t;
+
+// Entrada de la tabla de llaves
+typedef struct {
+    uint64_t hash;
+    off_t offset;        // Registro en el csv (si record_len != 0)
+    uint32_t record_len; // 0 = la llave tiene varias filas
+    uint64_t postings;   // Con record_len 0: palabra de 8 bytes donde empieza su lista en el area de postings
+} static_key_t;
+
+/* Escribe el indice estatico en path (archivo temporal + rename) con las count filas de rows
+ * (hash, offset y longitud de cada registro; el arreglo se reordena), calculados con la semilla
+ * seed y la funcion hash (HASH_*).
+ * Retorna 0, o -1 si falla malloc, la escritura o una fila no cabe en 40 + 24 bits */
+int static_index_write(const char *path, uint64_t seed, uint32_t hash, slot_t *rows, size_t count);
+
+/* Carga el hash perfecto del archivo abierto en fd (hdr ya leido). Retorna 0, o -1 si falla */
+int static_mphf_load(static_mphf_t *m, int fd, const buckets_header_t *hdr);
+
+void static_mphf_free(static_mphf_t *m);
+
+/* Indice (en la tabla de llaves) de hash. Para un hash que no esta en el indice retorna un
+ * indice cualquiera (la entrada tendra otro hash) o nkeys */
+uint64_t static_mphf_lookup(const static_mphf_t *m, uint64_t hash);
+
+// Offset en el archivo de la entrada idx de la tabla de llaves
+static inline off_t static_key_offset(const static_mphf_t *m, uint64_t idx) {
+    return m->table_off + (off_t)idx * STATIC_KEY_SIZE;
+}
+
+void static_key_decode(const unsigned char *buf, static_key_t *key);
+void static_posting_decode(const unsigned char *buf, off_t *offset, uint32_t *record_len);
+
+#endif // STATIC_INDEX_H
@@ -0,0 +1,147 @@
+#include "worker_pool.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+    worker_pool_t *pool;
+    void *ctx;          // Contexto propio del hilo
+    pthread_t thread;
+} worker_t;
+
+struct worker_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty; // Señal para los hilos: hay trabajos en la cola
+
+    void **jobs;       // Buffer circular de trabajos
+    size_t cap;        // Capacidad de la cola
+    size_t head;       // Indice del siguiente trabajo a tomar
+    size_t count;      // Trabajos en la cola
+    int shutting_down;
+
+    worker_t *workers;
+    int num_workers;   // Contextos creados
+    int num_threads;   // Hilos lanzados
+    worker_ctx_free_fn ctx_free;
+    worker_job_fn job_fn;
+};
+
+// Bucle de cada hilo: toma trabajos de la cola hasta que el pool se cierre y la cola quede vacia
+static void *worker_main(void *arg) {
+    worker_t *w = arg;
+    worker_pool_t *pool = w->pool;
+
+    while (1) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->count == 0 && !pool->shutting_down) {
+            pthread_cond_wait(&pool->not_empty, &pool->lock);
+        }
+        if (pool->count == 0 && pool->shutting_down) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        void *job = pool->jobs[pool->head];
+        pool->head = (pool->head + 1) % pool->cap;
+        pool->count--;
+        pthread_mutex_unlock(&pool->lock);
+
+        pool->job_fn(w->ctx, job);
+    }
+    return NULL;
+}
+
+worker_pool_t *worker_pool_create(int num_workers, size_t queue_cap,
+                                  worker_ctx_init_fn ctx_init, worker_ctx_free_fn ctx_free,
+                                  worker_job_fn job_fn, void *arg) {
+    if (num_workers <= 0 || queue_cap == 0 || job_fn == NULL) return NULL;
+
+    worker_pool_t *pool = calloc(1, sizeof(*pool));
+    if (pool == NULL) {
+        perror("calloc");
+        return NULL;
+    }
+    pool->jobs = malloc(sizeof(void *) * queue_cap);
+    pool->workers = calloc((size_t)num_workers, sizeof(worker_t));
+    if (pool->jobs == NULL || pool->workers == NULL) {
+        perror("malloc");
+        free(pool->jobs);
+        free(pool->workers);
+        free(pool);
+        return NULL;
+    }
+    pool->cap = queue_cap;
+    pool->ctx_free = ctx_free;
+    pool->job_fn = job_fn;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->not_empty, NULL);
+
+    // Los contextos se crean antes de lanzar los hilos para poder reportar errores de forma sincrona
+    pool->num_workers = num_workers;
+    for (int i = 0; i < num_workers; i++) {
+        pool->workers[i].pool = pool;
+        if (ctx_init != NULL) {
+            pool->workers[i].ctx = ctx_init(i, arg);
+            if (pool->workers[i].ctx == NULL) {
+                fprintf(stderr, "Error: no se pudo crear el contexto del hilo %d\n", i);
+                pool->num_workers = i; // Solo se liberan los contextos ya creados
+                worker_pool_destroy(pool);
+                return NULL;
+            }
+        }
+    }
+
+    for (int i = 0; i < num_workers; i++) {
+        if (pthread_create(&pool->workers[i].thread, NULL, worker_main, &pool->workers[i]) != 0) {
+            fprintf(stderr, "Error: no se pudo crear el hilo %d\n", i);
+            worker_pool_destroy(pool); // Espera los hilos ya lanzados y libera todos los contextos
+            return NULL;
+        }
+        pool->num_threads = i + 1;
+    }
+    return pool;
+}
+
+// Agrega un trabajo a la cola (requiere el lock y espacio en la cola)
+static void enqueue_locked(worker_pool_t *pool, void *job) {
+    size_t tail = (pool->head + pool->count) % pool->cap;
+    pool->jobs[tail] = job;
+    pool->count++;
+    pthread_cond_signal(&pool->not_empty);
+}
+
+int worker_pool_try_submit(worker_pool_t *pool, void *job) {
+    if (pool == NULL) return -1;
+    pthread_mutex_lock(&pool->lock);
+    int status = 0;
+    if (pool->shutting_down) {
+        status = -1;
+    } else if (pool->count == pool->cap) {
+        status = 1;
+    } else {
+        enqueue_locked(pool, job);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return status;
+}
+
+void worker_pool_destroy(worker_pool_t *pool) {
+    if (pool == NULL) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutting_down = 1;
+    pthread_cond_broadcast(&pool->not_empty);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->num_threads; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    for (int i = 0; i < pool->num_workers; i++) {
+        if (pool->ctx_free && pool->workers[i].ctx) pool->ctx_free(pool->workers[i].ctx);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->not_empty);
+    free(pool->jobs);
+    free(pool->workers);
+    free(pool);
+}
@@ -0,0 +1,36 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <stddef.h>
+
+/* Pool fijo de hilos alimentado por una cola acotada de trabajos.
+ * Cada hilo tiene su propio contexto (creado con ctx_init), de modo que los
+ * recursos que no se pueden compartir entre hilos (index_handle_t, FILE* del
+ * csv, buffers) viven en el contexto del hilo y no necesitan locks.
+ */
+
+typedef struct worker_pool worker_pool_t;
+
+/* Crea el contexto del hilo 'worker_id'. Retorna NULL si falla */
+typedef void *(*worker_ctx_init_fn)(int worker_id, void *arg);
+
+/* Libera el contexto de un hilo */
+typedef void (*worker_ctx_free_fn)(void *ctx);
+
+/* Procesa un trabajo con el contexto del hilo que lo tomo */
+typedef void (*worker_job_fn)(void *ctx, void *job);
+
+/* Crea el pool con num_workers hilos y una cola de queue_cap trabajos.
+ * Todos los contextos se crean antes de retornar; si alguno falla, retorna NULL. */
+worker_pool_t *worker_pool_create(int num_workers, size_t queue_cap,
+                                  worker_ctx_init_fn ctx_init, worker_ctx_free_fn ctx_free,
+                                  worker_job_fn job_fn, void *arg);
+
+/* Encola un trabajo sin bloquear.
+ * Retorna 0 si se encolo, 1 si la cola esta llena, -1 si el pool se esta cerrando */
+int worker_pool_try_submit(worker_pool_t *pool, void *job);
+
+/* Cierra la cola, espera a que los hilos terminen los trabajos pendientes y libera el pool */
+void worker_pool_destroy(worker_pool_t *pool);
+
+#endif // WORKER_POOL_H